@@ -7,6 +7,8 @@ def write_makefile(out):
 
     projects = [
         ("clrs_lib_test", ["test_lib", "test_main_lib"]),
+        ("coro_st_latency", []),
+        ("coro_st_lib_hooks_test", ["test_lib", "test_main_lib"]),
         ("coro_st_lib_test", ["test_lib", "test_main_lib"]),
         ("cpp_util_lib_test", ["test_lib", "test_main_lib"]),
         ("cstdio_lib", []),
@@ -20,6 +22,11 @@ def write_makefile(out):
         ("test_main_lib", []),
     ]
 
+    # Extra compile flags for some projects
+    project_flags = {
+        "coro_st_lib_hooks_test": "-DCORO_ST_LOOP_HOOKS=test_hooks -DCORO_ST_LOOP_HOOKS_HEADER='\"../coro_st_lib_hooks_test/test_hooks.h\"'",
+    }
+
     out.write('''\
 # Delete the default suffixes (otherwise visible in 'make -d')
 .SUFFIXES:
@@ -82,13 +89,19 @@ DEP_FILES :=
 {project}_CPP_FILES := $(wildcard $(SRC_DIR)/{project}/*.cpp)
 \n'''.format(project=project))
 
+        if project in project_flags:
+            out.write('''\
+{project}_FLAGS = {flags}
+\n'''.format(project=project, flags=project_flags[project]))
+
         for config in configs:
                 out.write('''\
 {config}_{project}_OBJ_FILES := $({project}_CPP_FILES:$(SRC_DIR)/%.cpp=$(INT_DIR)/{config}/%.o)
 
 $({config}_{project}_OBJ_FILES) : $(INT_DIR)/{config}/{project}/%.o : $(SRC_DIR)/{project}/%.cpp $(INT_DIR)/{config}/{project}/%.d | $(INT_DIR)/{config}/{project}
-\t$(CXX) $(CXXFLAGS) $({config}_FLAGS) -c -o $@ $<
-\n'''.format(project=project, config=config))
+\t$(CXX) $(CXXFLAGS) $({config}_FLAGS){extra_flags} -c -o $@ $<
+\n'''.format(project=project, config=config,
+                    extra_flags=" $(" + project + "_FLAGS)" if project in project_flags else ""))
 
                 if project.endswith("_lib"):
                     out.write('''\
@@ -97,7 +110,7 @@ $(INT_DIR)/{config}/{project}.a : $({config}_{project}_OBJ_FILES) | $(INT_DIR)/{
 
 {config} : $(INT_DIR)/{config}/{project}.a
 \n'''.format(project=project, config=config))
-                elif project.endswith("_lib_test"):
+                elif project.endswith("_test"):
                     config_libs = " ".join("$(INT_DIR)/" + config + "/" + lib + ".a" for lib in libs)
 
                     out.write('''\
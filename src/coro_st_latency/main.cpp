@@ -0,0 +1,87 @@
+#include "../coro_st_lib/co.h"
+#include "../coro_st_lib/run.h"
+#include "../coro_st_lib/sleep.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+  using duration = std::chrono::steady_clock::duration;
+  using time_point = std::chrono::steady_clock::time_point;
+
+  // The time last read by the loop clock i.e. the cached `now()` the sleep
+  // deadline is computed from
+  time_point loop_now{};
+
+  time_point recording_steady_clock_now() noexcept
+  {
+    loop_now = std::chrono::steady_clock::now();
+    return loop_now;
+  }
+
+  // Sleeps repeatedly and records how late each wake up is
+  coro_st::co<void> async_measure(
+    std::vector<duration>& lateness, duration interval, size_t count)
+  {
+    for (size_t i = 0; i < count; ++i)
+    {
+      // the same deadline as the timer of the sleep
+      auto deadline = loop_now + interval;
+      co_await coro_st::async_sleep_for(interval);
+      lateness.push_back(std::chrono::steady_clock::now() - deadline);
+    }
+  }
+
+  long long to_us(duration d)
+  {
+    return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+  }
+
+  void measure(const char* label, const coro_st::run_options& options)
+  {
+    constexpr size_t count = 1'000;
+    constexpr auto interval = std::chrono::microseconds(500);
+
+    std::vector<duration> lateness;
+    lateness.reserve(count);
+    coro_st::run_options recording_options = options;
+    recording_options.now_fn = &recording_steady_clock_now;
+    coro_st::run(async_measure(lateness, interval, count), recording_options);
+
+    std::sort(lateness.begin(), lateness.end());
+    std::cout << label
+      << ": wake up lateness (us)"
+      << " median: " << to_us(lateness[count / 2])
+      << " p99: " << to_us(lateness[count * 99 / 100])
+      << " max: " << to_us(lateness.back())
+      << '\n';
+  }
+}
+
+int main(int argc, char * argv[])
+{
+  std::ios_base::sync_with_stdio(false);
+  std::string arg = (argc < 2) ? "all" : argv[1];
+
+  if ((arg == "sleep") || (arg == "all"))
+  {
+    measure("sleep", coro_st::run_options{});
+  }
+  if ((arg == "spin") || (arg == "all"))
+  {
+    measure("spin", coro_st::run_options{
+      .idle = coro_st::idle_strategy::spin,
+    });
+  }
+  if ((arg != "sleep") && (arg != "spin") && (arg != "all"))
+  {
+    std::cout << "Unknown argument\n";
+    return 1;
+  }
+  return 0;
+}
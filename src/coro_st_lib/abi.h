@@ -0,0 +1,22 @@
+#pragma once
+
+// The loop hooks policy changes the code of most of the library, so with a
+// policy other than the default the library is in an inline namespace named
+// after CORO_ST_LOOP_HOOKS (which has to be an unqualified name).
+// Translation units built with different policies don't share definitions
+// and interfaces between them (e.g. using `coro_st::context`) fail to link
+// instead of being a silent ODR violation.
+//
+// The default build is in plain `coro_st`: the mangled names and the
+// diagnostics are the same as without hooks
+#define CORO_ST_ABI_CONCAT_IMPL(a, b) a##b
+#define CORO_ST_ABI_CONCAT(a, b) CORO_ST_ABI_CONCAT_IMPL(a, b)
+#define CORO_ST_ABI_STRINGIFY_IMPL(a) #a
+#define CORO_ST_ABI_STRINGIFY(a) CORO_ST_ABI_STRINGIFY_IMPL(a)
+
+#if defined(CORO_ST_LOOP_HOOKS)
+#define CORO_ST_ABI_NAMESPACE CORO_ST_ABI_CONCAT(hooks_, CORO_ST_LOOP_HOOKS)
+#define CORO_ST_NAMESPACE coro_st::inline CORO_ST_ABI_NAMESPACE
+#else
+#define CORO_ST_NAMESPACE coro_st
+#endif
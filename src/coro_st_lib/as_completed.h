@@ -0,0 +1,137 @@
+#pragma once
+
+#include "abi.h"
+#include "child_slots.h"
+#include "context.h"
+#include "coro_type_traits.h"
+#include "value_type_traits.h"
+#include "void_result.h"
+
+#include <functional>
+#include <ranges>
+#include <type_traits>
+
+namespace CORO_ST_NAMESPACE
+{
+  template<std::ranges::forward_range Range, typename Fn, typename OnCompletedFn>
+    requires std::ranges::sized_range<Range>
+  class [[nodiscard]] as_completed_task
+  {
+    using CoTask = std::invoke_result_t<Fn&, std::ranges::range_reference_t<Range>>;
+    static_assert(is_co_task<CoTask>);
+    using CoAwaiter = co_task_awaiter_t<CoTask>;
+    using ValueType = value_type_traits::value_type_t<
+      co_task_result_t<CoTask>>;
+    static_assert(std::is_invocable_r_v<bool, OnCompletedFn&, size_t, ValueType&&>);
+
+    class [[nodiscard]] awaiter :
+      public impl::child_slots_awaiter<awaiter, Range, Fn>
+    {
+      using base = impl::child_slots_awaiter<awaiter, Range, Fn>;
+      friend base;
+
+      size_t completed_count_{ 0 };
+      OnCompletedFn on_completed_fn_;
+
+    public:
+      // All the children run at the same time
+      awaiter(
+        context& parent_ctx,
+        Range& range,
+        Fn& fn,
+        OnCompletedFn& on_completed_fn
+      ) :
+        base{ parent_ctx, range, static_cast<size_t>(std::ranges::size(range)), fn },
+        completed_count_{ 0 },
+        on_completed_fn_{ std::move(on_completed_fn) }
+      {
+      }
+
+      // Number of results passed to the on completed function
+      size_t await_resume()
+      {
+        base::rethrow_if_exception();
+
+        return completed_count_;
+      }
+
+    private:
+      void on_child_result(size_t index, CoAwaiter& co_awaiter)
+      {
+        bool keep_going{ true };
+        if constexpr (std::is_same_v<void, co_task_result_t<CoTask>>)
+        {
+          co_awaiter.await_resume();
+          ++completed_count_;
+          keep_going = std::invoke(on_completed_fn_, index, void_result{});
+        }
+        else
+        {
+          ValueType value = co_awaiter.await_resume();
+          ++completed_count_;
+          keep_going = std::invoke(on_completed_fn_, index, std::move(value));
+        }
+        if (!keep_going)
+        {
+          base::stop_early();
+        }
+      }
+    };
+
+    struct [[nodiscard]] work
+    {
+      Range* range_;
+      Fn fn_;
+      OnCompletedFn on_completed_fn_;
+
+      work(Range& range, Fn&& fn, OnCompletedFn&& on_completed_fn) noexcept :
+        range_{ &range },
+        fn_{ std::move(fn) },
+        on_completed_fn_{ std::move(on_completed_fn) }
+      {
+      }
+
+      work(const work&) = delete;
+      work& operator=(const work&) = delete;
+      work(work&&) noexcept = default;
+      work& operator=(work&&) noexcept = default;
+
+      [[nodiscard]] awaiter get_awaiter(context& ctx)
+      {
+        return {ctx, *range_, fn_, on_completed_fn_};
+      }
+    };
+
+  private:
+    work work_;
+
+  public:
+    as_completed_task(Range& range, Fn&& fn, OnCompletedFn&& on_completed_fn) noexcept :
+      work_{ range, std::move(fn), std::move(on_completed_fn) }
+    {
+    }
+
+    as_completed_task(const as_completed_task&) = delete;
+    as_completed_task& operator=(const as_completed_task&) = delete;
+
+    [[nodiscard]] work get_work() noexcept
+    {
+      return std::move(work_);
+    }
+  };
+
+  // Starts fn(item) for all the items in the range and calls
+  // on_completed(index, result) as each child completes, in completion
+  // order. When on_completed returns false the remaining children are
+  // cancelled
+  template<std::ranges::forward_range Range, typename Fn, typename OnCompletedFn>
+    requires std::ranges::sized_range<Range>
+  [[nodiscard]] as_completed_task<Range, Fn, OnCompletedFn>
+    async_as_completed(Range& range, Fn fn, OnCompletedFn on_completed) noexcept
+  {
+    static_assert(std::is_nothrow_move_constructible_v<Fn>);
+    static_assert(std::is_nothrow_move_constructible_v<OnCompletedFn>);
+    return as_completed_task<Range, Fn, OnCompletedFn>{
+      range, std::move(fn), std::move(on_completed) };
+  }
+}
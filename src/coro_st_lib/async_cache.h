@@ -0,0 +1,449 @@
+#pragma once
+
+#include "abi.h"
+#include "context.h"
+#include "coro_type_traits.h"
+#include "event_loop_context.h"
+#include "singleflight.h"
+#include "then.h"
+#include "timer_heap.h"
+
+#include "../cpp_util_lib/intrusive_list.h"
+
+#include <cassert>
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <map>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace CORO_ST_NAMESPACE
+{
+  template<typename K, typename V>
+  class async_cache
+  {
+    static_assert(std::is_nothrow_move_constructible_v<K>);
+    static_assert(std::is_copy_constructible_v<K>);
+    static_assert(std::is_copy_constructible_v<V>);
+
+    struct entry
+    {
+      V value_;
+      const K* key_{ nullptr };
+      // least recently used at the front
+      entry* lru_next_{ nullptr };
+      entry* lru_prev_{ nullptr };
+      // first to expire at the front
+      entry* ttl_next_{ nullptr };
+      entry* ttl_prev_{ nullptr };
+      std::chrono::steady_clock::time_point expires_at_{};
+
+      explicit entry(const V& value) :
+        value_{ value }
+      {
+      }
+
+      entry(const entry&) = delete;
+      entry& operator=(const entry&) = delete;
+    };
+
+    using lru_list = cpp_util::intrusive_list<
+      entry,
+      &entry::lru_next_,
+      &entry::lru_prev_>;
+
+    using ttl_list = cpp_util::intrusive_list<
+      entry,
+      &entry::ttl_next_,
+      &entry::ttl_prev_>;
+
+    using map_type = std::map<K, entry>;
+    using node_type = typename map_type::node_type;
+
+    // Inserts the loaded value, from the shared load
+    struct insert_fn
+    {
+      async_cache* cache_;
+      K key_;
+
+      V operator()(V value)
+      {
+        cache_->insert(key_, value);
+        return value;
+      }
+    };
+
+    template<typename LoaderFn>
+    struct load_fn
+    {
+      async_cache* cache_;
+      K key_;
+      LoaderFn loader_fn_;
+
+      auto operator()()
+      {
+        return async_then(
+          std::invoke(loader_fn_, std::as_const(key_)),
+          insert_fn{ cache_, key_ });
+      }
+    };
+
+  public:
+    template<typename LoaderFn>
+    class [[nodiscard]] async_cache_get_task
+    {
+      using LoadFn = load_fn<LoaderFn>;
+      using LoadTask = typename singleflight<K, V>::template singleflight_do_task<LoadFn>;
+      using LoadAwaiter = co_task_awaiter_t<LoadTask>;
+
+      class [[nodiscard]] awaiter
+      {
+        // Allows constructing the non movable load awaiter in place
+        struct load_awaiter_builder
+        {
+          async_cache* cache_;
+          context* ctx_;
+          K* key_;
+          LoaderFn* loader_fn_;
+
+          operator LoadAwaiter() const
+          {
+            return cache_->flights_.async_do(
+              *key_,
+              LoadFn{ cache_, *key_, std::move(*loader_fn_) }
+            ).get_work().get_awaiter(*ctx_);
+          }
+        };
+
+        context& ctx_;
+        // on a hit
+        std::optional<V> value_;
+        // on a miss: the load shared with other callers for the same key
+        std::optional<LoadAwaiter> load_awaiter_;
+
+      public:
+        awaiter(context& ctx, async_cache& cache, K& key, LoaderFn& loader_fn) :
+          ctx_{ ctx },
+          value_{},
+          load_awaiter_{}
+        {
+          cache.set_event_loop_context(ctx_.get_event_loop_context());
+          entry* e = cache.find(key);
+          if (e != nullptr)
+          {
+            value_.emplace(e->value_);
+            return;
+          }
+          load_awaiter_.emplace(load_awaiter_builder{ &cache, &ctx_, &key, &loader_fn });
+        }
+
+        awaiter(const awaiter&) = delete;
+        awaiter& operator=(const awaiter&) = delete;
+
+        [[nodiscard]] constexpr bool await_ready() const noexcept
+        {
+          return false;
+        }
+
+        bool await_suspend(std::coroutine_handle<> handle) noexcept
+        {
+          if (load_awaiter_)
+          {
+            return load_awaiter_->await_suspend(handle);
+          }
+          if (ctx_.get_stop_token().stop_requested())
+          {
+            ctx_.invoke_stopped();
+            return true;
+          }
+          return false;
+        }
+
+        V await_resume()
+        {
+          if (load_awaiter_)
+          {
+            return load_awaiter_->await_resume();
+          }
+          return std::move(*value_);
+        }
+
+        std::exception_ptr get_result_exception() const noexcept
+        {
+          if (load_awaiter_)
+          {
+            return load_awaiter_->get_result_exception();
+          }
+          return {};
+        }
+
+        void start() noexcept
+        {
+          if (load_awaiter_)
+          {
+            load_awaiter_->start();
+            return;
+          }
+          if (ctx_.get_stop_token().stop_requested())
+          {
+            ctx_.invoke_stopped();
+            return;
+          }
+          ctx_.invoke_result_ready();
+        }
+      };
+
+      struct [[nodiscard]] work
+      {
+        async_cache* cache_;
+        K key_;
+        LoaderFn loader_fn_;
+
+        work(async_cache& cache, K&& key, LoaderFn&& loader_fn) noexcept :
+          cache_{ &cache },
+          key_{ std::move(key) },
+          loader_fn_{ std::move(loader_fn) }
+        {
+        }
+
+        work(const work&) = delete;
+        work& operator=(const work&) = delete;
+        work(work&&) noexcept = default;
+        work& operator=(work&&) noexcept = default;
+
+        [[nodiscard]] awaiter get_awaiter(context& ctx)
+        {
+          return {ctx, *cache_, key_, loader_fn_};
+        }
+      };
+
+    private:
+      work work_;
+
+    public:
+      async_cache_get_task(async_cache& cache, K&& key, LoaderFn&& loader_fn) noexcept :
+        work_{ cache, std::move(key), std::move(loader_fn) }
+      {
+      }
+
+      async_cache_get_task(const async_cache_get_task&) = delete;
+      async_cache_get_task& operator=(const async_cache_get_task&) = delete;
+
+      [[nodiscard]] work get_work() noexcept
+      {
+        return std::move(work_);
+      }
+    };
+
+  private:
+    size_t capacity_;
+    std::chrono::steady_clock::duration ttl_;
+    map_type map_;
+    // nodes of evicted entries, reused for new entries
+    std::vector<node_type> free_nodes_;
+    lru_list lru_list_;
+    ttl_list ttl_list_;
+    singleflight<K, V> flights_;
+    event_loop_context* event_loop_ctx_{ nullptr };
+    // one timer for the first entry to expire
+    timer_node timer_node_;
+    bool timer_armed_{ false };
+
+  public:
+    // A zero ttl disables expiry. Otherwise the cache uses the event loop
+    // for the expiry timer and it has to be destroyed before the event loop
+    // e.g. declare it in a coroutine
+    async_cache(size_t capacity, std::chrono::steady_clock::duration ttl) :
+      capacity_{ capacity },
+      ttl_{ ttl },
+      map_{},
+      free_nodes_{},
+      lru_list_{},
+      ttl_list_{},
+      flights_{},
+      event_loop_ctx_{ nullptr },
+      timer_node_{ std::chrono::steady_clock::time_point{} },
+      timer_armed_{ false }
+    {
+      assert(capacity_ > 0);
+      free_nodes_.reserve(capacity_);
+    }
+
+    async_cache(const async_cache&) = delete;
+    async_cache& operator=(const async_cache&) = delete;
+
+    ~async_cache()
+    {
+      disarm_timer();
+    }
+
+    size_t size() const noexcept
+    {
+      return map_.size();
+    }
+
+    size_t capacity() const noexcept
+    {
+      return capacity_;
+    }
+
+    // On a miss, loader_fn(key) is called to get a task returning V, unless
+    // a load for the key is already in flight, in which case the caller
+    // joins it
+    template<typename LoaderFn>
+    [[nodiscard]] async_cache_get_task<LoaderFn> async_get(K key, LoaderFn loader_fn) noexcept
+    {
+      static_assert(is_co_task<std::invoke_result_t<LoaderFn&, const K&>>);
+      static_assert(std::is_same_v<V, co_task_result_t<std::invoke_result_t<LoaderFn&, const K&>>>);
+      static_assert(std::is_nothrow_move_constructible_v<LoaderFn>);
+      return async_cache_get_task<LoaderFn>{ *this, std::move(key), std::move(loader_fn) };
+    }
+
+    // Removes the entry e.g. when the value was changed at the source
+    void erase(const K& key) noexcept
+    {
+      auto it = map_.find(key);
+      if (it != map_.end())
+      {
+        evict(it->second);
+      }
+    }
+
+  private:
+    void set_event_loop_context(event_loop_context& event_loop_ctx) noexcept
+    {
+      assert((nullptr == event_loop_ctx_) || (&event_loop_ctx == event_loop_ctx_));
+      event_loop_ctx_ = &event_loop_ctx;
+    }
+
+    entry* find(const K& key)
+    {
+      auto it = map_.find(key);
+      if (it == map_.end())
+      {
+        return nullptr;
+      }
+      entry* e = &it->second;
+      lru_list_.remove(e);
+      lru_list_.push_back(e);
+      return e;
+    }
+
+    void insert(const K& key, const V& value)
+    {
+      auto it = map_.find(key);
+      if (it != map_.end())
+      {
+        entry& e = it->second;
+        e.value_ = value;
+        lru_list_.remove(&e);
+        ttl_list_.remove(&e);
+        link(e);
+        return;
+      }
+
+      node_type node;
+      if (map_.size() >= capacity_)
+      {
+        node = extract(*lru_list_.front());
+      }
+      else if (!free_nodes_.empty())
+      {
+        node = std::move(free_nodes_.back());
+        free_nodes_.pop_back();
+      }
+
+      if (node)
+      {
+        try
+        {
+          node.key() = key;
+          node.mapped().value_ = value;
+        }
+        catch(...)
+        {
+          free_nodes_.push_back(std::move(node));
+          throw;
+        }
+        it = map_.insert(std::move(node)).position;
+      }
+      else
+      {
+        it = map_.try_emplace(key, value).first;
+      }
+
+      entry& e = it->second;
+      e.key_ = &it->first;
+      link(e);
+    }
+
+    void link(entry& e) noexcept
+    {
+      lru_list_.push_back(&e);
+      assert(event_loop_ctx_ != nullptr);
+      e.expires_at_ = event_loop_ctx_->now() + ttl_;
+      ttl_list_.push_back(&e);
+      arm_timer();
+    }
+
+    node_type extract(entry& e) noexcept
+    {
+      lru_list_.remove(&e);
+      ttl_list_.remove(&e);
+      return map_.extract(*e.key_);
+    }
+
+    void evict(entry& e) noexcept
+    {
+      // does not throw: capacity was reserved
+      free_nodes_.push_back(extract(e));
+    }
+
+    void arm_timer() noexcept
+    {
+      if (
+        timer_armed_ ||
+        ttl_list_.empty() ||
+        (ttl_ <= std::chrono::steady_clock::duration::zero()))
+      {
+        return;
+      }
+      timer_node_.deadline = ttl_list_.front()->expires_at_;
+      timer_node_.cb = make_member_callback<&async_cache::on_timer>(this);
+      event_loop_ctx_->insert_timer_node(timer_node_);
+      timer_armed_ = true;
+    }
+
+    void disarm_timer() noexcept
+    {
+      if (timer_armed_)
+      {
+        event_loop_ctx_->remove_timer_node(timer_node_);
+        timer_armed_ = false;
+      }
+    }
+
+    void on_timer() noexcept
+    {
+      // already removed from the heap by the event loop
+      timer_armed_ = false;
+
+      auto now = event_loop_ctx_->now();
+      while (true)
+      {
+        entry* e = ttl_list_.front();
+        if ((e == nullptr) || (e->expires_at_ > now))
+        {
+          break;
+        }
+        evict(*e);
+      }
+
+      arm_timer();
+    }
+  };
+}
@@ -0,0 +1,244 @@
+#pragma once
+
+#include "abi.h"
+#include "loop_hooks_policy.h"
+#include "../cpp_util_lib/intrusive_list.h"
+
+#include <cassert>
+#include <coroutine>
+#include <cstddef>
+#include <new>
+#include <ostream>
+#include <source_location>
+#include <span>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace CORO_ST_NAMESPACE
+{
+  class async_stack_registry;
+
+  // Owned by the registry, pointed to by the promise of a `co` coroutine
+  // while registered (see async_stack_hooks)
+  struct async_frame
+  {
+    async_frame* next{ nullptr };
+    async_frame* prev{ nullptr };
+    async_stack_registry* registry{ nullptr };
+    // the coroutine frame address
+    void* address{ nullptr };
+    // the promise's continuation, null for the first coroutine in a chain
+    const std::coroutine_handle<>* parent_coro{ nullptr };
+    // the task type and location of the last co_await
+    std::string_view awaiting{};
+    std::source_location location{};
+  };
+
+  // Tracks the live `co` coroutines of an event loop so that the chains of
+  // suspended coroutines can be dumped e.g. to see where requests are
+  // waiting during a slowdown.
+  //
+  // Opt-in at compile time with the async_stack_hooks loop hooks policy,
+  // then at run time: `run(task, run_options{ .async_stacks = &registry })`.
+  // Without the policy `co` has none of the code and data for it.
+  // With it a coroutine pays one pointer in the promise and a null pointer
+  // check when it starts, at each co_await and when it ends, the frames come
+  // from a free list in the registry.
+  //
+  // Not thread safe: dump from the event loop thread e.g. from a coroutine
+  // woken by a signal, not from a signal handler.
+  class async_stack_registry
+  {
+    using frame_list = cpp_util::intrusive_list<
+      async_frame,
+      &async_frame::next,
+      &async_frame::prev>;
+
+    frame_list frames_;
+    size_t size_{ 0 };
+    // released frames for reuse, linked via next
+    async_frame* free_{ nullptr };
+
+  public:
+    async_stack_registry() noexcept = default;
+
+    async_stack_registry(const async_stack_registry&) = delete;
+    async_stack_registry& operator=(const async_stack_registry&) = delete;
+
+    ~async_stack_registry()
+    {
+      assert(frames_.empty());
+      while (nullptr != free_)
+      {
+        async_frame* frame = free_;
+        free_ = frame->next;
+        delete frame;
+      }
+    }
+
+    // Returns a registered frame, or null if out of memory
+    // (the coroutine is then missing from the dumps)
+    async_frame* insert() noexcept
+    {
+      async_frame* frame = free_;
+      if (nullptr != frame)
+      {
+        free_ = frame->next;
+        *frame = async_frame{};
+      }
+      else
+      {
+        frame = new (std::nothrow) async_frame{};
+        if (nullptr == frame)
+        {
+          return nullptr;
+        }
+      }
+      frame->registry = this;
+      frames_.push_back(frame);
+      ++size_;
+      return frame;
+    }
+
+    void remove(async_frame& frame) noexcept
+    {
+      assert(this == frame.registry);
+      frames_.remove(&frame);
+      frame.registry = nullptr;
+      --size_;
+      frame.prev = nullptr;
+      frame.next = free_;
+      free_ = &frame;
+    }
+
+    // Number of live coroutines
+    size_t size() const noexcept
+    {
+      return size_;
+    }
+
+    // Calls fn(std::span<const async_frame* const>) for each chain of
+    // coroutines awaiting each other, innermost first.
+    //
+    // The chain ends at the first coroutine of a chain: the children of
+    // combinators like `async_wait_all` are reported as separate stacks,
+    // the parent shows as awaiting the combinator task.
+    template<typename Fn>
+    void for_each_stack(Fn fn) const
+    {
+      std::unordered_map<void*, const async_frame*> by_address;
+      std::unordered_set<void*> awaited_by_child;
+      for (const async_frame* f = frames_.front(); f != nullptr; f = f->next)
+      {
+        by_address.emplace(f->address, f);
+        if (f->parent_coro != nullptr && *f->parent_coro)
+        {
+          awaited_by_child.insert(f->parent_coro->address());
+        }
+      }
+
+      std::vector<const async_frame*> stack;
+      for (const async_frame* f = frames_.front(); f != nullptr; f = f->next)
+      {
+        if (awaited_by_child.contains(f->address))
+        {
+          continue;
+        }
+        stack.clear();
+        for (const async_frame* x = f; x != nullptr; )
+        {
+          stack.push_back(x);
+          if (x->parent_coro == nullptr || !*x->parent_coro)
+          {
+            break;
+          }
+          auto it = by_address.find(x->parent_coro->address());
+          x = (it == by_address.end()) ? nullptr : it->second;
+        }
+        fn(std::span<const async_frame* const>(stack));
+      }
+    }
+
+    void dump(std::ostream& os) const
+    {
+      size_t stack_index = 0;
+      for_each_stack([&](std::span<const async_frame* const> stack) {
+        os << "async stack " << stack_index << ":\n";
+        ++stack_index;
+        for (size_t i = 0; i < stack.size(); ++i)
+        {
+          const async_frame& f = *stack[i];
+          os << "  #" << i << " " << f.address;
+          if (f.awaiting.empty())
+          {
+            os << " not started\n";
+            continue;
+          }
+          os << " awaiting " << f.awaiting
+            << " at " << f.location.file_name() << ":" << f.location.line()
+            << " in " << f.location.function_name() << "\n";
+        }
+      });
+    }
+  };
+
+  // The loop hooks policy for async stacks (see loop_hooks.h), alone:
+  // -DCORO_ST_LOOP_HOOKS=async_stack_hooks
+  // -DCORO_ST_LOOP_HOOKS_HEADER='"async_stack.h"'
+  // or in a combine_loop_hooks
+  struct async_stack_hooks : no_loop_hooks
+  {
+    class co_frame
+    {
+      friend async_stack_hooks;
+
+      async_frame* frame_{ nullptr };
+
+    public:
+      co_frame() noexcept = default;
+
+      co_frame(const co_frame&) = delete;
+      co_frame& operator=(const co_frame&) = delete;
+
+      ~co_frame()
+      {
+        if (nullptr != frame_)
+        {
+          frame_->registry->remove(*frame_);
+        }
+      }
+    };
+
+    template<typename Context>
+    static void on_co_attach(
+      co_frame& frame,
+      Context& ctx,
+      std::coroutine_handle<> handle,
+      const std::coroutine_handle<>* parent_coro) noexcept
+    {
+      async_stack_registry* async_stacks = ctx.get_async_stacks();
+      if (nullptr == async_stacks)
+      {
+        return;
+      }
+      frame.frame_ = async_stacks->insert();
+      if (nullptr != frame.frame_)
+      {
+        frame.frame_->address = handle.address();
+        frame.frame_->parent_coro = parent_coro;
+      }
+    }
+
+    static void on_co_await(
+      co_frame& frame, std::string_view awaiting, std::source_location location) noexcept
+    {
+      if (nullptr != frame.frame_)
+      {
+        frame.frame_->awaiting = awaiting;
+        frame.frame_->location = location;
+      }
+    }
+  };
+}
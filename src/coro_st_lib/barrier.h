@@ -0,0 +1,261 @@
+#pragma once
+
+#include "abi.h"
+#include "context.h"
+
+#include "../cpp_util_lib/intrusive_list.h"
+
+#include <cassert>
+#include <coroutine>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace CORO_ST_NAMESPACE
+{
+  struct barrier_noop_completion
+  {
+    constexpr void operator()() const noexcept
+    {
+    }
+  };
+
+  template<typename CompletionFn = barrier_noop_completion>
+  class barrier
+  {
+    static_assert(std::is_nothrow_invocable_v<CompletionFn&>,
+      "The phase completion function is called from inside arrive operations, it must be noexcept");
+
+  public:
+    class [[nodiscard]] barrier_arrive_task
+    {
+      friend class barrier;
+
+      class [[nodiscard]] awaiter
+      {
+        friend class barrier;
+
+        context& ctx_;
+        std::coroutine_handle<> parent_handle_;
+        barrier& bar_;
+        awaiter* next_waiting_{ nullptr };
+        awaiter* prev_waiting_{ nullptr };
+        std::optional<stop_callback<callback>> parent_stop_cb_;
+
+      public:
+        awaiter(context& ctx, barrier& bar) noexcept :
+          ctx_{ ctx },
+          parent_handle_{},
+          bar_{ bar },
+          next_waiting_{ nullptr },
+          prev_waiting_{ nullptr },
+          parent_stop_cb_{ std::nullopt }
+        {
+        }
+
+        awaiter(const awaiter&) = delete;
+        awaiter& operator=(const awaiter&) = delete;
+
+        [[nodiscard]] constexpr bool await_ready() const noexcept
+        {
+          return false;
+        }
+
+        bool await_suspend(std::coroutine_handle<> handle) noexcept
+        {
+          parent_handle_ = handle;
+          if (ctx_.get_stop_token().stop_requested())
+          {
+            ctx_.invoke_stopped();
+            return true;
+          }
+          if (bar_.arrive())
+          {
+            return false;
+          }
+          enqueue_wait_node();
+          return true;
+        }
+
+        constexpr void await_resume() const noexcept
+        {
+        }
+
+        std::exception_ptr get_result_exception() const noexcept
+        {
+          return {};
+        }
+
+        void start() noexcept
+        {
+          if (ctx_.get_stop_token().stop_requested())
+          {
+            ctx_.invoke_stopped();
+            return;
+          }
+          if (bar_.arrive())
+          {
+            ctx_.invoke_result_ready();
+            return;
+          }
+          enqueue_wait_node();
+        }
+
+      private:
+        void enqueue_wait_node() noexcept
+        {
+          bar_.wait_list_.push_back(this);
+          parent_stop_cb_.emplace(
+            ctx_.get_stop_token(),
+            make_member_callback<&awaiter::on_cancel>(this));
+        }
+
+        // Called after the barrier already unlinked it from the wait list
+        void on_phase_completed() noexcept
+        {
+          parent_stop_cb_.reset();
+
+          if (parent_handle_)
+          {
+            ctx_.schedule_coroutine_resume(parent_handle_);
+            return;
+          }
+
+          ctx_.schedule_result_ready();
+        }
+
+        // The arrival remains counted for the current phase
+        void on_cancel() noexcept
+        {
+          parent_stop_cb_.reset();
+          bar_.wait_list_.remove(this);
+          ctx_.schedule_stopped();
+        }
+      };
+
+      struct [[nodiscard]] work
+      {
+        barrier* bar_;
+
+        explicit work(barrier& bar) noexcept :
+          bar_{ &bar }
+        {
+        }
+
+        work(const work&) = delete;
+        work& operator=(const work&) = delete;
+        work(work&&) noexcept = default;
+        work& operator=(work&&) noexcept = default;
+
+        [[nodiscard]] awaiter get_awaiter(context& ctx) noexcept
+        {
+          return {ctx, *bar_};
+        }
+      };
+
+    private:
+      work work_;
+
+    public:
+      explicit barrier_arrive_task(barrier& bar) noexcept :
+        work_{ bar }
+      {
+      }
+
+      barrier_arrive_task(const barrier_arrive_task&) = delete;
+      barrier_arrive_task& operator=(const barrier_arrive_task&) = delete;
+
+      [[nodiscard]] work get_work() noexcept
+      {
+        return std::move(work_);
+      }
+    };
+
+  private:
+    using wait_list = cpp_util::intrusive_list<
+      typename barrier_arrive_task::awaiter,
+      &barrier_arrive_task::awaiter::next_waiting_,
+      &barrier_arrive_task::awaiter::prev_waiting_>;
+
+    size_t expected_;
+    size_t pending_;
+    size_t phase_{ 0 };
+    CompletionFn completion_fn_;
+    wait_list wait_list_;
+
+  public:
+    explicit barrier(size_t expected, CompletionFn completion_fn = CompletionFn()) :
+      expected_{ expected },
+      pending_{ expected },
+      phase_{ 0 },
+      completion_fn_(std::move(completion_fn)),
+      wait_list_{}
+    {
+      assert(expected_ > 0);
+    }
+
+    barrier(const barrier&) = delete;
+    barrier& operator=(const barrier&) = delete;
+
+    ~barrier()
+    {
+      assert(wait_list_.empty());
+    }
+
+    // Number of phases completed so far
+    size_t phase() const noexcept
+    {
+      return phase_;
+    }
+
+    size_t expected() const noexcept
+    {
+      return expected_;
+    }
+
+    [[nodiscard]] barrier_arrive_task async_arrive_and_wait() noexcept
+    {
+      return barrier_arrive_task{*this};
+    }
+
+    // Arrive for the current phase and reduce the expected count
+    // for the following phases
+    void arrive_and_drop() noexcept
+    {
+      assert(expected_ > 0);
+      --expected_;
+      arrive();
+    }
+
+  private:
+    // Returns true if this arrival completed the phase
+    bool arrive() noexcept
+    {
+      assert(pending_ > 0);
+      --pending_;
+      if (0 != pending_)
+      {
+        return false;
+      }
+
+      // the completion function runs before any waiter of this phase
+      // is resumed
+      wait_list local_wait_list = std::move(wait_list_);
+      completion_fn_();
+
+      ++phase_;
+      pending_ = expected_;
+
+      while (true)
+      {
+        auto* waiting = local_wait_list.pop_front();
+        if (waiting == nullptr)
+        {
+          break;
+        }
+        waiting->on_phase_completed();
+      }
+      return true;
+    }
+  };
+}
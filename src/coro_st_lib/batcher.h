@@ -0,0 +1,364 @@
+#pragma once
+
+#include "abi.h"
+#include "callback.h"
+#include "context.h"
+#include "event_loop_context.h"
+#include "stop_util.h"
+#include "timer_heap.h"
+
+#include "../cpp_util_lib/intrusive_list.h"
+
+#include <cassert>
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace CORO_ST_NAMESPACE
+{
+  template<
+    typename T,
+    typename R,
+    typename FlushFn = void (*)(std::span<T>, std::span<R>)>
+  class batcher
+  {
+    static_assert(std::is_nothrow_move_constructible_v<T>);
+    static_assert(std::is_nothrow_move_assignable_v<T>);
+    static_assert(std::is_default_constructible_v<R>);
+
+  public:
+    class [[nodiscard]] batcher_add_task
+    {
+      friend class batcher;
+
+      class [[nodiscard]] awaiter
+      {
+        friend class batcher;
+
+        context& ctx_;
+        std::coroutine_handle<> parent_handle_;
+        batcher& b_;
+        T item_;
+        size_t index_{ 0 };
+        awaiter* next_waiting_{ nullptr };
+        awaiter* prev_waiting_{ nullptr };
+        std::optional<stop_callback<callback>> parent_stop_cb_;
+        std::optional<R> result_;
+        std::exception_ptr exception_;
+
+      public:
+        awaiter(context& ctx, batcher& b, T&& item) noexcept :
+          ctx_{ ctx },
+          parent_handle_{},
+          b_{ b },
+          item_{ std::move(item) },
+          index_{ 0 },
+          next_waiting_{ nullptr },
+          prev_waiting_{ nullptr },
+          parent_stop_cb_{ std::nullopt },
+          result_{},
+          exception_{}
+        {
+        }
+
+        awaiter(const awaiter&) = delete;
+        awaiter& operator=(const awaiter&) = delete;
+
+        [[nodiscard]] constexpr bool await_ready() const noexcept
+        {
+          return false;
+        }
+
+        bool await_suspend(std::coroutine_handle<> handle) noexcept
+        {
+          parent_handle_ = handle;
+          if (ctx_.get_stop_token().stop_requested())
+          {
+            ctx_.invoke_stopped();
+            return true;
+          }
+          if (b_.add(*this))
+          {
+            return false;
+          }
+          parent_stop_cb_.emplace(
+            ctx_.get_stop_token(),
+            make_member_callback<&awaiter::on_cancel>(this));
+          return true;
+        }
+
+        R await_resume()
+        {
+          if (exception_)
+          {
+            std::rethrow_exception(exception_);
+          }
+          return std::move(*result_);
+        }
+
+        std::exception_ptr get_result_exception() const noexcept
+        {
+          return exception_;
+        }
+
+        void start() noexcept
+        {
+          if (ctx_.get_stop_token().stop_requested())
+          {
+            ctx_.invoke_stopped();
+            return;
+          }
+          if (b_.add(*this))
+          {
+            ctx_.invoke_result_ready();
+            return;
+          }
+          parent_stop_cb_.emplace(
+            ctx_.get_stop_token(),
+            make_member_callback<&awaiter::on_cancel>(this));
+        }
+
+      private:
+        void set_result(R* result, std::exception_ptr e) noexcept
+        {
+          if (e)
+          {
+            exception_ = e;
+            return;
+          }
+          try
+          {
+            result_.emplace(std::move(*result));
+          }
+          catch(...)
+          {
+            exception_ = std::current_exception();
+          }
+        }
+
+        // Called after the batcher already unlinked it from the wait list
+        void on_flushed() noexcept
+        {
+          parent_stop_cb_.reset();
+
+          if (parent_handle_)
+          {
+            ctx_.schedule_coroutine_resume(parent_handle_);
+            return;
+          }
+
+          ctx_.schedule_result_ready();
+        }
+
+        void on_cancel() noexcept
+        {
+          parent_stop_cb_.reset();
+          b_.remove(*this);
+          ctx_.schedule_stopped();
+        }
+      };
+
+      struct [[nodiscard]] work
+      {
+        batcher* b_;
+        T item_;
+
+        work(batcher& b, T&& item) noexcept :
+          b_{ &b },
+          item_{ std::move(item) }
+        {
+        }
+
+        work(const work&) = delete;
+        work& operator=(const work&) = delete;
+        work(work&&) noexcept = default;
+        work& operator=(work&&) noexcept = default;
+
+        [[nodiscard]] awaiter get_awaiter(context& ctx) noexcept
+        {
+          return {ctx, *b_, std::move(item_)};
+        }
+      };
+
+    private:
+      work work_;
+
+    public:
+      batcher_add_task(batcher& b, T&& item) noexcept :
+        work_{ b, std::move(item) }
+      {
+      }
+
+      batcher_add_task(const batcher_add_task&) = delete;
+      batcher_add_task& operator=(const batcher_add_task&) = delete;
+
+      [[nodiscard]] work get_work() noexcept
+      {
+        return std::move(work_);
+      }
+    };
+
+  private:
+    using awaiter = typename batcher_add_task::awaiter;
+
+    using wait_list = cpp_util::intrusive_list<
+      awaiter,
+      &awaiter::next_waiting_,
+      &awaiter::prev_waiting_>;
+
+    size_t max_size_;
+    std::chrono::steady_clock::duration max_delay_;
+    FlushFn flush_fn_;
+    std::vector<T> items_;
+    std::vector<R> results_;
+    wait_list wait_list_;
+    // one timer for the current batch, armed by the first item
+    timer_node timer_node_;
+    event_loop_context* timer_event_loop_ctx_{ nullptr };
+
+  public:
+    batcher(
+      size_t max_size,
+      std::chrono::steady_clock::duration max_delay,
+      FlushFn flush_fn
+    ) :
+      max_size_{ max_size },
+      max_delay_{ max_delay },
+      flush_fn_(std::move(flush_fn)),
+      items_{},
+      results_{},
+      wait_list_{},
+      timer_node_{ std::chrono::steady_clock::time_point{} },
+      timer_event_loop_ctx_{ nullptr }
+    {
+      assert(max_size_ > 0);
+      items_.reserve(max_size_);
+      results_.reserve(max_size_);
+    }
+
+    batcher(const batcher&) = delete;
+    batcher& operator=(const batcher&) = delete;
+
+    ~batcher()
+    {
+      assert(wait_list_.empty());
+      assert(nullptr == timer_event_loop_ctx_);
+    }
+
+    // Number of items waiting for the next flush
+    size_t size() const noexcept
+    {
+      return items_.size();
+    }
+
+    [[nodiscard]] batcher_add_task async_add(T item) noexcept
+    {
+      return batcher_add_task{ *this, std::move(item) };
+    }
+
+  private:
+    // Returns true if the item completed the batch, in which case
+    // the batch was flushed and the caller continues immediately
+    bool add(awaiter& a) noexcept
+    {
+      a.index_ = items_.size();
+      // does not throw: capacity was reserved
+      items_.push_back(std::move(a.item_));
+
+      if (items_.size() == max_size_)
+      {
+        flush(&a);
+        return true;
+      }
+
+      wait_list_.push_back(&a);
+
+      if (1 == items_.size())
+      {
+        arm_timer(a.ctx_.get_event_loop_context());
+      }
+      return false;
+    }
+
+    void remove(awaiter& a) noexcept
+    {
+      items_.erase(items_.begin() + static_cast<std::ptrdiff_t>(a.index_));
+      for (awaiter* next = a.next_waiting_; next != nullptr; next = next->next_waiting_)
+      {
+        --next->index_;
+      }
+      wait_list_.remove(&a);
+
+      if (items_.empty())
+      {
+        disarm_timer();
+      }
+    }
+
+    void arm_timer(event_loop_context& event_loop_ctx) noexcept
+    {
+      assert(nullptr == timer_event_loop_ctx_);
+      timer_event_loop_ctx_ = &event_loop_ctx;
+      timer_node_.deadline = event_loop_ctx.now() + max_delay_;
+      timer_node_.cb = make_member_callback<&batcher::on_timer>(this);
+      timer_event_loop_ctx_->insert_timer_node(timer_node_);
+    }
+
+    void disarm_timer() noexcept
+    {
+      if (nullptr != timer_event_loop_ctx_)
+      {
+        timer_event_loop_ctx_->remove_timer_node(timer_node_);
+        timer_event_loop_ctx_ = nullptr;
+      }
+    }
+
+    void on_timer() noexcept
+    {
+      // already removed from the heap by the event loop
+      timer_event_loop_ctx_ = nullptr;
+      flush(nullptr);
+    }
+
+    void flush(awaiter* immediate) noexcept
+    {
+      disarm_timer();
+
+      std::exception_ptr e;
+      try
+      {
+        results_.clear();
+        results_.resize(items_.size());
+        flush_fn_(std::span<T>(items_), std::span<R>(results_));
+      }
+      catch(...)
+      {
+        e = std::current_exception();
+      }
+
+      wait_list local_wait_list = std::move(wait_list_);
+      while (true)
+      {
+        auto* waiting = local_wait_list.pop_front();
+        if (waiting == nullptr)
+        {
+          break;
+        }
+        waiting->set_result((e ? nullptr : &results_[waiting->index_]), e);
+        waiting->on_flushed();
+      }
+      if (immediate != nullptr)
+      {
+        immediate->set_result((e ? nullptr : &results_[immediate->index_]), e);
+      }
+
+      items_.clear();
+      results_.clear();
+    }
+  };
+}
@@ -0,0 +1,451 @@
+#pragma once
+
+#include "abi.h"
+#include "fd_io.h"
+#include "io_poller.h"
+#include "void_result.h"
+
+#include <cassert>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <system_error>
+
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace CORO_ST_NAMESPACE
+{
+  inline constexpr size_t buffered_stream_default_capacity = 64 * 1024;
+
+  namespace impl
+  {
+    struct read_until_op;
+    struct read_exact_op;
+    struct buffered_write_op;
+    struct buffered_flush_op;
+  }
+
+  using read_until_task = impl::fd_op_task<impl::make_op<impl::read_until_op>>;
+  using read_exact_task = impl::fd_op_task<impl::make_op<impl::read_exact_op>>;
+  using buffered_write_task = impl::fd_op_task<impl::make_op<impl::buffered_write_op>>;
+  using buffered_flush_task = impl::fd_op_task<impl::make_op<impl::buffered_flush_op>>;
+
+  // Reads from a non-blocking fd in large chunks, for parsing protocols
+  // without a system call per field.
+  //
+  // The results are views into the internal buffer, valid until the next
+  // read from the same reader. Unconsumed data is moved to the start of the
+  // buffer only when more has to be read.
+  //
+  // One read at a time, the reader has to outlive it.
+  class buffered_reader
+  {
+    int fd_;
+    std::unique_ptr<char[]> buffer_;
+    size_t capacity_;
+    size_t begin_{ 0 };
+    size_t end_{ 0 };
+    // bytes from begin_ already searched for the delimiter
+    size_t searched_{ 0 };
+
+  public:
+    explicit buffered_reader(fd_arg fd, size_t capacity = buffered_stream_default_capacity) :
+      fd_{ fd.h },
+      buffer_{ std::make_unique_for_overwrite<char[]>(capacity) },
+      capacity_{ capacity }
+    {
+      assert(capacity > 0);
+    }
+
+    buffered_reader(const buffered_reader&) = delete;
+    buffered_reader& operator=(const buffered_reader&) = delete;
+
+    int fd() const noexcept
+    {
+      return fd_;
+    }
+
+    size_t capacity() const noexcept
+    {
+      return capacity_;
+    }
+
+    // Read but not consumed yet
+    std::string_view buffered() const noexcept
+    {
+      return { buffer_.get() + begin_, end_ - begin_ };
+    }
+
+    // Up to and including delim, or the remaining data without delim at
+    // end of file (empty if none).
+    // Throws std::length_error if the buffer fills up without delim
+    [[nodiscard]] read_until_task async_read_until(char delim) noexcept;
+
+    // count bytes, less only at end of file.
+    // Throws std::length_error if count is larger than the capacity
+    [[nodiscard]] read_exact_task async_read_exact(size_t count) noexcept;
+
+    // Non-blocking versions: nullopt if it would block
+    std::optional<std::string_view> try_read_until(char delim)
+    {
+      while (true)
+      {
+        std::string_view data = buffered();
+        size_t pos = data.find(delim, searched_);
+        if (std::string_view::npos != pos)
+        {
+          return consume(pos + 1);
+        }
+        searched_ = data.size();
+        if (data.size() == capacity_)
+        {
+          throw std::length_error("coro_st: buffered_reader delimiter not found in a full buffer");
+        }
+        std::optional<bool> filled = fill();
+        if (!filled)
+        {
+          return std::nullopt;
+        }
+        if (!*filled)
+        {
+          return consume(data.size());
+        }
+      }
+    }
+
+    std::optional<std::string_view> try_read_exact(size_t count)
+    {
+      if (count > capacity_)
+      {
+        throw std::length_error("coro_st: buffered_reader read larger than the buffer");
+      }
+      while (true)
+      {
+        size_t size = end_ - begin_;
+        if (size >= count)
+        {
+          return consume(count);
+        }
+        std::optional<bool> filled = fill();
+        if (!filled)
+        {
+          return std::nullopt;
+        }
+        if (!*filled)
+        {
+          return consume(size);
+        }
+      }
+    }
+
+  private:
+    std::string_view consume(size_t count) noexcept
+    {
+      std::string_view result{ buffer_.get() + begin_, count };
+      begin_ += count;
+      searched_ = 0;
+      return result;
+    }
+
+    // false at end of file, nullopt if it would block
+    std::optional<bool> fill()
+    {
+      if (begin_ > 0)
+      {
+        std::memmove(buffer_.get(), buffer_.get() + begin_, end_ - begin_);
+        end_ -= begin_;
+        begin_ = 0;
+      }
+      while (true)
+      {
+        ssize_t count = ::read(fd_, buffer_.get() + end_, capacity_ - end_);
+        if (count >= 0)
+        {
+          end_ += static_cast<size_t>(count);
+          return count > 0;
+        }
+        if (EINTR == errno)
+        {
+          continue;
+        }
+        if ((EAGAIN == errno) || (EWOULDBLOCK == errno))
+        {
+          return std::nullopt;
+        }
+        throw std::system_error(errno, std::generic_category(), "read");
+      }
+    }
+  };
+
+  // Collects small writes to a non-blocking fd in a buffer. When the buffer
+  // can't take more, the buffered data and the new data are written
+  // together with writev (large writes are not copied).
+  //
+  // The destructor does not flush, use async_flush.
+  //
+  // One write or flush at a time, the writer has to outlive it.
+  class buffered_writer
+  {
+    int fd_;
+    std::unique_ptr<char[]> buffer_;
+    size_t capacity_;
+    size_t begin_{ 0 };
+    size_t end_{ 0 };
+
+  public:
+    explicit buffered_writer(fd_arg fd, size_t capacity = buffered_stream_default_capacity) :
+      fd_{ fd.h },
+      buffer_{ std::make_unique_for_overwrite<char[]>(capacity) },
+      capacity_{ capacity }
+    {
+      assert(capacity > 0);
+    }
+
+    buffered_writer(const buffered_writer&) = delete;
+    buffered_writer& operator=(const buffered_writer&) = delete;
+
+    int fd() const noexcept
+    {
+      return fd_;
+    }
+
+    size_t capacity() const noexcept
+    {
+      return capacity_;
+    }
+
+    // Written but not flushed yet
+    std::string_view buffered() const noexcept
+    {
+      return { buffer_.get() + begin_, end_ - begin_ };
+    }
+
+    // Completes when data is buffered or written, without suspending if it
+    // fits in the buffer. data has to outlive the write
+    [[nodiscard]] buffered_write_task async_write(std::span<const char> data) noexcept;
+
+    // Completes when all the buffered data is written
+    [[nodiscard]] buffered_flush_task async_flush() noexcept;
+
+    // Non-blocking versions: false if it would block, data is updated to
+    // what's left to write
+    bool try_write(std::span<const char>& data)
+    {
+      while (true)
+      {
+        size_t size = end_ - begin_;
+        if (data.size() <= capacity_ - size)
+        {
+          if (data.size() > capacity_ - end_)
+          {
+            std::memmove(buffer_.get(), buffer_.get() + begin_, size);
+            begin_ = 0;
+            end_ = size;
+          }
+          if (!data.empty())
+          {
+            std::memcpy(buffer_.get() + end_, data.data(), data.size());
+          }
+          end_ += data.size();
+          data = {};
+          return true;
+        }
+
+        iovec iov[2];
+        iov[0].iov_base = buffer_.get() + begin_;
+        iov[0].iov_len = size;
+        iov[1].iov_base = const_cast<char*>(data.data());
+        iov[1].iov_len = data.size();
+        std::optional<size_t> count = write(iov, 2);
+        if (!count)
+        {
+          return false;
+        }
+        size_t from_buffer = (*count < size) ? *count : size;
+        begin_ += from_buffer;
+        data = data.subspan(*count - from_buffer);
+        reset_if_empty();
+      }
+    }
+
+    bool try_flush()
+    {
+      while (begin_ != end_)
+      {
+        iovec iov[1];
+        iov[0].iov_base = buffer_.get() + begin_;
+        iov[0].iov_len = end_ - begin_;
+        std::optional<size_t> count = write(iov, 1);
+        if (!count)
+        {
+          return false;
+        }
+        begin_ += *count;
+      }
+      reset_if_empty();
+      return true;
+    }
+
+  private:
+    void reset_if_empty() noexcept
+    {
+      if (begin_ == end_)
+      {
+        begin_ = 0;
+        end_ = 0;
+      }
+    }
+
+    // nullopt if it would block
+    std::optional<size_t> write(const iovec* iov, int iov_count)
+    {
+      while (true)
+      {
+        ssize_t count = ::writev(fd_, iov, iov_count);
+        if (count >= 0)
+        {
+          return static_cast<size_t>(count);
+        }
+        if (EINTR == errno)
+        {
+          continue;
+        }
+        if ((EAGAIN == errno) || (EWOULDBLOCK == errno))
+        {
+          return std::nullopt;
+        }
+        throw std::system_error(errno, std::generic_category(), "writev");
+      }
+    }
+  };
+
+  namespace impl
+  {
+    struct read_until_op
+    {
+      using result_type = std::string_view;
+
+      buffered_reader* reader_;
+      char delim_;
+
+      int fd() const noexcept
+      {
+        return reader_->fd();
+      }
+
+      std::uint32_t events() const noexcept
+      {
+        return EPOLLIN;
+      }
+
+      std::optional<std::string_view> try_op()
+      {
+        return reader_->try_read_until(delim_);
+      }
+    };
+
+    struct read_exact_op
+    {
+      using result_type = std::string_view;
+
+      buffered_reader* reader_;
+      size_t count_;
+
+      int fd() const noexcept
+      {
+        return reader_->fd();
+      }
+
+      std::uint32_t events() const noexcept
+      {
+        return EPOLLIN;
+      }
+
+      std::optional<std::string_view> try_op()
+      {
+        return reader_->try_read_exact(count_);
+      }
+    };
+
+    struct buffered_write_op
+    {
+      using result_type = void_result;
+
+      buffered_writer* writer_;
+      std::span<const char> data_;
+
+      int fd() const noexcept
+      {
+        return writer_->fd();
+      }
+
+      std::uint32_t events() const noexcept
+      {
+        return EPOLLOUT;
+      }
+
+      std::optional<void_result> try_op()
+      {
+        if (!writer_->try_write(data_))
+        {
+          return std::nullopt;
+        }
+        return void_result{};
+      }
+    };
+
+    struct buffered_flush_op
+    {
+      using result_type = void_result;
+
+      buffered_writer* writer_;
+
+      int fd() const noexcept
+      {
+        return writer_->fd();
+      }
+
+      std::uint32_t events() const noexcept
+      {
+        return EPOLLOUT;
+      }
+
+      std::optional<void_result> try_op()
+      {
+        if (!writer_->try_flush())
+        {
+          return std::nullopt;
+        }
+        return void_result{};
+      }
+    };
+  }
+
+  inline read_until_task buffered_reader::async_read_until(char delim) noexcept
+  {
+    return read_until_task{ impl::make_op<impl::read_until_op>{ { this, delim } } };
+  }
+
+  inline read_exact_task buffered_reader::async_read_exact(size_t count) noexcept
+  {
+    return read_exact_task{ impl::make_op<impl::read_exact_op>{ { this, count } } };
+  }
+
+  inline buffered_write_task buffered_writer::async_write(std::span<const char> data) noexcept
+  {
+    return buffered_write_task{ impl::make_op<impl::buffered_write_op>{ { this, data } } };
+  }
+
+  inline buffered_flush_task buffered_writer::async_flush() noexcept
+  {
+    return buffered_flush_task{ impl::make_op<impl::buffered_flush_op>{ { this } } };
+  }
+}
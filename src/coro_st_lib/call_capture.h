@@ -1,11 +1,13 @@
 #pragma once
 
+#include "abi.h"
+
 #include <tuple>
 #include <type_traits>
 #include <functional>
 #include <utility>
 
-namespace coro_st
+namespace CORO_ST_NAMESPACE
 {
   template<typename Fn, typename... Args>
   class call_capture
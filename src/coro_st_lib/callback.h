@@ -1,15 +1,19 @@
 #pragma once
 
+#include "abi.h"
+
 #include <cassert>
 #include <coroutine>
 #include <functional>
 
-namespace coro_st
+namespace CORO_ST_NAMESPACE
 {
   class callback
   {
+  public:
     using pure_callback_fn = void (*)(void* x) noexcept;
 
+  private:
     void* x_{ nullptr };
     pure_callback_fn fn_ { nullptr };
 
@@ -40,6 +44,17 @@ namespace coro_st
     {
       return nullptr != fn_;
     }
+
+    // For diagnostics e.g. to identify a callback that blocks the loop
+    pure_callback_fn get_fn() const noexcept
+    {
+      return fn_;
+    }
+
+    void* get_x() const noexcept
+    {
+      return x_;
+    }
   };
 
   template<typename T, void (*fn)(T&) noexcept>
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "abi.h"
 #include "context.h"
 #include "coro_type_traits.h"
 #include "stop_util.h"
@@ -7,7 +8,7 @@
 #include <cassert>
 #include <coroutine>
 
-namespace coro_st
+namespace CORO_ST_NAMESPACE
 {
   template<typename T, is_co_task CoTask>
   class [[nodiscard]] cast_task
@@ -137,7 +138,7 @@ namespace coro_st
 
         if (parent_handle_)
         {
-          parent_handle_.resume();
+          parent_ctx_.resume_coroutine(parent_handle_);
           return;
         }
 
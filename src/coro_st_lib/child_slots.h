@@ -0,0 +1,392 @@
+#pragma once
+
+#include "abi.h"
+#include "callback.h"
+#include "context.h"
+#include "coro_type_traits.h"
+#include "stop_util.h"
+
+#include <algorithm>
+#include <cassert>
+#include <coroutine>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <ranges>
+#include <type_traits>
+
+namespace CORO_ST_NAMESPACE
+{
+  namespace impl
+  {
+    // Common part of the awaiters of async_transform and async_as_completed:
+    // runs fn(item) as children for the items in a range, at most
+    // max_in_flight at a time, in slots reused as the children complete.
+    //
+    // The first error or stop cancels the children in flight and no further
+    // items are started.
+    //
+    // Derived is called with `on_child_result(index, co_awaiter)` for each
+    // child that completes with a value while there is no error or stop, it
+    // can call `stop_early()` to cancel the remaining children without
+    // stopping the parent
+    template<typename Derived, std::ranges::forward_range Range, typename Fn>
+      requires std::ranges::sized_range<Range>
+    class child_slots_awaiter
+    {
+    protected:
+      using Iterator = std::ranges::iterator_t<Range>;
+      using CoTask = std::invoke_result_t<Fn&, std::ranges::range_reference_t<Range>>;
+      static_assert(is_co_task<CoTask>);
+      using CoAwaiter = co_task_awaiter_t<CoTask>;
+
+    private:
+      enum class outcome_state
+      {
+        has_result,
+        has_stop,
+      };
+
+      // A slot runs one child at a time, it is reused for the
+      // next item when the child completes
+      struct slot
+      {
+        child_slots_awaiter* owner_{ nullptr };
+        size_t index_{ 0 };
+        slot* next_free_{ nullptr };
+        std::optional<context> ctx_;
+        std::optional<CoAwaiter> co_awaiter_;
+
+        slot() noexcept = default;
+
+        slot(const slot&) = delete;
+        slot& operator=(const slot&) = delete;
+
+        void on_result_ready() noexcept
+        {
+          owner_->on_slot_result_ready(*this);
+        }
+
+        void on_stopped() noexcept
+        {
+          owner_->on_slot_stopped(*this);
+        }
+      };
+
+      // Allows constructing the non movable child awaiter in place
+      struct co_awaiter_builder
+      {
+        Fn* fn_;
+        Iterator* it_;
+        context* ctx_;
+
+        operator CoAwaiter() const
+        {
+          return std::invoke(*fn_, **it_).get_work().get_awaiter(*ctx_);
+        }
+      };
+
+      context& parent_ctx_;
+      std::coroutine_handle<> parent_handle_;
+      std::optional<stop_callback<callback>> parent_stop_cb_;
+      stop_source children_stop_source_;
+      size_t pending_count_;
+      std::exception_ptr exception_;
+      outcome_state outcome_state_{ outcome_state::has_result };
+      // the derived awaiter asked to cancel the rest
+      bool done_early_{ false };
+      Fn fn_;
+      Iterator next_it_;
+      Iterator end_it_;
+      size_t item_count_;
+      size_t next_index_{ 0 };
+      bool launching_{ false };
+      size_t slot_count_;
+      std::unique_ptr<slot[]> slots_;
+      slot* first_free_{ nullptr };
+
+    protected:
+      child_slots_awaiter(
+        context& parent_ctx,
+        Range& range,
+        size_t max_in_flight,
+        Fn& fn
+      ) :
+        parent_ctx_{ parent_ctx },
+        parent_handle_{},
+        parent_stop_cb_{},
+        children_stop_source_{},
+        pending_count_{ 0 },
+        exception_{},
+        outcome_state_{ outcome_state::has_result },
+        done_early_{ false },
+        fn_{ std::move(fn) },
+        next_it_{ std::ranges::begin(range) },
+        end_it_{ std::ranges::end(range) },
+        item_count_{ static_cast<size_t>(std::ranges::size(range)) },
+        next_index_{ 0 },
+        launching_{ false },
+        slot_count_{ std::min(max_in_flight, item_count_) },
+        slots_{ std::make_unique<slot[]>(slot_count_) },
+        first_free_{ nullptr }
+      {
+        for (size_t i = slot_count_; i > 0; --i)
+        {
+          slot& s = slots_[i - 1];
+          s.owner_ = this;
+          s.ctx_.emplace(
+            parent_ctx_,
+            children_stop_source_.get_token(),
+            make_member_completion<
+              &slot::on_result_ready,
+              &slot::on_stopped
+              >(&s));
+          push_free(s);
+        }
+      }
+
+    public:
+      child_slots_awaiter(const child_slots_awaiter&) = delete;
+      child_slots_awaiter& operator=(const child_slots_awaiter&) = delete;
+
+      [[nodiscard]] constexpr bool await_ready() const noexcept
+      {
+        return false;
+      }
+
+      bool await_suspend(std::coroutine_handle<> handle) noexcept
+      {
+        parent_handle_ = handle;
+
+        pending_count_ = 1;
+        init_parent_cancellation_callback();
+
+        launch_children();
+
+        --pending_count_;
+        if (0 != pending_count_)
+        {
+          return true;
+        }
+
+        parent_stop_cb_.reset();
+
+        if (outcome_state::has_stop == outcome_state_)
+        {
+          parent_ctx_.invoke_stopped();
+          return true;
+        }
+
+        return false;
+      }
+
+      std::exception_ptr get_result_exception() const noexcept
+      {
+        return exception_;
+      }
+
+      void start() noexcept
+      {
+        pending_count_ = 1;
+        init_parent_cancellation_callback();
+
+        launch_children();
+
+        --pending_count_;
+        if (0 != pending_count_)
+        {
+          return;
+        }
+
+        parent_stop_cb_.reset();
+
+        if (outcome_state::has_stop == outcome_state_)
+        {
+          parent_ctx_.invoke_stopped();
+          return;
+        }
+
+        parent_ctx_.invoke_result_ready();
+      }
+
+    protected:
+      size_t item_count() const noexcept
+      {
+        return item_count_;
+      }
+
+      void rethrow_if_exception() const
+      {
+        if (exception_)
+        {
+          std::rethrow_exception(exception_);
+        }
+      }
+
+      void stop_early() noexcept
+      {
+        done_early_ = true;
+        children_stop_source_.request_stop();
+      }
+
+    private:
+      void push_free(slot& s) noexcept
+      {
+        s.next_free_ = first_free_;
+        first_free_ = &s;
+      }
+
+      slot* pop_free() noexcept
+      {
+        slot* s = first_free_;
+        if (s != nullptr)
+        {
+          first_free_ = s->next_free_;
+          s->next_free_ = nullptr;
+        }
+        return s;
+      }
+
+      void init_parent_cancellation_callback() noexcept
+      {
+        parent_stop_cb_.emplace(
+          parent_ctx_.get_stop_token(),
+          make_member_callback<&child_slots_awaiter::on_parent_cancel>(this));
+      }
+
+      void on_parent_cancel() noexcept
+      {
+        parent_stop_cb_.reset();
+        outcome_state_ = outcome_state::has_stop;
+        children_stop_source_.request_stop();
+      }
+
+      void set_exception(std::exception_ptr e) noexcept
+      {
+        if (!exception_)
+        {
+          exception_ = e;
+          children_stop_source_.request_stop();
+        }
+      }
+
+      // Loop rather than recurse: children that complete immediately
+      // free their slot while we're still in the loop below
+      void launch_children() noexcept
+      {
+        if (launching_)
+        {
+          return;
+        }
+        launching_ = true;
+
+        while (
+          (next_it_ != end_it_) &&
+          !children_stop_source_.stop_requested())
+        {
+          slot* s = pop_free();
+          if (s == nullptr)
+          {
+            break;
+          }
+          s->index_ = next_index_;
+          try
+          {
+            s->co_awaiter_.emplace(co_awaiter_builder{ &fn_, &next_it_, &*s->ctx_ });
+          }
+          catch(...)
+          {
+            push_free(*s);
+            set_exception(std::current_exception());
+            break;
+          }
+          ++next_it_;
+          ++next_index_;
+          ++pending_count_;
+          s->co_awaiter_->start();
+        }
+
+        launching_ = false;
+      }
+
+      void on_slot_result_ready(slot& s) noexcept
+      {
+        if (
+          (outcome_state::has_result == outcome_state_) &&
+          !exception_ &&
+          !done_early_)
+        {
+          std::exception_ptr e = s.co_awaiter_->get_result_exception();
+          if (e)
+          {
+            set_exception(e);
+          }
+          else
+          {
+            try
+            {
+              static_cast<Derived&>(*this).on_child_result(s.index_, *s.co_awaiter_);
+            }
+            catch(...)
+            {
+              set_exception(std::current_exception());
+            }
+          }
+        }
+
+        on_slot_completed(s);
+      }
+
+      void on_slot_stopped(slot& s) noexcept
+      {
+        if (outcome_state::has_result == outcome_state_)
+        {
+          if (!children_stop_source_.stop_requested())
+          {
+            outcome_state_ = outcome_state::has_stop;
+            children_stop_source_.request_stop();
+          }
+        }
+
+        on_slot_completed(s);
+      }
+
+      void on_slot_completed(slot& s) noexcept
+      {
+        // the child invoked this completion as its last action,
+        // it's safe to destroy it and reuse the slot
+        s.co_awaiter_.reset();
+        push_free(s);
+
+        launch_children();
+
+        --pending_count_;
+        if (0 != pending_count_)
+        {
+          return;
+        }
+
+        on_shared_continue();
+      }
+
+      void on_shared_continue() noexcept
+      {
+        parent_stop_cb_.reset();
+
+        if (outcome_state::has_stop == outcome_state_)
+        {
+          parent_ctx_.invoke_stopped();
+          return;
+        }
+
+        if (parent_handle_)
+        {
+          parent_ctx_.resume_coroutine(parent_handle_);
+          return;
+        }
+
+        parent_ctx_.invoke_result_ready();
+      }
+    };
+  }
+}
@@ -1,26 +1,151 @@
 #pragma once
 
+#include "abi.h"
 #include "context.h"
 #include "coro_type_traits.h"
+#include "type_name.h"
 #include "unique_coroutine_handle.h"
 #include "promise_base.h"
 
 #include <cassert>
 #include <coroutine>
+#include <cstddef>
+#include <new>
+#include <source_location>
+#include <type_traits>
 #include <utility>
 
-namespace coro_st
+namespace CORO_ST_NAMESPACE
 {
+  namespace impl
+  {
+    // Wraps the awaiter for a co_await in a coroutine when the loop hooks
+    // policy has on_co_suspend/on_co_resume
+    template<typename Awaiter>
+    class [[nodiscard]] co_hooks_awaiter
+    {
+      co_frame_t<loop_hooks>& frame_;
+      Awaiter awaiter_;
+      bool suspended_{ false };
+
+    public:
+      template<typename MakeAwaiter>
+      co_hooks_awaiter(co_frame_t<loop_hooks>& frame, MakeAwaiter make_awaiter) :
+        frame_{ frame },
+        awaiter_{ make_awaiter() }
+      {
+      }
+
+      co_hooks_awaiter(const co_hooks_awaiter&) = delete;
+      co_hooks_awaiter& operator=(const co_hooks_awaiter&) = delete;
+
+      [[nodiscard]] bool await_ready() noexcept
+      {
+        return awaiter_.await_ready();
+      }
+
+      // The suspend hook runs before the inner await_suspend, which might
+      // start other coroutines inline, or resume (and destroy) this one
+      template<typename Promise>
+      auto await_suspend(std::coroutine_handle<Promise> handle) noexcept
+      {
+        suspended_ = true;
+        impl::hooks_on_co_suspend(frame_);
+        using result_type = decltype(awaiter_.await_suspend(handle));
+        if constexpr (std::is_void_v<result_type>)
+        {
+          awaiter_.await_suspend(handle);
+        }
+        else if constexpr (std::is_same_v<bool, result_type>)
+        {
+          bool suspended = awaiter_.await_suspend(handle);
+          if (!suspended)
+          {
+            suspended_ = false;
+            impl::hooks_on_co_resume(frame_, false);
+          }
+          return suspended;
+        }
+        else
+        {
+          std::coroutine_handle<> next = awaiter_.await_suspend(handle);
+          if (next == handle)
+          {
+            suspended_ = false;
+            impl::hooks_on_co_resume(frame_, false);
+          }
+          return next;
+        }
+      }
+
+      decltype(auto) await_resume()
+      {
+        if (suspended_)
+        {
+          impl::hooks_on_co_resume(frame_, true);
+        }
+        return awaiter_.await_resume();
+      }
+    };
+  }
+
+  namespace impl
+  {
+    struct co_hooks_initial_awaiter
+    {
+      co_frame_t<loop_hooks>& frame_;
+
+      [[nodiscard]] constexpr bool await_ready() const noexcept
+      {
+        return false;
+      }
+
+      constexpr void await_suspend(std::coroutine_handle<>) const noexcept
+      {
+      }
+
+      void await_resume() noexcept
+      {
+        hooks_on_co_resume(frame_, true);
+      }
+    };
+
+    // The coroutine frames are allocated via here
+    // if the loop hooks policy has on_allocation
+    template<typename Hooks>
+    struct co_allocation
+    {
+    };
+
+    template<typename Hooks>
+      requires has_on_allocation<Hooks>
+    struct co_allocation<Hooks>
+    {
+      static void* operator new(std::size_t size)
+      {
+        Hooks::on_allocation(size);
+        return ::operator new(size);
+      }
+
+      static void operator delete(void* ptr, std::size_t size) noexcept
+      {
+        ::operator delete(ptr, size);
+      }
+    };
+  }
+
   template<typename T>
   class [[nodiscard]] co
   {
   public:
-    class promise_type : public promise_base<T>
+    class promise_type : public promise_base<T>, public impl::co_allocation<loop_hooks>
     {
       friend co;
 
       context* pctx_{ nullptr };
       std::coroutine_handle<> parent_coro_;
+      // see loop_hooks_policy.h, empty unless the policy has a co_frame
+      [[no_unique_address]] impl::co_frame_t<loop_hooks> hooks_frame_;
 
     public:
       promise_type() noexcept = default;
@@ -33,9 +158,16 @@ namespace coro_st
         return {std::coroutine_handle<promise_type>::from_promise(*this)};
       }
 
-      std::suspend_always initial_suspend() noexcept
+      auto initial_suspend() noexcept
       {
-        return {};
+        if constexpr (impl::has_co_suspend_hooks<loop_hooks>)
+        {
+          return impl::co_hooks_initial_awaiter{ hooks_frame_ };
+        }
+        else
+        {
+          return std::suspend_always{};
+        }
       }
 
       struct final_awaiter
@@ -49,6 +181,8 @@ namespace coro_st
 
         std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> child_coro) noexcept
         {
+          impl::hooks_on_co_suspend(child_coro.promise().hooks_frame_);
+
           // We're the first one in a chain in a .resume
           // from either start or from the run loop,
           // so we could invoke instead of schedule.
@@ -66,6 +200,7 @@ namespace coro_st
           auto parent_coro = child_coro.promise().parent_coro_;
           if (parent_coro)
           {
+            loop_hooks::on_coroutine_resume(parent_coro);
             return parent_coro;
           }
 
@@ -86,10 +221,40 @@ namespace coro_st
       }
 
       template<coro_st::is_co_task CoTask>
+        requires (!impl::has_on_co_await<loop_hooks>)
       auto await_transform(CoTask co_task)
       {
         assert(pctx_ != nullptr);
-        return co_task.get_work().get_awaiter(*pctx_);
+        return get_awaiter(co_task);
+      }
+
+      // Only if the loop hooks policy needs the source location
+      template<coro_st::is_co_task CoTask>
+        requires impl::has_on_co_await<loop_hooks>
+      auto await_transform(
+        CoTask co_task,
+        std::source_location location = std::source_location::current())
+      {
+        assert(pctx_ != nullptr);
+        impl::hooks_on_co_await(hooks_frame_, impl::type_name<CoTask>(), location);
+        return get_awaiter(co_task);
+      }
+
+    private:
+      template<coro_st::is_co_task CoTask>
+      auto get_awaiter(CoTask& co_task)
+      {
+        auto make_awaiter = [&] {
+          return co_task.get_work().get_awaiter(*pctx_);
+        };
+        if constexpr (impl::has_co_suspend_hooks<loop_hooks>)
+        {
+          return impl::co_hooks_awaiter<decltype(make_awaiter())>{ hooks_frame_, make_awaiter };
+        }
+        else
+        {
+          return make_awaiter();
+        }
       }
     };
 
@@ -106,7 +271,10 @@ namespace coro_st
         // on g++ that made me use -Wno-dangling-pointer on g++ -O3 build
         // but the context should outlive the awaiter which should outlive the
         // promise on the coroutine frame (which gets destroyed by this awaiter)
-        unique_child_coro_.get().promise().pctx_ = &ctx;
+        promise_type& promise = unique_child_coro_.get().promise();
+        promise.pctx_ = &ctx;
+        impl::hooks_on_co_attach(
+          promise.hooks_frame_, ctx, unique_child_coro_.get(), &promise.parent_coro_);
       }
 
       awaiter(const awaiter&) = delete;
@@ -122,6 +290,7 @@ namespace coro_st
         std::coroutine_handle<promise_type> child_coro = unique_child_coro_.get();
         assert(!child_coro.promise().parent_coro_);
         child_coro.promise().parent_coro_ = parent_coro;
+        loop_hooks::on_coroutine_resume(child_coro);
         return child_coro;
       }
 
@@ -137,7 +306,9 @@ namespace coro_st
 
       void start() noexcept
       {
-        unique_child_coro_.get().resume();
+        std::coroutine_handle<promise_type> child_coro = unique_child_coro_.get();
+        loop_hooks::on_coroutine_resume(child_coro);
+        child_coro.resume();
       }
     };
 
@@ -1,10 +1,11 @@
 #pragma once
 
+#include "abi.h"
 #include "callback.h"
 
 #include <cassert>
 
-namespace coro_st
+namespace CORO_ST_NAMESPACE
 {
   class completion
   {
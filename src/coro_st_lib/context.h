@@ -1,19 +1,31 @@
 #pragma once
 
+#include "abi.h"
 #include "event_loop_context.h"
 #include "completion.h"
+#include "loop_hooks.h"
 #include "stop_util.h"
 
+#include <chrono>
 #include <coroutine>
+#include <type_traits>
 
-namespace coro_st
+namespace CORO_ST_NAMESPACE
 {
   class context
   {
+    // With a deadline only if the loop hooks policy has deadline_scheduling
+    using chain_node = std::conditional_t<
+      impl::deadline_scheduling_v<loop_hooks>,
+      deadline_ready_node,
+      ready_node>;
+
     event_loop_context& event_loop_ctx_;
     stop_token token_;
     completion completion_;
-    ready_node node_;
+    chain_node node_;
+    // see loop_hooks_policy.h, empty unless the policy has a context_data
+    [[no_unique_address]] impl::context_data_t<loop_hooks> hooks_data_;
 
   public:
     context(
@@ -24,10 +36,12 @@ namespace coro_st
       event_loop_ctx_{ event_loop_ctx },
       token_{ token },
       completion_{ completion },
-      node_{}
+      node_{},
+      hooks_data_{}
     {
     }
 
+    // Inherits the deadline and the hooks data of the parent
     context(
       context& parent_context,
       stop_token token,
@@ -36,8 +50,10 @@ namespace coro_st
       event_loop_ctx_{ parent_context.event_loop_ctx_ },
       token_{ token },
       completion_{ completion },
-      node_{}
+      node_{},
+      hooks_data_{ parent_context.hooks_data_ }
     {
+      impl::set_node_deadline(node_, impl::get_node_deadline(parent_context.node_));
     }
 
     context(const context&) = delete;
@@ -58,6 +74,25 @@ namespace coro_st
       return event_loop_ctx_.remove_timer_node(node);
     }
 
+    std::chrono::steady_clock::time_point now() const noexcept
+    {
+      return event_loop_ctx_.now();
+    }
+
+    // Scheduling deadline: work scheduled for a chain with a deadline
+    // runs before work without one, earliest deadline first.
+    // Only if the loop hooks policy has deadline_scheduling
+    std::chrono::steady_clock::time_point get_deadline() const noexcept
+    {
+      return impl::get_node_deadline(node_);
+    }
+
+    // Only while the chain node is not scheduled
+    void set_deadline(std::chrono::steady_clock::time_point deadline) noexcept
+    {
+      impl::set_node_deadline(node_, deadline);
+    }
+
     stop_token get_stop_token() noexcept
     {
       return token_;
@@ -65,37 +100,84 @@ namespace coro_st
 
     void invoke_result_ready() noexcept
     {
+      loop_hooks::on_completion(*this, false);
       callback cb = completion_.get_result_ready_callback();
       cb.invoke();
     }
 
     void schedule_result_ready() noexcept
     {
+      loop_hooks::on_completion(*this, false);
       node_.cb = completion_.get_result_ready_callback();
       event_loop_ctx_.push_ready_node(node_);
     }
 
     void invoke_stopped() noexcept
     {
+      loop_hooks::on_completion(*this, true);
       callback cb = completion_.get_stopped_callback();
       cb.invoke();
     }
 
     void schedule_stopped() noexcept
     {
+      loop_hooks::on_completion(*this, true);
       node_.cb = completion_.get_stopped_callback();
       event_loop_ctx_.push_ready_node(node_);
     }
 
+    // Resumes are either inline through here or scheduled below,
+    // so that the loop hooks see them all
+    void resume_coroutine(std::coroutine_handle<void> handle) noexcept
+    {
+      loop_hooks::on_coroutine_resume(handle);
+      handle.resume();
+    }
+
     void schedule_coroutine_resume(std::coroutine_handle<void> handle) noexcept
     {
-      node_.cb = make_resume_coroutine_callback(handle);
+      node_.cb = callback{ handle.address(), &context::resume_scheduled_coroutine };
       event_loop_ctx_.push_ready_node(node_);
     }
 
+    // Null unless opted in via `run_options::async_stacks`
+    async_stack_registry* get_async_stacks() const noexcept
+    {
+      return event_loop_ctx_.get_async_stacks();
+    }
+
+    // The loop hooks policy's data for the chain, inherited by child chains
+    impl::context_data_t<loop_hooks>& get_hooks_data() noexcept
+    {
+      return hooks_data_;
+    }
+
+    // The data of a policy combined in the loop hooks policy, or of the
+    // policy itself, see combine_loop_hooks
+    template<typename Part>
+    impl::context_data_t<Part>& get_hooks_data() noexcept
+    {
+      return impl::context_data_part<Part>(hooks_data_);
+    }
+
     ready_node& get_chain_node() noexcept
     {
       return node_;
     }
+
+    // For objects that outlive the chain that created them
+    // e.g. a timer shared by several chains
+    event_loop_context& get_event_loop_context() noexcept
+    {
+      return event_loop_ctx_;
+    }
+
+  private:
+    static void resume_scheduled_coroutine(void* x) noexcept
+    {
+      std::coroutine_handle<void> handle = std::coroutine_handle<void>::from_address(x);
+      loop_hooks::on_coroutine_resume(handle);
+      handle.resume();
+    }
   };
 }
\ No newline at end of file
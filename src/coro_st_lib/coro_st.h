@@ -1,9 +1,15 @@
 #pragma once
 
+#include "abi.h"
 #include "callback.h"
 #include "stop_util.h"
+#include "loop_clock.h"
+#include "stall_watchdog.h"
+#include "async_stack.h"
+#include "task_account.h"
 #include "ready_queue.h"
 #include "timer_heap.h"
+#include "loop_hooks.h"
 #include "event_loop_context.h"
 #include "completion.h"
 #include "context.h"
@@ -11,6 +17,7 @@
 #include "coro_type_traits.h"
 #include "void_result.h"
 #include "value_type_traits.h"
+#include "spin_wait.h"
 #include "run.h"
 #include "unique_coroutine_handle.h"
 #include "promise_base.h"
@@ -22,14 +29,38 @@
 #include "wait_any_type_traits.h"
 #include "wait_any.h"
 #include "wait_all.h"
+#include "transform.h"
+#include "as_completed.h"
 #include "wait_for.h"
+#include "with_context.h"
+#include "with_deadline.h"
+#include "with_account.h"
 #include "stop_when.h"
 #include "call_capture.h"
 #include "nursery.h"
 #include "event.h"
+#include "watch.h"
+#include "latch.h"
+#include "barrier.h"
 #include "mutex.h"
+#include "singleflight.h"
+#include "batcher.h"
+#include "rate_limiter.h"
+#include "pool.h"
+#include "async_cache.h"
 #include "just_stopped.h"
 #include "stopped_as_optional.h"
 #include "just.h"
 #include "just_exception.h"
-#include "cast.h"
\ No newline at end of file
+#include "cast.h"
+
+#if defined(__linux__)
+#include "io_poller.h"
+#include "fd_io.h"
+#include "wait_signal.h"
+#include "process.h"
+#include "file_io.h"
+#include "zero_copy.h"
+#include "buffered_stream.h"
+#include "watch_path.h"
+#endif
\ No newline at end of file
@@ -1,12 +1,13 @@
 #pragma once
 
+#include "abi.h"
 #include "context.h"
 
 #include "../cpp_util_lib/intrusive_list.h"
 
 #include <coroutine>
 
-namespace coro_st
+namespace CORO_ST_NAMESPACE
 {
   class event
   {
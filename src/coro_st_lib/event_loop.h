@@ -1,58 +1,170 @@
 #pragma once
 
+#include "abi.h"
+#include "loop_clock.h"
+#include "loop_hooks.h"
 #include "ready_queue.h"
+#include "stall_watchdog.h"
 #include "timer_heap.h"
 
+#if defined(__linux__)
+#include "io_poller.h"
+#endif
+
 #include <cassert>
 #include <chrono>
 #include <optional>
+#include <thread>
 
-namespace coro_st
+namespace CORO_ST_NAMESPACE
 {
   struct event_loop
   {
     ready_queue ready_queue_;
+    ready_heap ready_heap_;
     timer_heap timers_heap_;
+    loop_clock clock_;
+    // optional, for a stall_watchdog
+    loop_heartbeat* heartbeat_{ nullptr };
+#if defined(__linux__)
+    io_poller poller_;
+    // the last idle_wait already polled the fds
+    bool io_polled_{ false };
+#endif
 
     event_loop() noexcept = default;
 
+    explicit event_loop(loop_clock::now_fn now_fn) noexcept :
+      ready_queue_{},
+      ready_heap_{},
+      timers_heap_{},
+      clock_{ now_fn },
+      heartbeat_{ nullptr }
+    {
+    }
+
     event_loop(const event_loop&) = delete;
     event_loop& operator=(const event_loop&) = delete;
 
     std::optional<std::chrono::steady_clock::duration> do_current_pending_work() noexcept
     {
+      auto now = clock_.refresh();
+
+#if defined(__linux__)
+      if (!io_polled_ && !poller_.empty())
+      {
+        poller_.wait(std::chrono::steady_clock::duration::zero());
+      }
+      io_polled_ = false;
+      while (io_node* node = poller_.pop_ready())
+      {
+        invoke(node->cb);
+      }
+#endif
+
       coro_st::ready_queue local_ready = std::move(ready_queue_);
+      if constexpr (impl::deadline_scheduling_v<loop_hooks>)
+      {
+        coro_st::ready_heap local_ready_heap = std::move(ready_heap_);
+        while (!local_ready_heap.empty())
+        {
+          auto* ready_node = local_ready_heap.min_node();
+          local_ready_heap.pop_min();
+
+          invoke(ready_node->cb);
+        }
+      }
       while (!local_ready.empty())
       {
         auto* ready_node = local_ready.pop();
 
-        callback cb = ready_node->cb;
-        assert(cb.is_callable());
-        cb.invoke();
+        invoke(ready_node->cb);
       }
       if (timers_heap_.min_node() != nullptr)
       {
-        auto now = std::chrono::steady_clock::now();
         do
         {
           auto* timer_node = timers_heap_.min_node();
           if (timer_node->deadline > now)
           {
-            if (ready_queue_.empty())
+            if (!ready_empty())
+            {
+              break;
+            }
+            // about to sleep: the cached time might be behind by the
+            // time taken by the ready work above
+            now = clock_.refresh();
+            if (timer_node->deadline > now)
             {
               return {timer_node->deadline - now};
             }
-            break;
           }
 
           timers_heap_.pop_min();
 
-          callback cb = timer_node->cb;
-          assert(cb.is_callable());
-          cb.invoke();
+          loop_hooks::on_timer_fire(*timer_node);
+          invoke(timer_node->cb);
         } while(timers_heap_.min_node() != nullptr);
       }
+#if defined(__linux__)
+      if (ready_empty() && !poller_.empty())
+      {
+        // nothing to do but wait for I/O
+        return {std::chrono::steady_clock::duration::max()};
+      }
+#endif
       return std::nullopt;
     }
+
+    // Sleeps for the duration returned by do_current_pending_work,
+    // returns early if a registered fd becomes ready.
+    // With a virtual clock it does not sleep, but advances the clock
+    // (fds are still polled, waiting only if there are no timers)
+    void idle_wait(std::chrono::steady_clock::duration sleep_time)
+    {
+      if (clock_.is_virtual() && (std::chrono::steady_clock::duration::max() != sleep_time))
+      {
+        clock_.advance_to(clock_.now() + sleep_time);
+        sleep_time = std::chrono::steady_clock::duration::zero();
+      }
+#if defined(__linux__)
+      if (!poller_.empty())
+      {
+        poller_.wait(sleep_time);
+        io_polled_ = true;
+        return;
+      }
+#endif
+      if (sleep_time > std::chrono::steady_clock::duration::zero())
+      {
+        std::this_thread::sleep_for(sleep_time);
+      }
+    }
+
+  private:
+    bool ready_empty() const noexcept
+    {
+      if constexpr (impl::deadline_scheduling_v<loop_hooks>)
+      {
+        return ready_queue_.empty() && ready_heap_.empty();
+      }
+      else
+      {
+        return ready_queue_.empty();
+      }
+    }
+
+    void invoke(callback cb) noexcept
+    {
+      assert(cb.is_callable());
+      if (nullptr == heartbeat_)
+      {
+        cb.invoke();
+        return;
+      }
+      heartbeat_->begin(cb);
+      cb.invoke();
+      heartbeat_->end();
+    }
   };
 }
\ No newline at end of file
@@ -1,19 +1,39 @@
 #pragma once
 
+#include "abi.h"
+#include "async_stack.h"
+#include "loop_clock.h"
+#include "loop_hooks.h"
 #include "ready_queue.h"
 #include "timer_heap.h"
 
 #include <cassert>
+#include <chrono>
+#include <cstdint>
 
-namespace coro_st
+namespace CORO_ST_NAMESPACE
 {
+  // Linux only, see io_poller.h and file_io.h
+  class io_poller;
+  class file_io_pool;
+
   class event_loop_context
   {
     ready_queue& ready_queue_;
+    ready_heap& ready_heap_;
     timer_heap& timer_heap_;
+    loop_clock& clock_;
+    // for the push order in the ready heap
+    std::uint64_t ready_sequence_{ 0 };
+    // optional, tracks live coroutines for dumping their stacks
+    async_stack_registry* async_stacks_{ nullptr };
+    // optional, for fd readiness
+    io_poller* io_poller_{ nullptr };
+    // optional, for blocking file I/O
+    file_io_pool* file_io_pool_{ nullptr };
   public:
-    event_loop_context(ready_queue& ready_queue, timer_heap& timer_heap) noexcept :
-      ready_queue_{ ready_queue }, timer_heap_{ timer_heap }
+    event_loop_context(ready_queue& ready_queue, ready_heap& ready_heap, timer_heap& timer_heap, loop_clock& clock) noexcept :
+      ready_queue_{ ready_queue }, ready_heap_{ ready_heap }, timer_heap_{ timer_heap }, clock_{ clock }
     {
     }
 
@@ -23,18 +43,80 @@ namespace coro_st
     void push_ready_node(ready_node& node) noexcept
     {
       assert(node.cb.is_callable());
+      loop_hooks::on_push_ready(node);
       ready_queue_.push(&node);
     }
 
+    // With deadline scheduling nodes with a deadline run first, earliest
+    // deadline first, the rest in FIFO order. Without it all are FIFO
+    void push_ready_node(deadline_ready_node& node) noexcept
+    {
+      if constexpr (impl::deadline_scheduling_v<loop_hooks>)
+      {
+        if (no_deadline != node.deadline)
+        {
+          assert(node.cb.is_callable());
+          loop_hooks::on_push_ready(node);
+          node.sequence = ready_sequence_++;
+          ready_heap_.insert(&node);
+          return;
+        }
+      }
+      push_ready_node(static_cast<ready_node&>(node));
+    }
+
     void insert_timer_node(timer_node& node) noexcept
     {
       assert(node.cb.is_callable());
+      loop_hooks::on_timer_insert(node);
       timer_heap_.insert(&node);
     }
 
     void remove_timer_node(timer_node& node) noexcept
     {
+      loop_hooks::on_timer_remove(node);
       timer_heap_.remove(&node);
     }
+
+    // The time cached at the start of the current loop iteration
+    std::chrono::steady_clock::time_point now() const noexcept
+    {
+      return clock_.now();
+    }
+
+    const loop_clock& get_clock() const noexcept
+    {
+      return clock_;
+    }
+
+    void set_async_stacks(async_stack_registry* async_stacks) noexcept
+    {
+      async_stacks_ = async_stacks;
+    }
+
+    async_stack_registry* get_async_stacks() const noexcept
+    {
+      return async_stacks_;
+    }
+
+    void set_io_poller(io_poller* poller) noexcept
+    {
+      io_poller_ = poller;
+    }
+
+    io_poller* get_io_poller() const noexcept
+    {
+      return io_poller_;
+    }
+
+    void set_file_io_pool(file_io_pool* pool) noexcept
+    {
+      file_io_pool_ = pool;
+    }
+
+    file_io_pool* get_file_io_pool() const noexcept
+    {
+      return file_io_pool_;
+    }
   };
 }
\ No newline at end of file
@@ -0,0 +1,385 @@
+#pragma once
+
+#include "abi.h"
+#include "callback.h"
+#include "co.h"
+#include "context.h"
+#include "io_poller.h"
+#include "stop_util.h"
+
+#include <cerrno>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#include <sys/epoll.h>
+#include <unistd.h>
+
+namespace CORO_ST_NAMESPACE
+{
+  namespace impl
+  {
+    // An operation on a non-blocking fd, attempted first and then again
+    // each time the io_poller reports the fd ready. Op provides:
+    // - `using result_type = ...;`
+    // - `int fd() const noexcept` and `std::uint32_t events() const noexcept`
+    //   EPOLLIN or EPOLLOUT: what to wait for, can change after each try_op;
+    //   a read and a write awaiter can wait on the same fd at the same time
+    // - `std::optional<result_type> try_op()`: nullopt if it would block
+    //   (or to yield to other work, e.g. between chunks), throws on error
+    template<typename Op>
+    class [[nodiscard]] fd_op_awaiter
+    {
+      using result_type = typename Op::result_type;
+
+      context& ctx_;
+      io_poller& poller_;
+      Op op_;
+      io_node io_node_;
+      bool registered_{ false };
+      int registered_fd_{ -1 };
+      std::uint32_t registered_events_{ 0 };
+      std::coroutine_handle<> parent_handle_;
+      std::optional<stop_callback<callback>> parent_stop_cb_;
+      std::optional<result_type> result_;
+      std::exception_ptr exception_;
+
+    public:
+      fd_op_awaiter(context& ctx, io_poller& poller, Op&& op) noexcept :
+        ctx_{ ctx },
+        poller_{ poller },
+        op_{ std::move(op) },
+        io_node_{},
+        registered_{ false },
+        registered_fd_{ -1 },
+        registered_events_{ 0 },
+        parent_handle_{},
+        parent_stop_cb_{ std::nullopt },
+        result_{},
+        exception_{}
+      {
+      }
+
+      fd_op_awaiter(const fd_op_awaiter&) = delete;
+      fd_op_awaiter& operator=(const fd_op_awaiter&) = delete;
+
+      ~fd_op_awaiter()
+      {
+        unregister();
+      }
+
+      [[nodiscard]] constexpr bool await_ready() const noexcept
+      {
+        return false;
+      }
+
+      bool await_suspend(std::coroutine_handle<> handle) noexcept
+      {
+        parent_handle_ = handle;
+        if (ctx_.get_stop_token().stop_requested())
+        {
+          ctx_.invoke_stopped();
+          return true;
+        }
+        return wait();
+      }
+
+      result_type await_resume()
+      {
+        if (exception_)
+        {
+          std::rethrow_exception(exception_);
+        }
+        return std::move(*result_);
+      }
+
+      std::exception_ptr get_result_exception() const noexcept
+      {
+        return exception_;
+      }
+
+      void start() noexcept
+      {
+        if (ctx_.get_stop_token().stop_requested())
+        {
+          ctx_.invoke_stopped();
+          return;
+        }
+        if (!wait())
+        {
+          ctx_.invoke_result_ready();
+        }
+      }
+
+    private:
+      // Returns false if completed immediately, with a result or an error
+      bool wait() noexcept
+      {
+        try
+        {
+          if (try_op())
+          {
+            return false;
+          }
+          io_node_.cb = make_member_callback<&fd_op_awaiter::on_ready>(this);
+          register_fd();
+        }
+        catch(...)
+        {
+          exception_ = std::current_exception();
+          return false;
+        }
+        parent_stop_cb_.emplace(
+          ctx_.get_stop_token(),
+          make_member_callback<&fd_op_awaiter::on_cancel>(this));
+        return true;
+      }
+
+      bool try_op()
+      {
+        result_ = op_.try_op();
+        return result_.has_value();
+      }
+
+      void register_fd()
+      {
+        registered_fd_ = op_.fd();
+        registered_events_ = op_.events();
+        poller_.add(registered_fd_, registered_events_, io_node_);
+        registered_ = true;
+      }
+
+      void unregister() noexcept
+      {
+        if (registered_)
+        {
+          poller_.remove(registered_fd_, io_node_);
+          registered_ = false;
+        }
+      }
+
+      void on_ready() noexcept
+      {
+        try
+        {
+          if (0 != io_node_.error)
+          {
+            throw std::system_error(io_node_.error, std::generic_category(), "epoll_wait");
+          }
+          if (!try_op())
+          {
+            if ((op_.fd() != registered_fd_) || (op_.events() != registered_events_))
+            {
+              unregister();
+              register_fd();
+            }
+            return;
+          }
+        }
+        catch(...)
+        {
+          exception_ = std::current_exception();
+        }
+
+        unregister();
+        parent_stop_cb_.reset();
+
+        if (parent_handle_)
+        {
+          ctx_.resume_coroutine(parent_handle_);
+          return;
+        }
+
+        ctx_.invoke_result_ready();
+      }
+
+      void on_cancel() noexcept
+      {
+        parent_stop_cb_.reset();
+        unregister();
+        ctx_.schedule_stopped();
+      }
+    };
+
+    inline io_poller& get_io_poller(context& ctx)
+    {
+      io_poller* poller = ctx.get_event_loop_context().get_io_poller();
+      if (nullptr == poller)
+      {
+        throw std::logic_error("coro_st: the event loop has no io_poller");
+      }
+      return *poller;
+    }
+
+    // MakeOp is called from get_awaiter, it might throw
+    // e.g. when it creates the fd
+    template<typename MakeOp>
+    class [[nodiscard]] fd_op_task
+    {
+      using Op = std::invoke_result_t<MakeOp&>;
+
+      class [[nodiscard]] work
+      {
+        MakeOp make_op_;
+
+      public:
+        explicit work(MakeOp&& make_op) noexcept :
+          make_op_{ std::move(make_op) }
+        {
+        }
+
+        work(const work&) = delete;
+        work& operator=(const work&) = delete;
+        work(work&&) noexcept = default;
+        work& operator=(work&&) noexcept = default;
+
+        [[nodiscard]] fd_op_awaiter<Op> get_awaiter(context& ctx)
+        {
+          io_poller& poller = get_io_poller(ctx);
+          return {ctx, poller, make_op_()};
+        }
+      };
+
+      work work_;
+
+    public:
+      explicit fd_op_task(MakeOp&& make_op) noexcept :
+        work_{ std::move(make_op) }
+      {
+      }
+
+      fd_op_task(const fd_op_task&) = delete;
+      fd_op_task& operator=(const fd_op_task&) = delete;
+
+      [[nodiscard]] work get_work() noexcept
+      {
+        return std::move(work_);
+      }
+    };
+
+    struct read_some_op
+    {
+      using result_type = size_t;
+
+      int fd_;
+      std::span<char> buffer_;
+
+      int fd() const noexcept
+      {
+        return fd_;
+      }
+
+      std::uint32_t events() const noexcept
+      {
+        return EPOLLIN;
+      }
+
+      std::optional<size_t> try_op()
+      {
+        while (true)
+        {
+          ssize_t count = ::read(fd_, buffer_.data(), buffer_.size());
+          if (count >= 0)
+          {
+            return static_cast<size_t>(count);
+          }
+          if (EINTR == errno)
+          {
+            continue;
+          }
+          if ((EAGAIN == errno) || (EWOULDBLOCK == errno))
+          {
+            return std::nullopt;
+          }
+          throw std::system_error(errno, std::generic_category(), "read");
+        }
+      }
+    };
+
+    struct write_some_op
+    {
+      using result_type = size_t;
+
+      int fd_;
+      std::span<const char> buffer_;
+
+      int fd() const noexcept
+      {
+        return fd_;
+      }
+
+      std::uint32_t events() const noexcept
+      {
+        return EPOLLOUT;
+      }
+
+      std::optional<size_t> try_op()
+      {
+        while (true)
+        {
+          ssize_t count = ::write(fd_, buffer_.data(), buffer_.size());
+          if (count >= 0)
+          {
+            return static_cast<size_t>(count);
+          }
+          if (EINTR == errno)
+          {
+            continue;
+          }
+          if ((EAGAIN == errno) || (EWOULDBLOCK == errno))
+          {
+            return std::nullopt;
+          }
+          throw std::system_error(errno, std::generic_category(), "write");
+        }
+      }
+    };
+
+    // For ops that are cheap to copy
+    template<typename Op>
+    struct make_op
+    {
+      Op op_;
+
+      Op operator()() const noexcept
+      {
+        return op_;
+      }
+    };
+  }
+
+  using read_some_task = impl::fd_op_task<impl::make_op<impl::read_some_op>>;
+  using write_some_task = impl::fd_op_task<impl::make_op<impl::write_some_op>>;
+
+  // Reads up to buffer.size() bytes from a non-blocking fd e.g. a pipe or
+  // socket, waiting until some are available. Returns 0 at end of file
+  [[nodiscard]] inline read_some_task async_read_some(int fd, std::span<char> buffer) noexcept
+  {
+    return read_some_task{ impl::make_op<impl::read_some_op>{ { fd, buffer } } };
+  }
+
+  // Writes up to buffer.size() bytes to a non-blocking fd, waiting until
+  // some can be written. Writing to a pipe with no reader raises SIGPIPE,
+  // ignore it to get an EPIPE error instead
+  [[nodiscard]] inline write_some_task async_write_some(int fd, std::span<const char> buffer) noexcept
+  {
+    return write_some_task{ impl::make_op<impl::write_some_op>{ { fd, buffer } } };
+  }
+
+  // The buffer has to outlive the coroutine
+  inline co<void> async_write_all(int fd, std::span<const char> buffer)
+  {
+    while (!buffer.empty())
+    {
+      size_t count = co_await async_write_some(fd, buffer);
+      buffer = buffer.subspan(count);
+    }
+  }
+}
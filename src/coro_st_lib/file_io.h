@@ -0,0 +1,527 @@
+#pragma once
+
+#include "abi.h"
+#include "callback.h"
+#include "context.h"
+#include "io_poller.h"
+#include "stop_util.h"
+#include "thread_signals.h"
+
+#include "../cpp_util_lib/intrusive_list.h"
+
+#include <cassert>
+#include <cerrno>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+namespace CORO_ST_NAMESPACE
+{
+  namespace impl
+  {
+    // A blocking operation run on a file_io_pool thread, type erased via
+    // callbacks like the other nodes of the event loop
+    struct file_io_job
+    {
+      enum class job_state
+      {
+        queued,
+        running,
+        done,
+      };
+
+      file_io_job* next{ nullptr };
+      file_io_job* prev{ nullptr };
+      // protected by the pool mutex
+      job_state state{ job_state::queued };
+      // On a pool thread
+      callback run_cb;
+      // On the event loop thread
+      callback done_cb;
+    };
+  }
+
+  // A small pool of threads for blocking file I/O: regular files are always
+  // "ready" for epoll, a read or write would block the event loop instead.
+  //
+  // The threads signal completions back to the event loop via an eventfd
+  // registered with the io_poller while there are jobs in flight.
+  //
+  // Use via `run(task, run_options{ .file_io = &pool })`, it has to outlive
+  // the tasks using it.
+  class file_io_pool
+  {
+    using job_list = cpp_util::intrusive_list<
+      impl::file_io_job,
+      &impl::file_io_job::next,
+      &impl::file_io_job::prev>;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    job_list queued_;
+    job_list done_;
+    bool stopping_{ false };
+
+    // event loop thread only
+    fd_handle event_fd_;
+    io_node io_node_;
+    io_poller* poller_{ nullptr };
+    size_t in_flight_{ 0 };
+
+    std::vector<std::jthread> threads_;
+
+  public:
+    explicit file_io_pool(size_t thread_count = 4) :
+      mutex_{},
+      cv_{},
+      queued_{},
+      done_{},
+      stopping_{ false },
+      event_fd_{ ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC) },
+      io_node_{},
+      poller_{ nullptr },
+      in_flight_{ 0 },
+      threads_{}
+    {
+      assert(thread_count > 0);
+      if (!event_fd_.is_valid())
+      {
+        throw std::system_error(errno, std::generic_category(), "eventfd");
+      }
+      io_node_.cb = make_member_callback<&file_io_pool::on_event_fd>(this);
+
+      threads_.reserve(thread_count);
+      try
+      {
+        impl::all_signals_blocked blocked;
+        for (size_t i = 0; i < thread_count; ++i)
+        {
+          threads_.emplace_back([this]() noexcept {
+            worker();
+          });
+        }
+      }
+      catch(...)
+      {
+        stop_threads();
+        throw;
+      }
+    }
+
+    file_io_pool(const file_io_pool&) = delete;
+    file_io_pool& operator=(const file_io_pool&) = delete;
+
+    ~file_io_pool()
+    {
+      assert(0 == in_flight_);
+      stop_threads();
+    }
+
+    // Jobs submitted and not yet delivered to the event loop
+    size_t in_flight() const noexcept
+    {
+      return in_flight_;
+    }
+
+    // The io_poller has to be the same for all jobs
+    void submit(impl::file_io_job& job, io_poller& poller)
+    {
+      if (nullptr == poller_)
+      {
+        poller.add(event_fd_.get(), EPOLLIN, io_node_);
+        poller_ = &poller;
+      }
+      assert(&poller == poller_);
+
+      {
+        std::lock_guard lock{ mutex_ };
+        job.state = impl::file_io_job::job_state::queued;
+        queued_.push_back(&job);
+      }
+      ++in_flight_;
+      cv_.notify_one();
+    }
+
+    // Returns true if the job was still queued, it will not run
+    bool try_cancel(impl::file_io_job& job) noexcept
+    {
+      {
+        std::lock_guard lock{ mutex_ };
+        if (impl::file_io_job::job_state::queued != job.state)
+        {
+          return false;
+        }
+        queued_.remove(&job);
+      }
+      --in_flight_;
+      unregister_if_idle();
+      return true;
+    }
+
+  private:
+    void stop_threads() noexcept
+    {
+      {
+        std::lock_guard lock{ mutex_ };
+        stopping_ = true;
+      }
+      cv_.notify_all();
+      threads_.clear();
+    }
+
+    void worker() noexcept
+    {
+      while (true)
+      {
+        impl::file_io_job* job = nullptr;
+        {
+          std::unique_lock lock{ mutex_ };
+          cv_.wait(lock, [this]() noexcept {
+            return stopping_ || !queued_.empty();
+          });
+          if (queued_.empty())
+          {
+            return;
+          }
+          job = queued_.pop_front();
+          job->state = impl::file_io_job::job_state::running;
+        }
+
+        job->run_cb.invoke();
+
+        bool was_empty = false;
+        {
+          std::lock_guard lock{ mutex_ };
+          job->state = impl::file_io_job::job_state::done;
+          was_empty = done_.empty();
+          done_.push_back(job);
+        }
+        if (was_empty)
+        {
+          std::uint64_t one = 1;
+          static_cast<void>(::write(event_fd_.get(), &one, sizeof(one)));
+        }
+      }
+    }
+
+    void on_event_fd() noexcept
+    {
+      std::uint64_t count = 0;
+      static_cast<void>(::read(event_fd_.get(), &count, sizeof(count)));
+
+      job_list local_done;
+      {
+        std::lock_guard lock{ mutex_ };
+        local_done = std::move(done_);
+      }
+      while (true)
+      {
+        impl::file_io_job* job = local_done.pop_front();
+        if (nullptr == job)
+        {
+          break;
+        }
+        --in_flight_;
+        // might submit more jobs
+        job->done_cb.invoke();
+      }
+      unregister_if_idle();
+    }
+
+    // So that the event loop does not wait for the eventfd when idle
+    void unregister_if_idle() noexcept
+    {
+      if ((0 == in_flight_) && (nullptr != poller_))
+      {
+        poller_->remove(event_fd_.get(), io_node_);
+        poller_ = nullptr;
+      }
+    }
+  };
+
+  namespace impl
+  {
+    // Positional I/O, retried until the whole buffer was transferred,
+    // a read stops early only at end of file
+    struct file_read_op
+    {
+      static constexpr const char* name = "pread";
+
+      static ssize_t transfer(int fd, std::span<char> buffer, off_t offset) noexcept
+      {
+        return ::pread(fd, buffer.data(), buffer.size(), offset);
+      }
+    };
+
+    struct file_write_op
+    {
+      static constexpr const char* name = "pwrite";
+
+      static ssize_t transfer(int fd, std::span<const char> buffer, off_t offset) noexcept
+      {
+        return ::pwrite(fd, buffer.data(), buffer.size(), offset);
+      }
+    };
+
+    template<typename Op, typename Buffer>
+    class [[nodiscard]] file_io_awaiter : file_io_job
+    {
+      context& ctx_;
+      file_io_pool& pool_;
+      io_poller& poller_;
+      int fd_;
+      std::span<Buffer> buffer_;
+      off_t offset_;
+      std::coroutine_handle<> parent_handle_;
+      std::optional<stop_callback<callback>> parent_stop_cb_;
+      bool cancel_requested_{ false };
+      // written by the pool thread, read from on_done
+      size_t transferred_{ 0 };
+      int error_{ 0 };
+      std::exception_ptr exception_;
+
+    public:
+      file_io_awaiter(
+        context& ctx,
+        file_io_pool& pool,
+        io_poller& poller,
+        int fd,
+        std::span<Buffer> buffer,
+        off_t offset
+      ) noexcept :
+        ctx_{ ctx },
+        pool_{ pool },
+        poller_{ poller },
+        fd_{ fd },
+        buffer_{ buffer },
+        offset_{ offset },
+        parent_handle_{},
+        parent_stop_cb_{ std::nullopt },
+        cancel_requested_{ false },
+        transferred_{ 0 },
+        error_{ 0 },
+        exception_{}
+      {
+        run_cb = make_member_callback<&file_io_awaiter::run>(this);
+        done_cb = make_member_callback<&file_io_awaiter::on_done>(this);
+      }
+
+      file_io_awaiter(const file_io_awaiter&) = delete;
+      file_io_awaiter& operator=(const file_io_awaiter&) = delete;
+
+      [[nodiscard]] constexpr bool await_ready() const noexcept
+      {
+        return false;
+      }
+
+      bool await_suspend(std::coroutine_handle<> handle) noexcept
+      {
+        parent_handle_ = handle;
+        if (ctx_.get_stop_token().stop_requested())
+        {
+          ctx_.invoke_stopped();
+          return true;
+        }
+        return submit();
+      }
+
+      // The number of bytes transferred
+      size_t await_resume() const
+      {
+        if (exception_)
+        {
+          std::rethrow_exception(exception_);
+        }
+        return transferred_;
+      }
+
+      std::exception_ptr get_result_exception() const noexcept
+      {
+        return exception_;
+      }
+
+      void start() noexcept
+      {
+        if (ctx_.get_stop_token().stop_requested())
+        {
+          ctx_.invoke_stopped();
+          return;
+        }
+        if (!submit())
+        {
+          ctx_.invoke_result_ready();
+        }
+      }
+
+    private:
+      // Returns false on error to submit
+      bool submit() noexcept
+      {
+        try
+        {
+          pool_.submit(*this, poller_);
+        }
+        catch(...)
+        {
+          exception_ = std::current_exception();
+          return false;
+        }
+        parent_stop_cb_.emplace(
+          ctx_.get_stop_token(),
+          make_member_callback<&file_io_awaiter::on_cancel>(this));
+        return true;
+      }
+
+      void run() noexcept
+      {
+        while (transferred_ < buffer_.size())
+        {
+          ssize_t count = Op::transfer(
+            fd_,
+            buffer_.subspan(transferred_),
+            offset_ + static_cast<off_t>(transferred_));
+          if (count < 0)
+          {
+            if (EINTR == errno)
+            {
+              continue;
+            }
+            error_ = errno;
+            return;
+          }
+          if (0 == count)
+          {
+            return;
+          }
+          transferred_ += static_cast<size_t>(count);
+        }
+      }
+
+      void on_done() noexcept
+      {
+        parent_stop_cb_.reset();
+
+        if (0 != error_)
+        {
+          exception_ = std::make_exception_ptr(
+            std::system_error(error_, std::generic_category(), Op::name));
+        }
+
+        if (cancel_requested_)
+        {
+          ctx_.invoke_stopped();
+          return;
+        }
+
+        if (parent_handle_)
+        {
+          ctx_.resume_coroutine(parent_handle_);
+          return;
+        }
+
+        ctx_.invoke_result_ready();
+      }
+
+      void on_cancel() noexcept
+      {
+        parent_stop_cb_.reset();
+        if (pool_.try_cancel(*this))
+        {
+          ctx_.schedule_stopped();
+          return;
+        }
+        // already running, the buffer is in use until done
+        cancel_requested_ = true;
+      }
+    };
+
+    template<typename Op, typename Buffer>
+    class [[nodiscard]] file_io_task
+    {
+      class [[nodiscard]] work
+      {
+        int fd_;
+        std::span<Buffer> buffer_;
+        off_t offset_;
+
+      public:
+        work(int fd, std::span<Buffer> buffer, off_t offset) noexcept :
+          fd_{ fd },
+          buffer_{ buffer },
+          offset_{ offset }
+        {
+        }
+
+        work(const work&) = delete;
+        work& operator=(const work&) = delete;
+        work(work&&) noexcept = default;
+        work& operator=(work&&) noexcept = default;
+
+        [[nodiscard]] file_io_awaiter<Op, Buffer> get_awaiter(context& ctx)
+        {
+          event_loop_context& el_ctx = ctx.get_event_loop_context();
+          file_io_pool* pool = el_ctx.get_file_io_pool();
+          if (nullptr == pool)
+          {
+            throw std::logic_error("coro_st: the event loop has no file_io_pool");
+          }
+          io_poller* poller = el_ctx.get_io_poller();
+          if (nullptr == poller)
+          {
+            throw std::logic_error("coro_st: the event loop has no io_poller");
+          }
+          return {ctx, *pool, *poller, fd_, buffer_, offset_};
+        }
+      };
+
+      work work_;
+
+    public:
+      file_io_task(int fd, std::span<Buffer> buffer, off_t offset) noexcept :
+        work_{ fd, buffer, offset }
+      {
+      }
+
+      file_io_task(const file_io_task&) = delete;
+      file_io_task& operator=(const file_io_task&) = delete;
+
+      [[nodiscard]] work get_work() noexcept
+      {
+        return std::move(work_);
+      }
+    };
+  }
+
+  using file_read_task = impl::file_io_task<impl::file_read_op, char>;
+  using file_write_task = impl::file_io_task<impl::file_write_op, const char>;
+
+  // Reads buffer.size() bytes at offset on a file_io_pool thread, returns
+  // the number of bytes read: less only at end of file
+  [[nodiscard]] inline file_read_task async_file_read(
+    fd_arg fd, off_t offset, std::span<char> buffer) noexcept
+  {
+    return {fd, buffer, offset};
+  }
+
+  // Writes the whole buffer at offset on a file_io_pool thread, returns
+  // the number of bytes written
+  [[nodiscard]] inline file_write_task async_file_write(
+    fd_arg fd, off_t offset, std::span<const char> buffer) noexcept
+  {
+    return {fd, buffer, offset};
+  }
+}
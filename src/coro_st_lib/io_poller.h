@@ -0,0 +1,362 @@
+#pragma once
+
+#include "abi.h"
+#include "callback.h"
+
+#include "../cpp_util_lib/handle_arg.h"
+#include "../cpp_util_lib/unique_handle.h"
+
+#include <array>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+
+#include <sys/epoll.h>
+#include <time.h>
+#include <unistd.h>
+
+// epoll_pwait2 (nanosecond timeout) is declared from glibc 2.35,
+// it needs Linux 5.11
+#if defined(__GLIBC__) && ((__GLIBC__ > 2) || ((__GLIBC__ == 2) && (__GLIBC_MINOR__ >= 35)))
+#define CORO_ST_HAS_EPOLL_PWAIT2 1
+#endif
+
+namespace CORO_ST_NAMESPACE
+{
+  struct fd_handle_traits : cpp_util::unique_handle_out_ptr_access
+  {
+    using handle_type = int;
+    static constexpr auto invalid_value() noexcept { return -1; }
+    static void close_handle(handle_type h) noexcept
+    {
+      static_cast<void>(::close(h));
+    }
+  };
+
+  using fd_handle = cpp_util::unique_handle<fd_handle_traits>;
+  using fd_arg = cpp_util::handle_arg<fd_handle_traits>;
+
+  // Registered with an io_poller for a file descriptor
+  struct io_node
+  {
+    callback cb;
+    // the epoll events reported for the last wait e.g. EPOLLIN, EPOLLHUP
+    std::uint32_t events{ 0 };
+    // the errno if the wait failed: the readiness is unknown, the operation
+    // fails with it rather than wait forever
+    int error{ 0 };
+  };
+
+  // File descriptor readiness for the event loop, via epoll (Linux only).
+  //
+  // Level triggered: while a fd is registered and ready, its callback is
+  // invoked on each loop iteration, so awaiters remove the fd when done.
+  //
+  // A fd is registered once with epoll, with up to two nodes: a reader
+  // (EPOLLIN) and a writer (EPOLLOUT) e.g. a read and a write waiting on
+  // the same socket. The epoll interest is the union of the two.
+  //
+  // The epoll instance is only created when the first fd is added, a loop
+  // that does no I/O makes no extra system calls.
+  //
+  // A failed wait (other than EINTR) is reported to every registered node,
+  // see io_node::error, instead of being thrown from the loop.
+  class io_poller
+  {
+    static constexpr int max_events = 64;
+
+    // indexed by fd
+    struct fd_entry
+    {
+      io_node* reader{ nullptr };
+      io_node* writer{ nullptr };
+    };
+
+    fd_handle epoll_fd_;
+    size_t size_{ 0 };
+    std::vector<fd_entry> fds_;
+    std::array<epoll_event, max_events> events_{};
+    int ready_count_{ 0 };
+    int ready_index_{ 0 };
+    // the reader of the event at ready_index_ was dispatched
+    bool ready_reader_done_{ false };
+    // the errno of the last wait, reported to the nodes from failed_index_
+    int failed_errno_{ 0 };
+    size_t failed_index_{ 0 };
+#if defined(CORO_ST_HAS_EPOLL_PWAIT2)
+    // false on kernels older than 5.11
+    bool has_pwait2_{ true };
+#endif
+
+  public:
+    io_poller() noexcept = default;
+
+    io_poller(const io_poller&) = delete;
+    io_poller& operator=(const io_poller&) = delete;
+
+    ~io_poller()
+    {
+      assert(0 == size_);
+    }
+
+    // Number of registered nodes
+    size_t size() const noexcept
+    {
+      return size_;
+    }
+
+    bool empty() const noexcept
+    {
+      return 0 == size_;
+    }
+
+    // events is either EPOLLIN (the reader) or EPOLLOUT (the writer),
+    // at most one node of each per fd
+    void add(int fd, std::uint32_t events, io_node& node)
+    {
+      assert(node.cb.is_callable());
+      assert(fd >= 0);
+      assert((EPOLLIN == events) || (EPOLLOUT == events));
+      if (!epoll_fd_.is_valid())
+      {
+        epoll_fd_.reset(::epoll_create1(EPOLL_CLOEXEC));
+        if (!epoll_fd_.is_valid())
+        {
+          throw std::system_error(errno, std::generic_category(), "epoll_create1");
+        }
+      }
+      size_t index = static_cast<size_t>(fd);
+      if (index >= fds_.size())
+      {
+        fds_.resize(index + 1);
+      }
+      fd_entry& entry = fds_[index];
+      std::uint32_t old_interest = interest(entry);
+      io_node*& slot = (EPOLLIN == events) ? entry.reader : entry.writer;
+      if (nullptr != slot)
+      {
+        throw std::logic_error("coro_st: io_poller fd already has a reader/writer");
+      }
+      slot = &node;
+      try
+      {
+        epoll_ctl((0 == old_interest) ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd, interest(entry));
+      }
+      catch(...)
+      {
+        slot = nullptr;
+        throw;
+      }
+      ++size_;
+    }
+
+    // Moves the node to the other direction
+    void modify(int fd, std::uint32_t events, io_node& node)
+    {
+      remove(fd, node);
+      add(fd, events, node);
+    }
+
+    // Also drops events for the node not yet dispatched
+    void remove(int fd, io_node& node) noexcept
+    {
+      assert(size_ > 0);
+      assert(fd >= 0);
+      size_t index = static_cast<size_t>(fd);
+      assert(index < fds_.size());
+      fd_entry& entry = fds_[index];
+      if (&node == entry.reader)
+      {
+        entry.reader = nullptr;
+      }
+      else
+      {
+        assert(&node == entry.writer);
+        entry.writer = nullptr;
+      }
+      --size_;
+      // the epoll_ctl fails harmlessly if the fd was already closed
+      std::uint32_t new_interest = interest(entry);
+      if (0 == new_interest)
+      {
+        static_cast<void>(::epoll_ctl(epoll_fd_.get(), EPOLL_CTL_DEL, fd, nullptr));
+      }
+      else
+      {
+        epoll_event e{};
+        e.events = new_interest;
+        e.data.fd = fd;
+        static_cast<void>(::epoll_ctl(epoll_fd_.get(), EPOLL_CTL_MOD, fd, &e));
+      }
+    }
+
+    // Waits for ready fds up to timeout, duration::max() means no timeout.
+    // The resolution is nanoseconds via epoll_pwait2, milliseconds (rounded
+    // up) via epoll_wait on older systems.
+    // Does not invoke the callbacks, see pop_ready().
+    // Errors other than EINTR e.g. EBADF, are reported to the registered
+    // nodes by pop_ready(), see io_node::error
+    void wait(std::chrono::steady_clock::duration timeout) noexcept
+    {
+      assert(ready_index_ == ready_count_);
+      assert(0 == failed_errno_);
+      ready_count_ = 0;
+      ready_index_ = 0;
+      ready_reader_done_ = false;
+      if (empty())
+      {
+        return;
+      }
+
+      int count = epoll_wait(timeout);
+      if (count < 0)
+      {
+        if (EINTR != errno)
+        {
+          failed_errno_ = errno;
+          failed_index_ = 0;
+        }
+        return;
+      }
+      ready_count_ = count;
+    }
+
+    // The next node that is ready from the last wait, or nullptr.
+    // For a fd the reader comes before the writer; the nodes are looked up
+    // when popped, a node removed in the meantime is skipped
+    io_node* pop_ready() noexcept
+    {
+      if (0 != failed_errno_)
+      {
+        return pop_failed();
+      }
+      while (ready_index_ < ready_count_)
+      {
+        const epoll_event& e = events_[static_cast<size_t>(ready_index_)];
+        size_t index = static_cast<size_t>(e.data.fd);
+        io_node* node = nullptr;
+        if (!ready_reader_done_)
+        {
+          ready_reader_done_ = true;
+          if ((index < fds_.size()) && (0 != (e.events & reader_events)))
+          {
+            node = fds_[index].reader;
+          }
+        }
+        else
+        {
+          ++ready_index_;
+          ready_reader_done_ = false;
+          if ((index < fds_.size()) && (0 != (e.events & writer_events)))
+          {
+            node = fds_[index].writer;
+          }
+        }
+        if (nullptr != node)
+        {
+          node->events = e.events;
+          node->error = 0;
+          return node;
+        }
+      }
+      return nullptr;
+    }
+
+  private:
+    // errors and hang ups wake both, so that their operation reports them
+    static constexpr std::uint32_t reader_events = EPOLLIN | EPOLLPRI | EPOLLRDHUP | EPOLLERR | EPOLLHUP;
+    static constexpr std::uint32_t writer_events = EPOLLOUT | EPOLLERR | EPOLLHUP;
+
+    static std::uint32_t interest(const fd_entry& entry) noexcept
+    {
+      return
+        ((nullptr != entry.reader) ? std::uint32_t{ EPOLLIN } : std::uint32_t{ 0 }) |
+        ((nullptr != entry.writer) ? std::uint32_t{ EPOLLOUT } : std::uint32_t{ 0 });
+    }
+
+    int epoll_wait(std::chrono::steady_clock::duration timeout) noexcept
+    {
+      bool infinite = (timeout == std::chrono::steady_clock::duration::max());
+      if (timeout < std::chrono::steady_clock::duration::zero())
+      {
+        timeout = std::chrono::steady_clock::duration::zero();
+      }
+
+#if defined(CORO_ST_HAS_EPOLL_PWAIT2)
+      if (has_pwait2_)
+      {
+        timespec ts{};
+        if (!infinite)
+        {
+          auto s = std::chrono::duration_cast<std::chrono::seconds>(timeout);
+          ts.tv_sec = static_cast<time_t>(s.count());
+          ts.tv_nsec = static_cast<long>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(timeout - s).count());
+        }
+        int count = ::epoll_pwait2(
+          epoll_fd_.get(), events_.data(), max_events, infinite ? nullptr : &ts, nullptr);
+        if ((count >= 0) || (ENOSYS != errno))
+        {
+          return count;
+        }
+        has_pwait2_ = false;
+      }
+#endif
+
+      int timeout_ms = -1;
+      if (!infinite)
+      {
+        auto ms = std::chrono::ceil<std::chrono::milliseconds>(timeout).count();
+        timeout_ms = (ms > INT_MAX) ? INT_MAX : static_cast<int>(ms);
+      }
+      return ::epoll_wait(epoll_fd_.get(), events_.data(), max_events, timeout_ms);
+    }
+
+    // After a failed wait, each registered node in turn (reader first)
+    io_node* pop_failed() noexcept
+    {
+      while (failed_index_ < fds_.size())
+      {
+        fd_entry& entry = fds_[failed_index_];
+        io_node* node = nullptr;
+        if (!ready_reader_done_)
+        {
+          ready_reader_done_ = true;
+          node = entry.reader;
+        }
+        else
+        {
+          ++failed_index_;
+          ready_reader_done_ = false;
+          node = entry.writer;
+        }
+        if (nullptr != node)
+        {
+          node->events = EPOLLERR;
+          node->error = failed_errno_;
+          return node;
+        }
+      }
+      failed_errno_ = 0;
+      ready_reader_done_ = false;
+      return nullptr;
+    }
+
+    void epoll_ctl(int op, int fd, std::uint32_t events)
+    {
+      epoll_event e{};
+      e.events = events;
+      e.data.fd = fd;
+      if (0 != ::epoll_ctl(epoll_fd_.get(), op, fd, &e))
+      {
+        throw std::system_error(errno, std::generic_category(), "epoll_ctl");
+      }
+    }
+  };
+}
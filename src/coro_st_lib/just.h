@@ -1,12 +1,13 @@
 #pragma once
 
+#include "abi.h"
 #include "context.h"
 
 #include <coroutine>
 #include <type_traits>
 #include <utility>
 
-namespace coro_st
+namespace CORO_ST_NAMESPACE
 {
   template<typename T>
   class [[nodiscard]] just_task
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "abi.h"
 #include "context.h"
 
 #include <coroutine>
@@ -7,7 +8,7 @@
 #include <type_traits>
 #include <utility>
 
-namespace coro_st
+namespace CORO_ST_NAMESPACE
 {
   class [[nodiscard]] just_exception_task
   {
@@ -0,0 +1,232 @@
+#pragma once
+
+#include "abi.h"
+#include "context.h"
+
+#include "../cpp_util_lib/intrusive_list.h"
+
+#include <cassert>
+#include <coroutine>
+#include <optional>
+
+namespace CORO_ST_NAMESPACE
+{
+  class latch
+  {
+  public:
+    class [[nodiscard]] latch_wait_task
+    {
+      friend class latch;
+
+      class [[nodiscard]] awaiter
+      {
+        friend class latch;
+
+        context& ctx_;
+        std::coroutine_handle<> parent_handle_;
+        latch& ltch_;
+        size_t arrive_count_;
+        awaiter* next_waiting_{ nullptr };
+        awaiter* prev_waiting_{ nullptr };
+        std::optional<stop_callback<callback>> parent_stop_cb_;
+
+      public:
+        awaiter(context& ctx, latch& ltch, size_t arrive_count) noexcept :
+          ctx_{ ctx },
+          parent_handle_{},
+          ltch_{ ltch },
+          arrive_count_{ arrive_count },
+          next_waiting_{ nullptr },
+          prev_waiting_{ nullptr },
+          parent_stop_cb_{ std::nullopt }
+        {
+        }
+
+        awaiter(const awaiter&) = delete;
+        awaiter& operator=(const awaiter&) = delete;
+
+        [[nodiscard]] constexpr bool await_ready() const noexcept
+        {
+          return false;
+        }
+
+        bool await_suspend(std::coroutine_handle<> handle) noexcept
+        {
+          parent_handle_ = handle;
+          if (ctx_.get_stop_token().stop_requested())
+          {
+            ctx_.invoke_stopped();
+            return true;
+          }
+          ltch_.count_down(arrive_count_);
+          if (ltch_.try_wait())
+          {
+            return false;
+          }
+          enqueue_wait_node();
+          return true;
+        }
+
+        constexpr void await_resume() const noexcept
+        {
+        }
+
+        std::exception_ptr get_result_exception() const noexcept
+        {
+          return {};
+        }
+
+        void start() noexcept
+        {
+          if (ctx_.get_stop_token().stop_requested())
+          {
+            ctx_.invoke_stopped();
+            return;
+          }
+          ltch_.count_down(arrive_count_);
+          if (ltch_.try_wait())
+          {
+            ctx_.invoke_result_ready();
+            return;
+          }
+          enqueue_wait_node();
+        }
+
+      private:
+        void enqueue_wait_node() noexcept
+        {
+          ltch_.wait_list_.push_back(this);
+          parent_stop_cb_.emplace(
+            ctx_.get_stop_token(),
+            make_member_callback<&awaiter::on_cancel>(this));
+        }
+
+        // Called after the latch already unlinked it from the wait list
+        void on_released() noexcept
+        {
+          parent_stop_cb_.reset();
+
+          if (parent_handle_)
+          {
+            ctx_.schedule_coroutine_resume(parent_handle_);
+            return;
+          }
+
+          ctx_.schedule_result_ready();
+        }
+
+        void on_cancel() noexcept
+        {
+          parent_stop_cb_.reset();
+          ltch_.wait_list_.remove(this);
+          ctx_.schedule_stopped();
+        }
+      };
+
+      struct [[nodiscard]] work
+      {
+        latch* ltch_;
+        size_t arrive_count_;
+
+        work(latch& ltch, size_t arrive_count) noexcept :
+          ltch_{ &ltch },
+          arrive_count_{ arrive_count }
+        {
+        }
+
+        work(const work&) = delete;
+        work& operator=(const work&) = delete;
+        work(work&&) noexcept = default;
+        work& operator=(work&&) noexcept = default;
+
+        [[nodiscard]] awaiter get_awaiter(context& ctx) noexcept
+        {
+          return {ctx, *ltch_, arrive_count_};
+        }
+      };
+
+    private:
+      work work_;
+
+    public:
+      latch_wait_task(latch& ltch, size_t arrive_count) noexcept :
+        work_{ ltch, arrive_count }
+      {
+      }
+
+      latch_wait_task(const latch_wait_task&) = delete;
+      latch_wait_task& operator=(const latch_wait_task&) = delete;
+
+      [[nodiscard]] work get_work() noexcept
+      {
+        return std::move(work_);
+      }
+    };
+
+  private:
+    using wait_list = cpp_util::intrusive_list<
+      latch_wait_task::awaiter,
+      &latch_wait_task::awaiter::next_waiting_,
+      &latch_wait_task::awaiter::prev_waiting_>;
+
+    size_t count_;
+    wait_list wait_list_;
+
+  public:
+    explicit latch(size_t count) noexcept :
+      count_{ count },
+      wait_list_{}
+    {
+    }
+
+    latch(const latch&) = delete;
+    latch& operator=(const latch&) = delete;
+
+    ~latch()
+    {
+      assert(wait_list_.empty());
+    }
+
+    void count_down(size_t n = 1) noexcept
+    {
+      assert(n <= count_);
+      if (0 == n)
+      {
+        return;
+      }
+      count_ -= n;
+      if (0 != count_)
+      {
+        return;
+      }
+
+      wait_list local_wait_list = std::move(wait_list_);
+      while (true)
+      {
+        auto* waiting = local_wait_list.pop_front();
+        if (waiting == nullptr)
+        {
+          break;
+        }
+        waiting->on_released();
+      }
+    }
+
+    bool try_wait() const noexcept
+    {
+      return 0 == count_;
+    }
+
+    [[nodiscard]] latch_wait_task async_wait() noexcept
+    {
+      return latch_wait_task{*this, 0};
+    }
+
+    // Counts down when started, if stop was already requested it
+    // completes as stopped without counting down
+    [[nodiscard]] latch_wait_task async_arrive_and_wait(size_t n = 1) noexcept
+    {
+      return latch_wait_task{*this, n};
+    }
+  };
+}
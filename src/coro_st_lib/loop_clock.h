@@ -0,0 +1,80 @@
+#pragma once
+
+#include "abi.h"
+
+#include <cassert>
+#include <chrono>
+
+namespace CORO_ST_NAMESPACE
+{
+  inline std::chrono::steady_clock::time_point steady_clock_now() noexcept
+  {
+    return std::chrono::steady_clock::now();
+  }
+
+  // Time cached by the event loop, refreshed once per loop iteration.
+  // Reading the clock has a cost e.g. when many handlers set timeouts
+  //
+  // A null now_fn makes it a virtual clock: it starts at the steady_clock
+  // epoch and only moves via advance_to e.g. when the event loop jumps to
+  // the next timer instead of sleeping
+  class loop_clock
+  {
+  public:
+    using now_fn = std::chrono::steady_clock::time_point (*)() noexcept;
+
+  private:
+    now_fn now_fn_;
+    std::chrono::steady_clock::time_point now_;
+
+  public:
+    explicit loop_clock(now_fn fn = &steady_clock_now) noexcept :
+      now_fn_{ fn },
+      now_{ (nullptr != fn) ? fn() : std::chrono::steady_clock::time_point{} }
+    {
+    }
+
+    loop_clock(const loop_clock&) = delete;
+    loop_clock& operator=(const loop_clock&) = delete;
+
+    std::chrono::steady_clock::time_point now() const noexcept
+    {
+      return now_;
+    }
+
+    std::chrono::steady_clock::time_point refresh() noexcept
+    {
+      if (nullptr != now_fn_)
+      {
+        now_ = now_fn_();
+      }
+      return now_;
+    }
+
+    // Reads the clock now rather than the cached time, e.g. to measure how
+    // long a callback runs. The virtual time for a virtual clock
+    std::chrono::steady_clock::time_point read() const noexcept
+    {
+      if (nullptr != now_fn_)
+      {
+        return now_fn_();
+      }
+      return now_;
+    }
+
+    bool is_virtual() const noexcept
+    {
+      return nullptr == now_fn_;
+    }
+
+    // Virtual clock only, the time does not go back
+    void advance_to(std::chrono::steady_clock::time_point time) noexcept
+    {
+      assert(is_virtual());
+      if (time > now_)
+      {
+        now_ = time;
+      }
+    }
+  };
+}
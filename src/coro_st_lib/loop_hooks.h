@@ -0,0 +1,117 @@
+#pragma once
+
+#include "abi.h"
+#include "loop_hooks_policy.h"
+
+#include <coroutine>
+#include <cstddef>
+#include <source_location>
+#include <string_view>
+#include <type_traits>
+
+// Optional, the header defining the type named by CORO_ST_LOOP_HOOKS
+#if defined(CORO_ST_LOOP_HOOKS_HEADER)
+#include CORO_ST_LOOP_HOOKS_HEADER
+#endif
+
+namespace CORO_ST_NAMESPACE
+{
+  // Selected at compile time for the whole program, e.g. with
+  // -DCORO_ST_LOOP_HOOKS=my_hooks -DCORO_ST_LOOP_HOOKS_HEADER='"my_hooks.h"'
+  // it is part of the ABI, see abi.h
+#if defined(CORO_ST_LOOP_HOOKS)
+  using loop_hooks = CORO_ST_LOOP_HOOKS;
+#else
+  using loop_hooks = no_loop_hooks;
+#endif
+
+  static_assert(is_loop_hooks<loop_hooks>);
+
+  namespace impl
+  {
+    // If the policy is Part or combines it
+    template<typename Part, typename Hooks = loop_hooks>
+    inline constexpr bool has_hooks_part =
+      std::is_base_of_v<Part, Hooks> ||
+      requires { requires Hooks::template contains<Part>; };
+
+    // The data of Part, whether the policy is Part or combines it
+    template<typename Part>
+    co_frame_t<Part>& co_frame_part(co_frame_t<loop_hooks>& frame) noexcept
+    {
+      if constexpr (std::is_same_v<co_frame_t<Part>, co_frame_t<loop_hooks>>)
+      {
+        return frame;
+      }
+      else
+      {
+        return static_cast<hooks_part<Part, co_frame_t<Part>>&>(frame).data;
+      }
+    }
+
+    template<typename Part>
+    context_data_t<Part>& context_data_part(context_data_t<loop_hooks>& data) noexcept
+    {
+      if constexpr (std::is_same_v<context_data_t<Part>, context_data_t<loop_hooks>>)
+      {
+        return data;
+      }
+      else
+      {
+        return static_cast<hooks_part<Part, context_data_t<Part>>&>(data).data;
+      }
+    }
+
+    // Call the optional hooks if the policy has them, templates
+    // so that the calls are only checked if they are made
+    template<typename Hooks = loop_hooks>
+    void hooks_on_co_attach(
+      co_frame_t<Hooks>& frame,
+      context& ctx,
+      std::coroutine_handle<> handle,
+      const std::coroutine_handle<>* parent_coro) noexcept
+    {
+      if constexpr (has_on_co_attach<Hooks>)
+      {
+        Hooks::on_co_attach(frame, ctx, handle, parent_coro);
+      }
+    }
+
+    template<typename Hooks = loop_hooks>
+    void hooks_on_co_await(
+      co_frame_t<Hooks>& frame, std::string_view awaiting, std::source_location location) noexcept
+    {
+      if constexpr (has_on_co_await<Hooks>)
+      {
+        Hooks::on_co_await(frame, awaiting, location);
+      }
+    }
+
+    template<typename Hooks = loop_hooks>
+    void hooks_on_co_suspend(co_frame_t<Hooks>& frame) noexcept
+    {
+      if constexpr (has_co_suspend_hooks<Hooks>)
+      {
+        Hooks::on_co_suspend(frame);
+      }
+    }
+
+    template<typename Hooks = loop_hooks>
+    void hooks_on_co_resume(co_frame_t<Hooks>& frame, bool suspended) noexcept
+    {
+      if constexpr (has_co_suspend_hooks<Hooks>)
+      {
+        Hooks::on_co_resume(frame, suspended);
+      }
+    }
+
+    template<typename Hooks = loop_hooks>
+    void hooks_on_allocation(std::size_t bytes) noexcept
+    {
+      if constexpr (has_on_allocation<Hooks>)
+      {
+        Hooks::on_allocation(bytes);
+      }
+    }
+  }
+}
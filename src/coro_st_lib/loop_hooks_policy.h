@@ -0,0 +1,288 @@
+#pragma once
+
+// The building blocks of a loop hooks policy, loop_hooks.h selects the
+// policy. Policy headers include this one rather than loop_hooks.h
+
+#include "abi.h"
+#include "ready_queue.h"
+#include "timer_heap.h"
+
+#include <concepts>
+#include <coroutine>
+#include <cstddef>
+#include <source_location>
+#include <string_view>
+#include <type_traits>
+
+namespace CORO_ST_NAMESPACE
+{
+  class context;
+
+  template<typename T>
+  concept is_loop_hooks = requires(
+    ready_node& ready, timer_node& timer, std::coroutine_handle<> handle, context& ctx, bool stopped)
+  {
+    { T::on_push_ready(ready) } noexcept -> std::same_as<void>;
+    { T::on_timer_insert(timer) } noexcept -> std::same_as<void>;
+    { T::on_timer_remove(timer) } noexcept -> std::same_as<void>;
+    { T::on_timer_fire(timer) } noexcept -> std::same_as<void>;
+    { T::on_coroutine_resume(handle) } noexcept -> std::same_as<void>;
+    { T::on_completion(ctx, stopped) } noexcept -> std::same_as<void>;
+  };
+
+  // The default: inlined away, the loop is the same as without hooks
+  struct no_loop_hooks
+  {
+    static void on_push_ready(ready_node&) noexcept {}
+    static void on_timer_insert(timer_node&) noexcept {}
+    static void on_timer_remove(timer_node&) noexcept {}
+    // Just before the timer callback is invoked
+    static void on_timer_fire(timer_node&) noexcept {}
+    // Just before a coroutine is started or resumed: inline,
+    // from the ready queue or by symmetric transfer
+    static void on_coroutine_resume(std::coroutine_handle<>) noexcept {}
+    // The chain completes with a result (or exception) or stopped
+    static void on_completion(context&, bool) noexcept {}
+  };
+
+  // Optional parts of a policy, the code and the data for them only exist
+  // if the policy has them:
+  // - `co_frame`: data in each `co` promise, destroyed with it, and
+  //   - `on_co_attach(co_frame&, context&, handle, const handle* parent_coro)`
+  //     when the coroutine gets its context, before it starts
+  //   - `on_co_await(co_frame&, std::string_view awaiting, std::source_location)`
+  //     at each `co_await` in the coroutine (the source location is only
+  //     passed if the policy has this)
+  //   - `on_co_suspend(co_frame&)` and `on_co_resume(co_frame&, bool suspended)`
+  //     around each `co_await` (suspended is false if it completed without
+  //     suspending), resume after the initial suspend, suspend at the end
+  // - `on_allocation(size_t bytes)`: `co` frames and nursery child records
+  // - `context_data`: data in each context, copied from the parent context
+  //   (default for the root of a chain and for detached or shared work)
+  // - `static constexpr bool deadline_scheduling = true`: earliest deadline
+  //   first scheduling of chains with a deadline, see async_with_deadline
+  namespace impl
+  {
+    struct no_hooks_data
+    {
+    };
+
+    template<typename T>
+    struct co_frame_of_hooks
+    {
+      using type = no_hooks_data;
+    };
+
+    template<typename T>
+      requires requires { typename T::co_frame; }
+    struct co_frame_of_hooks<T>
+    {
+      using type = typename T::co_frame;
+    };
+
+    template<typename T>
+    using co_frame_t = typename co_frame_of_hooks<T>::type;
+
+    template<typename T>
+    struct context_data_of_hooks
+    {
+      using type = no_hooks_data;
+    };
+
+    template<typename T>
+      requires requires { typename T::context_data; }
+    struct context_data_of_hooks<T>
+    {
+      using type = typename T::context_data;
+    };
+
+    template<typename T>
+    using context_data_t = typename context_data_of_hooks<T>::type;
+
+    template<typename T>
+    concept has_on_co_attach = requires(
+      co_frame_t<T>& frame, context& ctx, std::coroutine_handle<> handle, const std::coroutine_handle<>* parent_coro)
+    {
+      { T::on_co_attach(frame, ctx, handle, parent_coro) } noexcept -> std::same_as<void>;
+    };
+
+    template<typename T>
+    concept has_on_co_await = requires(
+      co_frame_t<T>& frame, std::string_view awaiting, std::source_location location)
+    {
+      { T::on_co_await(frame, awaiting, location) } noexcept -> std::same_as<void>;
+    };
+
+    template<typename T>
+    concept has_co_suspend_hooks = requires(co_frame_t<T>& frame, bool suspended)
+    {
+      { T::on_co_suspend(frame) } noexcept -> std::same_as<void>;
+      { T::on_co_resume(frame, suspended) } noexcept -> std::same_as<void>;
+    };
+
+    template<typename T>
+    concept has_on_allocation = requires(std::size_t bytes)
+    {
+      { T::on_allocation(bytes) } noexcept -> std::same_as<void>;
+    };
+
+    template<typename T>
+    inline constexpr bool deadline_scheduling_v = requires { requires T::deadline_scheduling; };
+
+    // The data of a policy in a combined one
+    template<typename Hooks, typename Data>
+    struct hooks_part
+    {
+      [[no_unique_address]] Data data{};
+    };
+  }
+
+  // Earliest deadline first scheduling for async_with_deadline
+  struct deadline_scheduling_hooks : no_loop_hooks
+  {
+    static constexpr bool deadline_scheduling = true;
+  };
+
+  // Several policies in one, e.g. async_stack_hooks and task_account_hooks,
+  // called in order
+  template<is_loop_hooks... Hooks>
+  struct combine_loop_hooks
+  {
+    struct co_frame : impl::hooks_part<Hooks, impl::co_frame_t<Hooks>>...
+    {
+    };
+
+    struct context_data : impl::hooks_part<Hooks, impl::context_data_t<Hooks>>...
+    {
+    };
+
+    static constexpr bool deadline_scheduling = (impl::deadline_scheduling_v<Hooks> || ...);
+
+    template<typename Part>
+    static constexpr bool contains = (std::is_same_v<Part, Hooks> || ...);
+
+    static void on_push_ready(ready_node& node) noexcept
+    {
+      (Hooks::on_push_ready(node), ...);
+    }
+
+    static void on_timer_insert(timer_node& node) noexcept
+    {
+      (Hooks::on_timer_insert(node), ...);
+    }
+
+    static void on_timer_remove(timer_node& node) noexcept
+    {
+      (Hooks::on_timer_remove(node), ...);
+    }
+
+    static void on_timer_fire(timer_node& node) noexcept
+    {
+      (Hooks::on_timer_fire(node), ...);
+    }
+
+    static void on_coroutine_resume(std::coroutine_handle<> handle) noexcept
+    {
+      (Hooks::on_coroutine_resume(handle), ...);
+    }
+
+    static void on_completion(context& ctx, bool stopped) noexcept
+    {
+      (Hooks::on_completion(ctx, stopped), ...);
+    }
+
+    static void on_co_attach(
+      co_frame& frame,
+      context& ctx,
+      std::coroutine_handle<> handle,
+      const std::coroutine_handle<>* parent_coro) noexcept
+      requires (impl::has_on_co_attach<Hooks> || ...)
+    {
+      (call_on_co_attach<Hooks>(frame, ctx, handle, parent_coro), ...);
+    }
+
+    static void on_co_await(
+      co_frame& frame, std::string_view awaiting, std::source_location location) noexcept
+      requires (impl::has_on_co_await<Hooks> || ...)
+    {
+      (call_on_co_await<Hooks>(frame, awaiting, location), ...);
+    }
+
+    static void on_co_suspend(co_frame& frame) noexcept
+      requires (impl::has_co_suspend_hooks<Hooks> || ...)
+    {
+      (call_on_co_suspend<Hooks>(frame), ...);
+    }
+
+    static void on_co_resume(co_frame& frame, bool suspended) noexcept
+      requires (impl::has_co_suspend_hooks<Hooks> || ...)
+    {
+      (call_on_co_resume<Hooks>(frame, suspended), ...);
+    }
+
+    static void on_allocation(std::size_t bytes) noexcept
+      requires (impl::has_on_allocation<Hooks> || ...)
+    {
+      (call_on_allocation<Hooks>(bytes), ...);
+    }
+
+  private:
+    template<typename Part>
+    static impl::co_frame_t<Part>& part(co_frame& frame) noexcept
+    {
+      return static_cast<impl::hooks_part<Part, impl::co_frame_t<Part>>&>(frame).data;
+    }
+
+    template<typename Part>
+    static void call_on_co_attach(
+      co_frame& frame,
+      context& ctx,
+      std::coroutine_handle<> handle,
+      const std::coroutine_handle<>* parent_coro) noexcept
+    {
+      if constexpr (impl::has_on_co_attach<Part>)
+      {
+        Part::on_co_attach(part<Part>(frame), ctx, handle, parent_coro);
+      }
+    }
+
+    template<typename Part>
+    static void call_on_co_await(
+      co_frame& frame, std::string_view awaiting, std::source_location location) noexcept
+    {
+      if constexpr (impl::has_on_co_await<Part>)
+      {
+        Part::on_co_await(part<Part>(frame), awaiting, location);
+      }
+    }
+
+    template<typename Part>
+    static void call_on_co_suspend(co_frame& frame) noexcept
+    {
+      if constexpr (impl::has_co_suspend_hooks<Part>)
+      {
+        Part::on_co_suspend(part<Part>(frame));
+      }
+    }
+
+    // In reverse order would be more symmetric, but the parts
+    // are not expected to depend on each other
+    template<typename Part>
+    static void call_on_co_resume(co_frame& frame, bool suspended) noexcept
+    {
+      if constexpr (impl::has_co_suspend_hooks<Part>)
+      {
+        Part::on_co_resume(part<Part>(frame), suspended);
+      }
+    }
+
+    template<typename Part>
+    static void call_on_allocation(std::size_t bytes) noexcept
+    {
+      if constexpr (impl::has_on_allocation<Part>)
+      {
+        Part::on_allocation(bytes);
+      }
+    }
+  };
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "abi.h"
 #include "context.h"
 
 #include "../cpp_util_lib/intrusive_list.h"
@@ -7,7 +8,7 @@
 #include <cassert>
 #include <coroutine>
 
-namespace coro_st
+namespace CORO_ST_NAMESPACE
 {
   class mutex
   {
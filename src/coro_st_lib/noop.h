@@ -1,10 +1,11 @@
 #pragma once
 
+#include "abi.h"
 #include "context.h"
 
 #include <coroutine>
 
-namespace coro_st
+namespace CORO_ST_NAMESPACE
 {
   class [[nodiscard]] noop_task
   {
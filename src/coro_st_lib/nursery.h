@@ -1,22 +1,41 @@
 #pragma once
 
+#include "abi.h"
 #include "call_capture.h"
 #include "callback.h"
 #include "context.h"
 #include "coro_type_traits.h"
 #include "stop_util.h"
 
+#include "../cpp_util_lib/intrusive_list.h"
+
 #include <cassert>
 #include <coroutine>
+#include <limits>
 #include <memory>
+#include <optional>
 #include <type_traits>
 
-namespace coro_st
+namespace CORO_ST_NAMESPACE
 {
   class nursery;
 
   namespace impl
   {
+    // Node for a spawner waiting in async_spawn_child for the
+    // nursery to get below its max live children
+    struct nursery_admission_node
+    {
+      nursery_admission_node* next{ nullptr };
+      nursery_admission_node* prev{ nullptr };
+      callback cb{};
+    };
+
+    using nursery_admission_list = cpp_util::intrusive_list<
+      nursery_admission_node,
+      &nursery_admission_node::next,
+      &nursery_admission_node::prev>;
+
     struct nursery_awaiter_shared_data
     {
       enum class outcome_state
@@ -32,15 +51,21 @@ namespace coro_st
       size_t pending_count_;
       std::exception_ptr exception_;
       outcome_state outcome_{ outcome_state::has_result };
+      size_t live_children_count_{ 0 };
+      size_t max_live_children_;
+      nursery_admission_list admission_list_;
 
-      nursery_awaiter_shared_data(context& parent_ctx) noexcept :
+      nursery_awaiter_shared_data(context& parent_ctx, size_t max_live_children) noexcept :
         parent_ctx_{ parent_ctx },
         parent_handle_{},
         parent_stop_cb_{},
         children_stop_source_{},
         pending_count_{ 0 },
         exception_{},
-        outcome_{ outcome_state::has_result }
+        outcome_{ outcome_state::has_result },
+        live_children_count_{ 0 },
+        max_live_children_{ max_live_children },
+        admission_list_{}
       {
       }
 
@@ -66,7 +91,7 @@ namespace coro_st
 
         if (parent_handle_)
         {
-          parent_handle_.resume();
+          parent_ctx_.resume_coroutine(parent_handle_);
           return;
         }
 
@@ -79,6 +104,27 @@ namespace coro_st
         outcome_ = outcome_state::has_stop;
         children_stop_source_.request_stop();
       }
+
+      bool has_capacity() const noexcept
+      {
+        return live_children_count_ < max_live_children_;
+      }
+
+      // Reserves a live child slot for each admitted spawner,
+      // the spawners only schedule their continuation
+      void admit_waiting_spawners() noexcept
+      {
+        while (has_capacity())
+        {
+          nursery_admission_node* node = admission_list_.pop_front();
+          if (nullptr == node)
+          {
+            return;
+          }
+          ++live_children_count_;
+          node->cb.invoke();
+        }
+      }
     };
 
     template<is_co_work CoWork>
@@ -246,6 +292,9 @@ namespace coro_st
 
         std::unique_ptr<nursery_spawn_child> self_destruct{ this };
 
+        --shared_data_local->live_children_count_;
+        shared_data_local->admit_waiting_spawners();
+
         --shared_data_local->pending_count_;
         if (0 != shared_data_local->pending_count_)
         {
@@ -281,7 +330,7 @@ namespace coro_st
           CoWork& co_work
         ) :
           nursery_{ nursery },
-          shared_data_{ parent_ctx },
+          shared_data_{ parent_ctx, nursery.max_live_children_ },
           initial_unstarted_work_{
             std::make_unique<impl::nursery_initial_child<CoWork>>(
               shared_data_, co_work
@@ -415,12 +464,203 @@ namespace coro_st
       }
     };
 
+    template<typename Fn, typename... Args>
+    class [[nodiscard]] nursery_spawn_child_task
+    {
+      using Child = impl::nursery_spawn_child<Fn, Args...>;
+
+    private:
+      class [[nodiscard]] awaiter
+      {
+        context& ctx_;
+        std::coroutine_handle<> parent_handle_;
+        impl::nursery_awaiter_shared_data& shared_data_;
+        std::unique_ptr<Child> unstarted_child_;
+        impl::nursery_admission_node admission_node_;
+        ready_node admitted_node_;
+        std::optional<stop_callback<callback>> parent_stop_cb_;
+
+      public:
+        awaiter(
+          context& ctx,
+          impl::nursery_awaiter_shared_data& shared_data,
+          std::unique_ptr<Child> unstarted_child
+        ) noexcept :
+          ctx_{ ctx },
+          parent_handle_{},
+          shared_data_{ shared_data },
+          unstarted_child_{ std::move(unstarted_child) },
+          admission_node_{},
+          admitted_node_{},
+          parent_stop_cb_{ std::nullopt }
+        {
+        }
+
+        awaiter(const awaiter&) = delete;
+        awaiter& operator=(const awaiter&) = delete;
+
+        [[nodiscard]] constexpr bool await_ready() const noexcept
+        {
+          return false;
+        }
+
+        bool await_suspend(std::coroutine_handle<> handle) noexcept
+        {
+          parent_handle_ = handle;
+          if (ctx_.get_stop_token().stop_requested())
+          {
+            ctx_.invoke_stopped();
+            return true;
+          }
+          if (shared_data_.has_capacity())
+          {
+            ++shared_data_.live_children_count_;
+            unstarted_child_.release()->start();
+            return false;
+          }
+          enqueue_admission_node();
+          return true;
+        }
+
+        constexpr void await_resume() const noexcept
+        {
+        }
+
+        std::exception_ptr get_result_exception() const noexcept
+        {
+          return {};
+        }
+
+        void start() noexcept
+        {
+          if (ctx_.get_stop_token().stop_requested())
+          {
+            ctx_.invoke_stopped();
+            return;
+          }
+          if (shared_data_.has_capacity())
+          {
+            ++shared_data_.live_children_count_;
+            unstarted_child_.release()->start();
+            ctx_.invoke_result_ready();
+            return;
+          }
+          enqueue_admission_node();
+        }
+
+      private:
+        void enqueue_admission_node() noexcept
+        {
+          admission_node_.cb = make_member_callback<&awaiter::on_admitted>(this);
+          shared_data_.admission_list_.push_back(&admission_node_);
+          parent_stop_cb_.emplace(
+            ctx_.get_stop_token(),
+            make_member_callback<&awaiter::on_cancel>(this));
+        }
+
+        // Called from the completion of another child, with the live
+        // child slot already reserved: schedule rather than start the
+        // child here to avoid growing the stack
+        void on_admitted() noexcept
+        {
+          parent_stop_cb_.reset();
+          admitted_node_.cb = make_member_callback<&awaiter::on_admitted_ready>(this);
+          ctx_.push_ready_node(admitted_node_);
+        }
+
+        void on_admitted_ready() noexcept
+        {
+          if (ctx_.get_stop_token().stop_requested())
+          {
+            // give the slot to the next spawner, the unstarted child
+            // is destroyed with the awaiter
+            --shared_data_.live_children_count_;
+            shared_data_.admit_waiting_spawners();
+            ctx_.invoke_stopped();
+            return;
+          }
+
+          unstarted_child_.release()->start();
+
+          if (parent_handle_)
+          {
+            ctx_.resume_coroutine(parent_handle_);
+            return;
+          }
+
+          ctx_.invoke_result_ready();
+        }
+
+        void on_cancel() noexcept
+        {
+          parent_stop_cb_.reset();
+          shared_data_.admission_list_.remove(&admission_node_);
+          ctx_.schedule_stopped();
+        }
+      };
+
+      struct [[nodiscard]] work
+      {
+        impl::nursery_awaiter_shared_data* shared_data_;
+        std::unique_ptr<Child> unstarted_child_;
+
+        work(
+          impl::nursery_awaiter_shared_data& shared_data,
+          std::unique_ptr<Child> unstarted_child
+        ) noexcept:
+          shared_data_{ &shared_data },
+          unstarted_child_{ std::move(unstarted_child) }
+        {
+        }
+
+        work(const work&) = delete;
+        work& operator=(const work&) = delete;
+        work(work&&) noexcept = default;
+        work& operator=(work&&) noexcept = default;
+
+        [[nodiscard]] awaiter get_awaiter(context& ctx) noexcept
+        {
+          return {ctx, *shared_data_, std::move(unstarted_child_)};
+        }
+      };
+
+    private:
+      work work_;
+
+    public:
+      nursery_spawn_child_task(
+        impl::nursery_awaiter_shared_data& shared_data,
+        std::unique_ptr<Child> unstarted_child
+      ) noexcept :
+        work_{ shared_data, std::move(unstarted_child) }
+      {
+      }
+
+      nursery_spawn_child_task(const nursery_spawn_child_task&) = delete;
+      nursery_spawn_child_task& operator=(const nursery_spawn_child_task&) = delete;
+
+      [[nodiscard]] work get_work() noexcept
+      {
+        return std::move(work_);
+      }
+    };
+
   private:
     impl::nursery_awaiter_shared_data* impl_{ nullptr };
+    size_t max_live_children_{ std::numeric_limits<size_t>::max() };
 
   public:
     nursery() noexcept = default;
 
+    // Limits the live spawned children: async_spawn_child waits for
+    // capacity, spawn_child does not wait, but counts as live;
+    // the initial child does not count
+    explicit nursery(size_t max_live_children) noexcept :
+      max_live_children_{ max_live_children }
+    {
+      assert(max_live_children_ > 0);
+    }
+
     nursery(const nursery&) noexcept = delete;
     nursery& operator=(const nursery&) noexcept = delete;
 
@@ -448,6 +688,7 @@ namespace coro_st
 
       assert(nullptr != impl_);
 
+      impl::hooks_on_allocation(sizeof(impl::nursery_spawn_child<Fn, Args...>));
       auto spawn_unstarted_work_ =
         std::make_unique<
           impl::nursery_spawn_child<Fn, Args...>>(
@@ -456,7 +697,33 @@ namespace coro_st
             std::forward<Args>(args)...
         );
 
+        ++impl_->live_children_count_;
         spawn_unstarted_work_.release()->start();
     }
+
+    // Like spawn_child, but suspends while the nursery has
+    // max live children, resuming when one of them completes
+    template<typename Fn, typename... Args>
+    [[nodiscard]] nursery_spawn_child_task<Fn, Args...>
+      async_spawn_child(Fn&& fn, Args&&... args)
+    {
+      using CaptureResult = typename call_capture<Fn, Args...>::result_type;
+      static_assert(is_co_task<CaptureResult>);
+      static_assert(std::is_same_v<
+        void,
+        co_task_result_t<CaptureResult>>);
+
+      assert(nullptr != impl_);
+
+      impl::hooks_on_allocation(sizeof(impl::nursery_spawn_child<Fn, Args...>));
+      return nursery_spawn_child_task<Fn, Args...>{
+        *impl_,
+        std::make_unique<
+          impl::nursery_spawn_child<Fn, Args...>>(
+            *impl_,
+            std::forward<Fn>(fn),
+            std::forward<Args>(args)...
+        ) };
+    }
   };
 }
\ No newline at end of file
@@ -0,0 +1,687 @@
+#pragma once
+
+#include "abi.h"
+#include "callback.h"
+#include "context.h"
+#include "coro_type_traits.h"
+#include "event_loop_context.h"
+#include "ready_queue.h"
+#include "stop_util.h"
+#include "timer_heap.h"
+
+#include "../cpp_util_lib/intrusive_list.h"
+
+#include <cassert>
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace CORO_ST_NAMESPACE
+{
+  template<typename T, typename FactoryFn>
+  class pool
+  {
+    using FactoryTask = std::invoke_result_t<FactoryFn&>;
+    static_assert(is_co_task<FactoryTask>);
+    static_assert(std::is_same_v<T, co_task_result_t<FactoryTask>>,
+      "The factory has to return a task with the result type T");
+    using FactoryAwaiter = co_task_awaiter_t<FactoryTask>;
+
+    struct entry
+    {
+      T value_;
+      entry* next_{ nullptr };
+      entry* prev_{ nullptr };
+      std::chrono::steady_clock::time_point idle_since_{};
+
+      explicit entry(T&& value) :
+        value_{ std::move(value) }
+      {
+      }
+
+      entry(const entry&) = delete;
+      entry& operator=(const entry&) = delete;
+    };
+
+    using idle_list = cpp_util::intrusive_list<
+      entry,
+      &entry::next_,
+      &entry::prev_>;
+
+  public:
+    // Owns a resource from the pool, returns it to the pool when destroyed
+    class lease
+    {
+      friend class pool;
+
+      pool* pool_{ nullptr };
+      entry* entry_{ nullptr };
+      bool healthy_{ true };
+
+      lease(pool& p, entry* e) noexcept :
+        pool_{ &p },
+        entry_{ e },
+        healthy_{ true }
+      {
+      }
+
+    public:
+      lease() noexcept = default;
+
+      lease(const lease&) = delete;
+      lease& operator=(const lease&) = delete;
+
+      lease(lease&& other) noexcept :
+        pool_{ std::exchange(other.pool_, nullptr) },
+        entry_{ std::exchange(other.entry_, nullptr) },
+        healthy_{ std::exchange(other.healthy_, true) }
+      {
+      }
+
+      lease& operator=(lease&& other) noexcept
+      {
+        if (this != &other)
+        {
+          reset();
+          pool_ = std::exchange(other.pool_, nullptr);
+          entry_ = std::exchange(other.entry_, nullptr);
+          healthy_ = std::exchange(other.healthy_, true);
+        }
+        return *this;
+      }
+
+      ~lease()
+      {
+        reset();
+      }
+
+      explicit operator bool() const noexcept
+      {
+        return entry_ != nullptr;
+      }
+
+      T& get() const noexcept
+      {
+        assert(entry_ != nullptr);
+        return entry_->value_;
+      }
+
+      T& operator*() const noexcept
+      {
+        return get();
+      }
+
+      T* operator->() const noexcept
+      {
+        return &get();
+      }
+
+      // The resource is broken (e.g. the connection was reset): it is
+      // destroyed when released instead of being reused
+      void invalidate() noexcept
+      {
+        healthy_ = false;
+      }
+
+      // Returns the resource to the pool early
+      void reset() noexcept
+      {
+        if (entry_ != nullptr)
+        {
+          pool_->release(std::exchange(entry_, nullptr), healthy_);
+        }
+        healthy_ = true;
+      }
+    };
+
+    class [[nodiscard]] pool_acquire_task
+    {
+      friend class pool;
+
+      class [[nodiscard]] awaiter
+      {
+        friend class pool;
+
+        enum class outcome_state
+        {
+          none,
+          has_result,
+          has_stopped,
+        };
+
+        // Allows constructing the non movable factory awaiter in place
+        struct factory_awaiter_builder
+        {
+          FactoryFn* fn_;
+          context* ctx_;
+
+          operator FactoryAwaiter() const
+          {
+            return std::invoke(*fn_).get_work().get_awaiter(*ctx_);
+          }
+        };
+
+        context& ctx_;
+        std::coroutine_handle<> parent_handle_;
+        pool& pool_;
+        entry* entry_{ nullptr };
+        std::exception_ptr exception_;
+        outcome_state outcome_state_{ outcome_state::none };
+        bool pending_start_{ false };
+        awaiter* next_waiting_{ nullptr };
+        awaiter* prev_waiting_{ nullptr };
+        std::optional<stop_callback<callback>> parent_stop_cb_;
+        ready_node create_node_;
+        std::optional<context> factory_ctx_;
+        std::optional<FactoryAwaiter> factory_awaiter_;
+
+      public:
+        awaiter(context& ctx, pool& p) noexcept :
+          ctx_{ ctx },
+          parent_handle_{},
+          pool_{ p },
+          entry_{ nullptr },
+          exception_{},
+          outcome_state_{ outcome_state::none },
+          pending_start_{ false },
+          next_waiting_{ nullptr },
+          prev_waiting_{ nullptr },
+          parent_stop_cb_{ std::nullopt },
+          create_node_{},
+          factory_ctx_{},
+          factory_awaiter_{}
+        {
+        }
+
+        awaiter(const awaiter&) = delete;
+        awaiter& operator=(const awaiter&) = delete;
+
+        ~awaiter()
+        {
+          // acquired, but the result was not used
+          if (entry_ != nullptr)
+          {
+            pool_.release(entry_, true);
+          }
+        }
+
+        [[nodiscard]] constexpr bool await_ready() const noexcept
+        {
+          return false;
+        }
+
+        bool await_suspend(std::coroutine_handle<> handle) noexcept
+        {
+          parent_handle_ = handle;
+          if (ctx_.get_stop_token().stop_requested())
+          {
+            ctx_.invoke_stopped();
+            return true;
+          }
+          if (!try_acquire())
+          {
+            return true;
+          }
+          if (outcome_state::has_stopped == outcome_state_)
+          {
+            ctx_.invoke_stopped();
+            return true;
+          }
+          return false;
+        }
+
+        lease await_resume()
+        {
+          if (exception_)
+          {
+            std::rethrow_exception(exception_);
+          }
+          assert(entry_ != nullptr);
+          return lease{ pool_, std::exchange(entry_, nullptr) };
+        }
+
+        std::exception_ptr get_result_exception() const noexcept
+        {
+          return exception_;
+        }
+
+        void start() noexcept
+        {
+          if (ctx_.get_stop_token().stop_requested())
+          {
+            ctx_.invoke_stopped();
+            return;
+          }
+          if (!try_acquire())
+          {
+            return;
+          }
+          if (outcome_state::has_stopped == outcome_state_)
+          {
+            ctx_.invoke_stopped();
+            return;
+          }
+          ctx_.invoke_result_ready();
+        }
+
+      private:
+        // Returns true if it completed immediately: either got an idle
+        // resource or the factory completed immediately
+        bool try_acquire() noexcept
+        {
+          pool_.set_event_loop_context(ctx_.get_event_loop_context());
+
+          entry_ = pool_.pop_idle();
+          if (entry_ != nullptr)
+          {
+            outcome_state_ = outcome_state::has_result;
+            return true;
+          }
+
+          if (pool_.try_reserve())
+          {
+            return start_create();
+          }
+
+          pool_.wait_list_.push_back(this);
+          parent_stop_cb_.emplace(
+            ctx_.get_stop_token(),
+            make_member_callback<&awaiter::on_cancel>(this));
+          return false;
+        }
+
+        // The slot for the new resource was already reserved
+        bool start_create() noexcept
+        {
+          // The resource outlives the caller, so the factory does not
+          // inherit the caller's hooks data e.g. the task account
+          factory_ctx_.emplace(
+            ctx_.get_event_loop_context(),
+            ctx_.get_stop_token(),
+            make_member_completion<
+              &awaiter::on_factory_result_ready,
+              &awaiter::on_factory_stopped
+              >(this));
+          try
+          {
+            factory_awaiter_.emplace(factory_awaiter_builder{ &pool_.factory_fn_, &*factory_ctx_ });
+          }
+          catch(...)
+          {
+            factory_ctx_.reset();
+            exception_ = std::current_exception();
+            outcome_state_ = outcome_state::has_result;
+            pool_.on_create_failed();
+            return true;
+          }
+
+          pending_start_ = true;
+          factory_awaiter_->start();
+          pending_start_ = false;
+
+          return outcome_state::none != outcome_state_;
+        }
+
+        void on_factory_result_ready() noexcept
+        {
+          std::exception_ptr e = factory_awaiter_->get_result_exception();
+          if (!e)
+          {
+            try
+            {
+              entry_ = new entry(factory_awaiter_->await_resume());
+            }
+            catch(...)
+            {
+              e = std::current_exception();
+            }
+          }
+          // the factory invoked this completion as its last action
+          factory_awaiter_.reset();
+          factory_ctx_.reset();
+
+          if (e)
+          {
+            exception_ = e;
+            pool_.on_create_failed();
+          }
+          outcome_state_ = outcome_state::has_result;
+          on_shared_continue();
+        }
+
+        void on_factory_stopped() noexcept
+        {
+          factory_awaiter_.reset();
+          factory_ctx_.reset();
+
+          pool_.on_create_failed();
+          outcome_state_ = outcome_state::has_stopped;
+          on_shared_continue();
+        }
+
+        void on_shared_continue() noexcept
+        {
+          if (pending_start_)
+          {
+            return;
+          }
+
+          if (outcome_state::has_stopped == outcome_state_)
+          {
+            ctx_.invoke_stopped();
+            return;
+          }
+
+          if (parent_handle_)
+          {
+            ctx_.resume_coroutine(parent_handle_);
+            return;
+          }
+
+          ctx_.invoke_result_ready();
+        }
+
+        // Called after the pool already unlinked it from the wait list
+        void on_entry_handed(entry* e) noexcept
+        {
+          parent_stop_cb_.reset();
+          entry_ = e;
+          outcome_state_ = outcome_state::has_result;
+
+          if (parent_handle_)
+          {
+            ctx_.schedule_coroutine_resume(parent_handle_);
+            return;
+          }
+
+          ctx_.schedule_result_ready();
+        }
+
+        // Called after the pool already unlinked it from the wait list
+        // and reserved the slot for a new resource. The factory is
+        // started later, from the event loop
+        void on_create_permitted() noexcept
+        {
+          parent_stop_cb_.reset();
+          create_node_.cb = make_member_callback<&awaiter::on_create_ready>(this);
+          ctx_.push_ready_node(create_node_);
+        }
+
+        void on_create_ready() noexcept
+        {
+          if (ctx_.get_stop_token().stop_requested())
+          {
+            // give the slot to the next waiter
+            pool_.on_create_failed();
+            ctx_.invoke_stopped();
+            return;
+          }
+
+          if (start_create())
+          {
+            on_shared_continue();
+          }
+        }
+
+        void on_cancel() noexcept
+        {
+          parent_stop_cb_.reset();
+          pool_.wait_list_.remove(this);
+          ctx_.schedule_stopped();
+        }
+      };
+
+      struct [[nodiscard]] work
+      {
+        pool* pool_;
+
+        explicit work(pool& p) noexcept :
+          pool_{ &p }
+        {
+        }
+
+        work(const work&) = delete;
+        work& operator=(const work&) = delete;
+        work(work&&) noexcept = default;
+        work& operator=(work&&) noexcept = default;
+
+        [[nodiscard]] awaiter get_awaiter(context& ctx) noexcept
+        {
+          return {ctx, *pool_};
+        }
+      };
+
+    private:
+      work work_;
+
+    public:
+      explicit pool_acquire_task(pool& p) noexcept :
+        work_{ p }
+      {
+      }
+
+      pool_acquire_task(const pool_acquire_task&) = delete;
+      pool_acquire_task& operator=(const pool_acquire_task&) = delete;
+
+      [[nodiscard]] work get_work() noexcept
+      {
+        return std::move(work_);
+      }
+    };
+
+  private:
+    using awaiter = typename pool_acquire_task::awaiter;
+
+    using wait_list = cpp_util::intrusive_list<
+      awaiter,
+      &awaiter::next_waiting_,
+      &awaiter::prev_waiting_>;
+
+    size_t max_size_;
+    std::chrono::steady_clock::duration idle_timeout_;
+    FactoryFn factory_fn_;
+    // resources created, including the ones being created
+    size_t size_{ 0 };
+    // most recently used at the back
+    idle_list idle_list_;
+    size_t idle_size_{ 0 };
+    wait_list wait_list_;
+    event_loop_context* event_loop_ctx_{ nullptr };
+    // one timer for the oldest idle resource
+    timer_node timer_node_;
+    bool timer_armed_{ false };
+
+  public:
+    // A zero idle timeout disables the eviction of idle resources.
+    // Otherwise the pool uses the event loop for the idle timer and it has
+    // to be destroyed before the event loop e.g. declare it in a coroutine
+    pool(
+      size_t max_size,
+      std::chrono::steady_clock::duration idle_timeout,
+      FactoryFn factory_fn
+    ) :
+      max_size_{ max_size },
+      idle_timeout_{ idle_timeout },
+      factory_fn_(std::move(factory_fn)),
+      size_{ 0 },
+      idle_list_{},
+      idle_size_{ 0 },
+      wait_list_{},
+      event_loop_ctx_{ nullptr },
+      timer_node_{ std::chrono::steady_clock::time_point{} },
+      timer_armed_{ false }
+    {
+      assert(max_size_ > 0);
+    }
+
+    pool(const pool&) = delete;
+    pool& operator=(const pool&) = delete;
+
+    ~pool()
+    {
+      assert(wait_list_.empty());
+      // all the leases were returned
+      assert(size_ == idle_size_);
+      disarm_timer();
+      while (true)
+      {
+        entry* e = idle_list_.pop_front();
+        if (e == nullptr)
+        {
+          break;
+        }
+        delete e;
+      }
+    }
+
+    // Number of resources, in use or idle
+    size_t size() const noexcept
+    {
+      return size_;
+    }
+
+    size_t idle_size() const noexcept
+    {
+      return idle_size_;
+    }
+
+    size_t max_size() const noexcept
+    {
+      return max_size_;
+    }
+
+    // Reuses an idle resource, or creates one using the factory if under
+    // max_size, or waits for a resource to be released
+    [[nodiscard]] pool_acquire_task async_acquire() noexcept
+    {
+      return pool_acquire_task{ *this };
+    }
+
+  private:
+    void set_event_loop_context(event_loop_context& event_loop_ctx) noexcept
+    {
+      assert((nullptr == event_loop_ctx_) || (&event_loop_ctx == event_loop_ctx_));
+      event_loop_ctx_ = &event_loop_ctx;
+    }
+
+    entry* pop_idle() noexcept
+    {
+      // most recently used: the older ones get a chance to be evicted
+      entry* e = idle_list_.back();
+      if (e == nullptr)
+      {
+        return nullptr;
+      }
+      idle_list_.remove(e);
+      --idle_size_;
+      return e;
+    }
+
+    bool try_reserve() noexcept
+    {
+      if (size_ >= max_size_)
+      {
+        return false;
+      }
+      ++size_;
+      return true;
+    }
+
+    void on_create_failed() noexcept
+    {
+      assert(size_ > 0);
+      --size_;
+      permit_waiter_to_create();
+    }
+
+    void permit_waiter_to_create() noexcept
+    {
+      if (size_ >= max_size_)
+      {
+        return;
+      }
+      awaiter* waiting = wait_list_.pop_front();
+      if (waiting == nullptr)
+      {
+        return;
+      }
+      ++size_;
+      waiting->on_create_permitted();
+    }
+
+    void release(entry* e, bool healthy) noexcept
+    {
+      if (!healthy)
+      {
+        delete e;
+        assert(size_ > 0);
+        --size_;
+        permit_waiter_to_create();
+        return;
+      }
+
+      awaiter* waiting = wait_list_.pop_front();
+      if (waiting != nullptr)
+      {
+        waiting->on_entry_handed(e);
+        return;
+      }
+
+      assert(event_loop_ctx_ != nullptr);
+      e->idle_since_ = event_loop_ctx_->now();
+      idle_list_.push_back(e);
+      ++idle_size_;
+      arm_timer();
+    }
+
+    void arm_timer() noexcept
+    {
+      if (
+        timer_armed_ ||
+        idle_list_.empty() ||
+        (idle_timeout_ <= std::chrono::steady_clock::duration::zero()))
+      {
+        return;
+      }
+      timer_node_.deadline = idle_list_.front()->idle_since_ + idle_timeout_;
+      timer_node_.cb = make_member_callback<&pool::on_timer>(this);
+      event_loop_ctx_->insert_timer_node(timer_node_);
+      timer_armed_ = true;
+    }
+
+    void disarm_timer() noexcept
+    {
+      if (timer_armed_)
+      {
+        event_loop_ctx_->remove_timer_node(timer_node_);
+        timer_armed_ = false;
+      }
+    }
+
+    void on_timer() noexcept
+    {
+      // already removed from the heap by the event loop
+      timer_armed_ = false;
+
+      auto now = event_loop_ctx_->now();
+      while (true)
+      {
+        entry* e = idle_list_.front();
+        if ((e == nullptr) || (e->idle_since_ + idle_timeout_ > now))
+        {
+          break;
+        }
+        idle_list_.remove(e);
+        --idle_size_;
+        --size_;
+        delete e;
+      }
+
+      arm_timer();
+    }
+  };
+}
@@ -0,0 +1,381 @@
+#pragma once
+
+#include "abi.h"
+#include "fd_io.h"
+#include "io_poller.h"
+
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace CORO_ST_NAMESPACE
+{
+  struct process_exit_status
+  {
+    // CLD_EXITED, CLD_KILLED or CLD_DUMPED
+    int code{ 0 };
+    // the exit code or the signal number
+    int status{ 0 };
+
+    bool exited() const noexcept
+    {
+      return CLD_EXITED == code;
+    }
+
+    int exit_code() const noexcept
+    {
+      assert(exited());
+      return status;
+    }
+
+    bool signaled() const noexcept
+    {
+      return (CLD_KILLED == code) || (CLD_DUMPED == code);
+    }
+
+    int term_signal() const noexcept
+    {
+      assert(signaled());
+      return status;
+    }
+  };
+
+  struct process_options
+  {
+    // pipes to the parent, otherwise inherited
+    bool pipe_stdin{ false };
+    bool pipe_stdout{ true };
+    bool pipe_stderr{ false };
+  };
+
+  namespace impl
+  {
+    // Via syscall: the glibc wrappers are recent (and not extern "C" in 2.36)
+    inline int pidfd_open(pid_t pid) noexcept
+    {
+      return static_cast<int>(::syscall(SYS_pidfd_open, pid, 0));
+    }
+
+    inline int pidfd_send_signal(int pidfd, int signal_number) noexcept
+    {
+      return static_cast<int>(::syscall(SYS_pidfd_send_signal, pidfd, signal_number, nullptr, 0));
+    }
+
+    struct wait_process_op
+    {
+      using result_type = process_exit_status;
+
+      int pidfd_;
+
+      int fd() const noexcept
+      {
+        return pidfd_;
+      }
+
+      std::uint32_t events() const noexcept
+      {
+        return EPOLLIN;
+      }
+
+      std::optional<process_exit_status> try_op()
+      {
+        siginfo_t info{};
+        if (0 != ::waitid(P_PIDFD, static_cast<id_t>(pidfd_), &info, WEXITED | WNOHANG))
+        {
+          throw std::system_error(errno, std::generic_category(), "waitid");
+        }
+        if (0 == info.si_pid)
+        {
+          return std::nullopt;
+        }
+        return process_exit_status{ info.si_code, info.si_status };
+      }
+    };
+
+    struct spawn_file_actions
+    {
+      posix_spawn_file_actions_t actions;
+
+      spawn_file_actions()
+      {
+        int error = ::posix_spawn_file_actions_init(&actions);
+        if (0 != error)
+        {
+          throw std::system_error(error, std::generic_category(), "posix_spawn_file_actions_init");
+        }
+      }
+
+      spawn_file_actions(const spawn_file_actions&) = delete;
+      spawn_file_actions& operator=(const spawn_file_actions&) = delete;
+
+      ~spawn_file_actions()
+      {
+        static_cast<void>(::posix_spawn_file_actions_destroy(&actions));
+      }
+
+      void add_dup2(int fd, int new_fd)
+      {
+        int error = ::posix_spawn_file_actions_adddup2(&actions, fd, new_fd);
+        if (0 != error)
+        {
+          throw std::system_error(error, std::generic_category(), "posix_spawn_file_actions_adddup2");
+        }
+      }
+    };
+
+    struct spawn_attr
+    {
+      posix_spawnattr_t attr;
+
+      spawn_attr()
+      {
+        int error = ::posix_spawnattr_init(&attr);
+        if (0 != error)
+        {
+          throw std::system_error(error, std::generic_category(), "posix_spawnattr_init");
+        }
+      }
+
+      spawn_attr(const spawn_attr&) = delete;
+      spawn_attr& operator=(const spawn_attr&) = delete;
+
+      ~spawn_attr()
+      {
+        static_cast<void>(::posix_spawnattr_destroy(&attr));
+      }
+    };
+
+    // Both ends close on exec, the parent end is non-blocking
+    inline void make_pipe(fd_handle& read_end, fd_handle& write_end, bool parent_reads)
+    {
+      int fds[2];
+      if (0 != ::pipe2(fds, O_CLOEXEC))
+      {
+        throw std::system_error(errno, std::generic_category(), "pipe2");
+      }
+      read_end.reset(fds[0]);
+      write_end.reset(fds[1]);
+
+      int parent_fd = parent_reads ? fds[0] : fds[1];
+      int flags = ::fcntl(parent_fd, F_GETFL);
+      if ((-1 == flags) || (0 != ::fcntl(parent_fd, F_SETFL, flags | O_NONBLOCK)))
+      {
+        throw std::system_error(errno, std::generic_category(), "fcntl");
+      }
+    }
+  }
+
+  using wait_process_task = impl::fd_op_task<impl::make_op<impl::wait_process_op>>;
+
+  // A child process, with a pidfd to wait for its exit from the event loop
+  // and optional non-blocking pipes for its standard streams.
+  //
+  // If it was not waited for, the destructor kills the child and blocks
+  // until it exits.
+  class process
+  {
+    friend process spawn_process(std::span<const std::string>, const process_options&);
+
+    fd_handle pidfd_;
+    pid_t pid_{ -1 };
+    fd_handle stdin_;
+    fd_handle stdout_;
+    fd_handle stderr_;
+
+  public:
+    process() noexcept = default;
+
+    process(const process&) = delete;
+    process& operator=(const process&) = delete;
+
+    process(process&& other) noexcept :
+      pidfd_{ std::move(other.pidfd_) },
+      pid_{ std::exchange(other.pid_, -1) },
+      stdin_{ std::move(other.stdin_) },
+      stdout_{ std::move(other.stdout_) },
+      stderr_{ std::move(other.stderr_) }
+    {
+    }
+
+    process& operator=(process&& other) noexcept
+    {
+      kill_and_reap();
+      pidfd_ = std::move(other.pidfd_);
+      pid_ = std::exchange(other.pid_, -1);
+      stdin_ = std::move(other.stdin_);
+      stdout_ = std::move(other.stdout_);
+      stderr_ = std::move(other.stderr_);
+      return *this;
+    }
+
+    ~process()
+    {
+      kill_and_reap();
+    }
+
+    pid_t pid() const noexcept
+    {
+      return pid_;
+    }
+
+    // -1 unless piped
+    int stdin_fd() const noexcept
+    {
+      return stdin_.get();
+    }
+
+    int stdout_fd() const noexcept
+    {
+      return stdout_.get();
+    }
+
+    int stderr_fd() const noexcept
+    {
+      return stderr_.get();
+    }
+
+    // Signals the end of the input to the child
+    void close_stdin() noexcept
+    {
+      stdin_.reset();
+    }
+
+    [[nodiscard]] write_some_task async_write_stdin(std::span<const char> buffer) noexcept
+    {
+      assert(stdin_.is_valid());
+      return async_write_some(stdin_.get(), buffer);
+    }
+
+    // Returns 0 at end of file
+    [[nodiscard]] read_some_task async_read_stdout(std::span<char> buffer) noexcept
+    {
+      assert(stdout_.is_valid());
+      return async_read_some(stdout_.get(), buffer);
+    }
+
+    [[nodiscard]] read_some_task async_read_stderr(std::span<char> buffer) noexcept
+    {
+      assert(stderr_.is_valid());
+      return async_read_some(stderr_.get(), buffer);
+    }
+
+    // Completes when the child exits, reaping it
+    [[nodiscard]] wait_process_task async_wait() noexcept
+    {
+      assert(pidfd_.is_valid());
+      return wait_process_task{ impl::make_op<impl::wait_process_op>{ { pidfd_.get() } } };
+    }
+
+    // No effect if the child already exited
+    void kill(int signal_number = SIGKILL)
+    {
+      assert(pidfd_.is_valid());
+      if (0 != impl::pidfd_send_signal(pidfd_.get(), signal_number))
+      {
+        if (ESRCH != errno)
+        {
+          throw std::system_error(errno, std::generic_category(), "pidfd_send_signal");
+        }
+      }
+    }
+
+  private:
+    void kill_and_reap() noexcept
+    {
+      if (!pidfd_.is_valid())
+      {
+        return;
+      }
+      // both fail harmlessly if already reaped
+      static_cast<void>(impl::pidfd_send_signal(pidfd_.get(), SIGKILL));
+      siginfo_t info{};
+      static_cast<void>(::waitid(P_PIDFD, static_cast<id_t>(pidfd_.get()), &info, WEXITED));
+      pidfd_.reset();
+      pid_ = -1;
+    }
+  };
+
+  // Starts args[0] (searched in PATH) with the arguments args. Does not block:
+  // the I/O and waiting for the exit are via the event loop.
+  //
+  // The child starts with no signals blocked and default signal actions.
+  // Writing to a child that closed its stdin raises SIGPIPE in the parent,
+  // ignore it to get an EPIPE error instead.
+  inline process spawn_process(std::span<const std::string> args, const process_options& options = {})
+  {
+    assert(!args.empty());
+    std::vector<char*> argv;
+    argv.reserve(args.size() + 1);
+    for (const std::string& arg : args)
+    {
+      argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    impl::spawn_file_actions actions;
+    fd_handle child_stdin;
+    fd_handle child_stdout;
+    fd_handle child_stderr;
+    process result;
+
+    if (options.pipe_stdin)
+    {
+      impl::make_pipe(child_stdin, result.stdin_, false);
+      actions.add_dup2(child_stdin.get(), STDIN_FILENO);
+    }
+    if (options.pipe_stdout)
+    {
+      impl::make_pipe(result.stdout_, child_stdout, true);
+      actions.add_dup2(child_stdout.get(), STDOUT_FILENO);
+    }
+    if (options.pipe_stderr)
+    {
+      impl::make_pipe(result.stderr_, child_stderr, true);
+      actions.add_dup2(child_stderr.get(), STDERR_FILENO);
+    }
+
+    // e.g. async_wait_signal blocks signals in the parent
+    impl::spawn_attr attr;
+    sigset_t no_signals;
+    sigemptyset(&no_signals);
+    sigset_t all_signals;
+    sigfillset(&all_signals);
+    static_cast<void>(::posix_spawnattr_setsigmask(&attr.attr, &no_signals));
+    static_cast<void>(::posix_spawnattr_setsigdefault(&attr.attr, &all_signals));
+    static_cast<void>(::posix_spawnattr_setflags(
+      &attr.attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF));
+
+    pid_t pid = -1;
+    int error = ::posix_spawnp(&pid, argv[0], &actions.actions, &attr.attr, argv.data(), environ);
+    if (0 != error)
+    {
+      throw std::system_error(error, std::generic_category(), "posix_spawnp");
+    }
+
+    result.pidfd_.reset(impl::pidfd_open(pid));
+    if (!result.pidfd_.is_valid())
+    {
+      int pidfd_error = errno;
+      static_cast<void>(::kill(pid, SIGKILL));
+      static_cast<void>(::waitpid(pid, nullptr, 0));
+      throw std::system_error(pidfd_error, std::generic_category(), "pidfd_open");
+    }
+    result.pid_ = pid;
+
+    return result;
+  }
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "abi.h"
+
 #include <cassert>
 #include <concepts>
 #include <exception>
@@ -7,7 +9,7 @@
 #include <utility>
 #include <variant>
 
-namespace coro_st
+namespace CORO_ST_NAMESPACE
 {
   template<typename T>
   class promise_base
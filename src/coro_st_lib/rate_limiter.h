@@ -0,0 +1,331 @@
+#pragma once
+
+#include "abi.h"
+#include "callback.h"
+#include "context.h"
+#include "event_loop_context.h"
+#include "stop_util.h"
+#include "timer_heap.h"
+
+#include "../cpp_util_lib/intrusive_list.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <optional>
+#include <utility>
+
+namespace CORO_ST_NAMESPACE
+{
+  // Token bucket: holds up to burst tokens, one more is added every
+  // token_interval. Starts full.
+  class rate_limiter
+  {
+  public:
+    class [[nodiscard]] rate_limiter_acquire_task
+    {
+      friend class rate_limiter;
+
+      class [[nodiscard]] awaiter
+      {
+        friend class rate_limiter;
+
+        context& ctx_;
+        std::coroutine_handle<> parent_handle_;
+        rate_limiter& rl_;
+        size_t tokens_;
+        awaiter* next_waiting_{ nullptr };
+        awaiter* prev_waiting_{ nullptr };
+        std::optional<stop_callback<callback>> parent_stop_cb_;
+
+      public:
+        awaiter(context& ctx, rate_limiter& rl, size_t tokens) noexcept :
+          ctx_{ ctx },
+          parent_handle_{},
+          rl_{ rl },
+          tokens_{ tokens },
+          next_waiting_{ nullptr },
+          prev_waiting_{ nullptr },
+          parent_stop_cb_{ std::nullopt }
+        {
+        }
+
+        awaiter(const awaiter&) = delete;
+        awaiter& operator=(const awaiter&) = delete;
+
+        [[nodiscard]] constexpr bool await_ready() const noexcept
+        {
+          return false;
+        }
+
+        bool await_suspend(std::coroutine_handle<> handle) noexcept
+        {
+          parent_handle_ = handle;
+          if (ctx_.get_stop_token().stop_requested())
+          {
+            ctx_.invoke_stopped();
+            return true;
+          }
+          if (rl_.acquire(*this))
+          {
+            return false;
+          }
+          parent_stop_cb_.emplace(
+            ctx_.get_stop_token(),
+            make_member_callback<&awaiter::on_cancel>(this));
+          return true;
+        }
+
+        constexpr void await_resume() const noexcept
+        {
+        }
+
+        std::exception_ptr get_result_exception() const noexcept
+        {
+          return {};
+        }
+
+        void start() noexcept
+        {
+          if (ctx_.get_stop_token().stop_requested())
+          {
+            ctx_.invoke_stopped();
+            return;
+          }
+          if (rl_.acquire(*this))
+          {
+            ctx_.invoke_result_ready();
+            return;
+          }
+          parent_stop_cb_.emplace(
+            ctx_.get_stop_token(),
+            make_member_callback<&awaiter::on_cancel>(this));
+        }
+
+      private:
+        // Called after the rate_limiter already unlinked it from the wait list
+        void on_acquired() noexcept
+        {
+          parent_stop_cb_.reset();
+
+          if (parent_handle_)
+          {
+            ctx_.schedule_coroutine_resume(parent_handle_);
+            return;
+          }
+
+          ctx_.schedule_result_ready();
+        }
+
+        void on_cancel() noexcept
+        {
+          parent_stop_cb_.reset();
+          rl_.remove(*this);
+          ctx_.schedule_stopped();
+        }
+      };
+
+      struct [[nodiscard]] work
+      {
+        rate_limiter* rl_;
+        size_t tokens_;
+
+        work(rate_limiter& rl, size_t tokens) noexcept :
+          rl_{ &rl },
+          tokens_{ tokens }
+        {
+        }
+
+        work(const work&) = delete;
+        work& operator=(const work&) = delete;
+        work(work&&) noexcept = default;
+        work& operator=(work&&) noexcept = default;
+
+        [[nodiscard]] awaiter get_awaiter(context& ctx) noexcept
+        {
+          return {ctx, *rl_, tokens_};
+        }
+      };
+
+    private:
+      work work_;
+
+    public:
+      rate_limiter_acquire_task(rate_limiter& rl, size_t tokens) noexcept :
+        work_{ rl, tokens }
+      {
+      }
+
+      rate_limiter_acquire_task(const rate_limiter_acquire_task&) = delete;
+      rate_limiter_acquire_task& operator=(const rate_limiter_acquire_task&) = delete;
+
+      [[nodiscard]] work get_work() noexcept
+      {
+        return std::move(work_);
+      }
+    };
+
+  private:
+    using awaiter = rate_limiter_acquire_task::awaiter;
+
+    using wait_list = cpp_util::intrusive_list<
+      awaiter,
+      &awaiter::next_waiting_,
+      &awaiter::prev_waiting_>;
+
+    size_t burst_;
+    std::chrono::steady_clock::duration token_interval_;
+    size_t tokens_;
+    // the time tokens_ was accurate for, set on first use
+    std::optional<std::chrono::steady_clock::time_point> last_refill_;
+    wait_list wait_list_;
+    // one timer for when the first waiter will have enough tokens
+    timer_node timer_node_;
+    event_loop_context* timer_event_loop_ctx_{ nullptr };
+
+  public:
+    rate_limiter(size_t burst, std::chrono::steady_clock::duration token_interval) noexcept :
+      burst_{ burst },
+      token_interval_{ token_interval },
+      tokens_{ burst },
+      last_refill_{},
+      wait_list_{},
+      timer_node_{ std::chrono::steady_clock::time_point{} },
+      timer_event_loop_ctx_{ nullptr }
+    {
+      assert(burst_ > 0);
+      assert(token_interval_ > std::chrono::steady_clock::duration::zero());
+    }
+
+    rate_limiter(const rate_limiter&) = delete;
+    rate_limiter& operator=(const rate_limiter&) = delete;
+
+    ~rate_limiter()
+    {
+      assert(wait_list_.empty());
+      assert(nullptr == timer_event_loop_ctx_);
+    }
+
+    // Tokens left as of the last acquire or refill
+    size_t tokens() const noexcept
+    {
+      return tokens_;
+    }
+
+    // Completes when tokens are available, after the callers that were
+    // already waiting (FIFO). tokens can't be more than burst
+    [[nodiscard]] rate_limiter_acquire_task async_acquire(size_t tokens = 1) noexcept
+    {
+      assert(tokens <= burst_);
+      return rate_limiter_acquire_task{ *this, tokens };
+    }
+
+  private:
+    // Returns true if the tokens were taken and the caller continues
+    // immediately
+    bool acquire(awaiter& a) noexcept
+    {
+      event_loop_context& event_loop_ctx = a.ctx_.get_event_loop_context();
+      refill(event_loop_ctx.now());
+      if (wait_list_.empty() && (tokens_ >= a.tokens_))
+      {
+        tokens_ -= a.tokens_;
+        return true;
+      }
+
+      wait_list_.push_back(&a);
+      if (nullptr == timer_event_loop_ctx_)
+      {
+        arm_timer(event_loop_ctx);
+      }
+      return false;
+    }
+
+    void remove(awaiter& a) noexcept
+    {
+      bool was_first = (wait_list_.front() == &a);
+      wait_list_.remove(&a);
+      if (was_first)
+      {
+        // the next one might need fewer tokens
+        auto now = timer_event_loop_ctx_->now();
+        disarm_timer();
+        grant(now);
+      }
+    }
+
+    void refill(std::chrono::steady_clock::time_point now) noexcept
+    {
+      if (!last_refill_)
+      {
+        last_refill_ = now;
+        return;
+      }
+      if (now <= *last_refill_)
+      {
+        return;
+      }
+      auto count = static_cast<size_t>((now - *last_refill_) / token_interval_);
+      if (count >= burst_ - tokens_)
+      {
+        tokens_ = burst_;
+        last_refill_ = now;
+        return;
+      }
+      tokens_ += count;
+      *last_refill_ += token_interval_ * static_cast<std::chrono::steady_clock::rep>(count);
+    }
+
+    // Wakes up waiters in order while there are enough tokens, then arms
+    // the timer for the next one
+    void grant(std::chrono::steady_clock::time_point now) noexcept
+    {
+      refill(now);
+      while (awaiter* first = wait_list_.front())
+      {
+        if (tokens_ < first->tokens_)
+        {
+          arm_timer(first->ctx_.get_event_loop_context());
+          return;
+        }
+        tokens_ -= first->tokens_;
+        static_cast<void>(wait_list_.pop_front());
+        first->on_acquired();
+      }
+    }
+
+    void arm_timer(event_loop_context& event_loop_ctx) noexcept
+    {
+      assert(nullptr == timer_event_loop_ctx_);
+      assert(!wait_list_.empty());
+      assert(last_refill_.has_value());
+      size_t missing = wait_list_.front()->tokens_ - tokens_;
+      timer_event_loop_ctx_ = &event_loop_ctx;
+      timer_node_.deadline = *last_refill_ +
+        token_interval_ * static_cast<std::chrono::steady_clock::rep>(missing);
+      timer_node_.cb = make_member_callback<&rate_limiter::on_timer>(this);
+      timer_event_loop_ctx_->insert_timer_node(timer_node_);
+    }
+
+    void disarm_timer() noexcept
+    {
+      if (nullptr != timer_event_loop_ctx_)
+      {
+        timer_event_loop_ctx_->remove_timer_node(timer_node_);
+        timer_event_loop_ctx_ = nullptr;
+      }
+    }
+
+    void on_timer() noexcept
+    {
+      // already removed from the heap by the event loop
+      auto now = timer_event_loop_ctx_->now();
+      timer_event_loop_ctx_ = nullptr;
+      // at least the deadline passed, even if the loop time is behind
+      grant(std::max(now, timer_node_.deadline));
+    }
+  };
+}
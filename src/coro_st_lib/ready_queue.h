@@ -1,10 +1,15 @@
 #pragma once
 
+#include "abi.h"
+#include "../cpp_util_lib/intrusive_heap.h"
 #include "../cpp_util_lib/intrusive_queue.h"
 
 #include "callback.h"
 
-namespace coro_st
+#include <chrono>
+#include <cstdint>
+
+namespace CORO_ST_NAMESPACE
 {
   struct ready_node
   {
@@ -18,4 +23,58 @@ namespace coro_st
   };
 
   using ready_queue = cpp_util::intrusive_queue<ready_node, &ready_node::next>;
-}
\ No newline at end of file
+
+  // The deadline of work that has none: it goes in the FIFO ready queue
+  inline constexpr std::chrono::steady_clock::time_point no_deadline =
+    std::chrono::steady_clock::time_point::max();
+
+  // For the earliest deadline first ready_heap, only used for the chain
+  // node of a context if the loop hooks policy has deadline_scheduling
+  // (see loop_hooks_policy.h), the other ready nodes don't pay for it
+  struct deadline_ready_node : ready_node
+  {
+    deadline_ready_node* parent{};
+    deadline_ready_node* left{};
+    deadline_ready_node* right{};
+    std::chrono::steady_clock::time_point deadline{ no_deadline };
+    // push order, keeps nodes with the same deadline FIFO
+    std::uint64_t sequence{};
+  };
+
+  namespace impl
+  {
+    // A plain ready node has no deadline, setting one is ignored
+    inline std::chrono::steady_clock::time_point get_node_deadline(const ready_node&) noexcept
+    {
+      return no_deadline;
+    }
+
+    inline std::chrono::steady_clock::time_point get_node_deadline(const deadline_ready_node& node) noexcept
+    {
+      return node.deadline;
+    }
+
+    inline void set_node_deadline(ready_node&, std::chrono::steady_clock::time_point) noexcept
+    {
+    }
+
+    inline void set_node_deadline(deadline_ready_node& node, std::chrono::steady_clock::time_point deadline) noexcept
+    {
+      node.deadline = deadline;
+    }
+  }
+
+  struct compare_ready_node_by_deadline
+  {
+    bool operator()(const deadline_ready_node& left, const deadline_ready_node& right) noexcept
+    {
+      if (left.deadline != right.deadline)
+      {
+        return left.deadline < right.deadline;
+      }
+      return left.sequence < right.sequence;
+    }
+  };
+
+  using ready_heap = cpp_util::intrusive_heap<deadline_ready_node, &deadline_ready_node::parent, &deadline_ready_node::left, &deadline_ready_node::right, compare_ready_node_by_deadline>;
+}
@@ -1,18 +1,119 @@
 #pragma once
 
+#include "abi.h"
+#include "async_stack.h"
 #include "event_loop.h"
 #include "event_loop_context.h"
 #include "context.h"
 #include "coro_type_traits.h"
+#include "loop_clock.h"
+#include "spin_wait.h"
 #include "value_type_traits.h"
 
+#include <chrono>
+#include <cstdint>
 #include <optional>
-#include <thread>
 
-namespace coro_st
+namespace CORO_ST_NAMESPACE
 {
+  enum class idle_strategy
+  {
+    // sleep via the kernel until the next timer
+    sleep,
+    // busy poll the event loop, trading a core for wake up latency
+    spin,
+  };
+
+  struct run_options
+  {
+    // the clock the event loop caches once per iteration
+    // e.g. &tsc_clock_now
+    loop_clock::now_fn now_fn{ &steady_clock_now };
+
+    // use a virtual clock instead of now_fn: when idle the loop jumps to the
+    // next timer instead of sleeping e.g. to simulate hours of timeouts in
+    // seconds, or for tests that sleep
+    bool virtual_time{ false };
+
+    idle_strategy idle{ idle_strategy::sleep };
+    // spin: after polling idle for this long, back off to a real sleep
+    // until this long before the next timer
+    std::chrono::steady_clock::duration spin_idle_limit{ std::chrono::microseconds(200) };
+    // spin: maximum number of pauses between idle polls
+    std::uint32_t spin_max_pauses{ 64 };
+
+    // optional, for a stall_watchdog
+    loop_heartbeat* heartbeat{ nullptr };
+
+    // optional, to dump the stacks of suspended coroutines
+    async_stack_registry* async_stacks{ nullptr };
+
+    // optional, Linux only, for async_file_read/async_file_write
+    file_io_pool* file_io{ nullptr };
+  };
+
+  namespace impl
+  {
+    class run_idle
+    {
+      const run_options& options_;
+      event_loop& el_;
+      spin_backoff backoff_;
+      bool idle_{ false };
+      std::chrono::steady_clock::time_point idle_start_{};
+
+    public:
+      run_idle(const run_options& options, event_loop& el) noexcept :
+        options_{ options },
+        el_{ el },
+        backoff_{ options.spin_max_pauses },
+        idle_{ false },
+        idle_start_{}
+      {
+      }
+
+      run_idle(const run_idle&) = delete;
+      run_idle& operator=(const run_idle&) = delete;
+
+      void on_busy() noexcept
+      {
+        idle_ = false;
+        backoff_.reset();
+      }
+
+      void on_idle(
+        std::chrono::steady_clock::duration sleep_time,
+        std::chrono::steady_clock::time_point now)
+      {
+        if ((idle_strategy::sleep == options_.idle) || options_.virtual_time)
+        {
+          el_.idle_wait(sleep_time);
+          return;
+        }
+
+        if (!idle_)
+        {
+          idle_ = true;
+          idle_start_ = now;
+        }
+
+        // spin when the timer is close or we have not been idle for long
+        if (
+          (sleep_time <= options_.spin_idle_limit) ||
+          (now - idle_start_ < options_.spin_idle_limit))
+        {
+          backoff_.pause();
+          return;
+        }
+
+        el_.idle_wait(sleep_time - options_.spin_idle_limit);
+        on_busy();
+      }
+    };
+  }
+
   template<is_co_task CoTask>
-  auto run(CoTask co_task)
+  auto run(CoTask co_task, const run_options& options = {})
     -> std::optional<value_type_traits::value_type_t<co_task_result_t<CoTask>>>
   {
     stop_source main_stop_source;
@@ -23,9 +124,15 @@ namespace coro_st
     };
     completion_flags cf;
 
-    event_loop el;
+    event_loop el{ options.virtual_time ? nullptr : options.now_fn };
+    el.heartbeat_ = options.heartbeat;
 
-    event_loop_context el_ctx{ el.ready_queue_, el.timers_heap_ };
+    event_loop_context el_ctx{ el.ready_queue_, el.ready_heap_, el.timers_heap_, el.clock_ };
+    el_ctx.set_async_stacks(options.async_stacks);
+#if defined(__linux__)
+    el_ctx.set_io_poller(&el.poller_);
+    el_ctx.set_file_io_pool(options.file_io);
+#endif
     context ctx{
       el_ctx,
       main_stop_source.get_token(),
@@ -44,12 +151,18 @@ namespace coro_st
 
     co_awaiter.start();
 
+    impl::run_idle idle{ options, el };
+
     while (!cf.done)
     {
       auto sleep_time = el.do_current_pending_work();
       if (sleep_time.has_value())
       {
-        std::this_thread::sleep_for(*sleep_time);
+        idle.on_idle(*sleep_time, el.clock_.now());
+      }
+      else
+      {
+        idle.on_busy();
       }
     }
 
@@ -0,0 +1,466 @@
+#pragma once
+
+#include "abi.h"
+#include "callback.h"
+#include "context.h"
+#include "coro_type_traits.h"
+#include "stop_util.h"
+#include "value_type_traits.h"
+
+#include "../cpp_util_lib/intrusive_list.h"
+
+#include <cassert>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+namespace CORO_ST_NAMESPACE
+{
+  template<typename Key, typename T>
+  class singleflight
+  {
+    using ValueType = value_type_traits::value_type_t<T>;
+
+    struct flight_base;
+
+    class [[nodiscard]] awaiter
+    {
+      friend class singleflight;
+      friend struct flight_base;
+
+      context& ctx_;
+      std::coroutine_handle<> parent_handle_;
+      flight_base& flight_;
+      awaiter* next_waiting_{ nullptr };
+      awaiter* prev_waiting_{ nullptr };
+      std::optional<stop_callback<callback>> parent_stop_cb_;
+
+    public:
+      awaiter(context& ctx, flight_base& flight) noexcept :
+        ctx_{ ctx },
+        parent_handle_{},
+        flight_{ flight },
+        next_waiting_{ nullptr },
+        prev_waiting_{ nullptr },
+        parent_stop_cb_{ std::nullopt }
+      {
+        flight_.add_ref();
+      }
+
+      awaiter(const awaiter&) = delete;
+      awaiter& operator=(const awaiter&) = delete;
+
+      ~awaiter()
+      {
+        flight_.release();
+      }
+
+      [[nodiscard]] constexpr bool await_ready() const noexcept
+      {
+        return false;
+      }
+
+      bool await_suspend(std::coroutine_handle<> handle) noexcept
+      {
+        parent_handle_ = handle;
+        if (ctx_.get_stop_token().stop_requested())
+        {
+          ctx_.invoke_stopped();
+          return true;
+        }
+        start_flight_if_needed();
+        if (flight_base::flight_state::done == flight_.state_)
+        {
+          if (flight_.is_stopped())
+          {
+            ctx_.invoke_stopped();
+            return true;
+          }
+          return false;
+        }
+        enqueue_wait_node();
+        return true;
+      }
+
+      T await_resume() const
+      {
+        assert(flight_base::flight_state::done == flight_.state_);
+        if (std::holds_alternative<std::exception_ptr>(flight_.outcome_))
+        {
+          std::rethrow_exception(std::get<std::exception_ptr>(flight_.outcome_));
+        }
+        if constexpr (!std::is_same_v<void, T>)
+        {
+          // each caller gets a copy
+          return std::get<ValueType>(flight_.outcome_);
+        }
+      }
+
+      std::exception_ptr get_result_exception() const noexcept
+      {
+        if (std::holds_alternative<std::exception_ptr>(flight_.outcome_))
+        {
+          return std::get<std::exception_ptr>(flight_.outcome_);
+        }
+        return {};
+      }
+
+      void start() noexcept
+      {
+        if (ctx_.get_stop_token().stop_requested())
+        {
+          ctx_.invoke_stopped();
+          return;
+        }
+        start_flight_if_needed();
+        if (flight_base::flight_state::done == flight_.state_)
+        {
+          if (flight_.is_stopped())
+          {
+            ctx_.invoke_stopped();
+            return;
+          }
+          ctx_.invoke_result_ready();
+          return;
+        }
+        enqueue_wait_node();
+      }
+
+    private:
+      // The work might complete immediately
+      void start_flight_if_needed() noexcept
+      {
+        if (flight_base::flight_state::not_started == flight_.state_)
+        {
+          flight_.start();
+        }
+      }
+
+      void enqueue_wait_node() noexcept
+      {
+        ++flight_.interest_;
+        flight_.wait_list_.push_back(this);
+        parent_stop_cb_.emplace(
+          ctx_.get_stop_token(),
+          make_member_callback<&awaiter::on_cancel>(this));
+      }
+
+      // Called after the flight already unlinked it from the wait list
+      void on_flight_done() noexcept
+      {
+        parent_stop_cb_.reset();
+
+        if (flight_.is_stopped())
+        {
+          ctx_.schedule_stopped();
+          return;
+        }
+
+        if (parent_handle_)
+        {
+          ctx_.schedule_coroutine_resume(parent_handle_);
+          return;
+        }
+
+        ctx_.schedule_result_ready();
+      }
+
+      void on_cancel() noexcept
+      {
+        parent_stop_cb_.reset();
+        flight_.wait_list_.remove(this);
+        assert(flight_.interest_ > 0);
+        --flight_.interest_;
+        if (0 == flight_.interest_)
+        {
+          flight_.abandon();
+        }
+        ctx_.schedule_stopped();
+      }
+    };
+
+    // Shared by all the callers for the same key. Reference counted:
+    // one reference for each awaiter and one while the work runs.
+    // Type erased without virtual functions: a callback to start the work
+    // and a function to delete the derived flight
+    struct flight_base
+    {
+      using delete_fn = void (*)(flight_base* x) noexcept;
+
+      using wait_list = cpp_util::intrusive_list<
+        awaiter,
+        &awaiter::next_waiting_,
+        &awaiter::prev_waiting_>;
+
+      enum class flight_state
+      {
+        not_started,
+        running,
+        done,
+      };
+
+      singleflight& owner_;
+      callback start_work_cb_{};
+      delete_fn delete_fn_{ nullptr };
+      typename std::map<Key, flight_base*>::iterator map_it_{};
+      bool in_map_{ false };
+      size_t refs_{ 0 };
+      size_t interest_{ 0 };
+      flight_state state_{ flight_state::not_started };
+      // monostate means stopped
+      std::variant<std::monostate, ValueType, std::exception_ptr> outcome_{};
+      stop_source work_stop_source_{};
+      wait_list wait_list_{};
+
+      flight_base(singleflight& owner, delete_fn fn) noexcept :
+        owner_{ owner },
+        delete_fn_{ fn }
+      {
+        assert(nullptr != delete_fn_);
+      }
+
+      flight_base(const flight_base&) = delete;
+      flight_base& operator=(const flight_base&) = delete;
+
+      ~flight_base()
+      {
+        assert(wait_list_.empty());
+      }
+
+      void add_ref() noexcept
+      {
+        ++refs_;
+      }
+
+      void release() noexcept
+      {
+        assert(refs_ > 0);
+        --refs_;
+        if (0 != refs_)
+        {
+          return;
+        }
+        remove_from_map();
+        delete_fn_(this);
+      }
+
+      void remove_from_map() noexcept
+      {
+        if (in_map_)
+        {
+          owner_.flights_.erase(map_it_);
+          in_map_ = false;
+        }
+      }
+
+      void start() noexcept
+      {
+        assert(flight_state::not_started == state_);
+        state_ = flight_state::running;
+        add_ref();
+        start_work_cb_.invoke();
+      }
+
+      // The last interested waiter left: stop the work, later
+      // callers for the same key start a new flight
+      void abandon() noexcept
+      {
+        remove_from_map();
+        work_stop_source_.request_stop();
+      }
+
+      void on_done() noexcept
+      {
+        state_ = flight_state::done;
+        remove_from_map();
+
+        wait_list local_wait_list = std::move(wait_list_);
+        while (true)
+        {
+          auto* waiting = local_wait_list.pop_front();
+          if (waiting == nullptr)
+          {
+            break;
+          }
+          waiting->on_flight_done();
+        }
+        interest_ = 0;
+
+        // release the reference held by the running work
+        release();
+      }
+
+      bool is_stopped() const noexcept
+      {
+        return std::holds_alternative<std::monostate>(outcome_);
+      }
+    };
+
+    template<typename Fn>
+    struct flight : flight_base
+    {
+      using CoTask = std::invoke_result_t<Fn&>;
+      using CoAwaiter = co_task_awaiter_t<CoTask>;
+
+      Fn fn_;
+      context ctx_;
+      CoAwaiter co_awaiter_;
+
+      flight(singleflight& owner, context& parent_ctx, Fn& fn) :
+        flight_base{ owner, &flight::delete_flight },
+        fn_{ std::move(fn) },
+        // Shared by the callers and outliving the first one, so it does not
+        // inherit what its context points to e.g. the task account (nor
+        // its deadline)
+        ctx_{
+          parent_ctx.get_event_loop_context(),
+          this->work_stop_source_.get_token(),
+          make_member_completion<
+            &flight::on_result_ready,
+            &flight::on_stopped
+            >(this)
+        },
+        co_awaiter_{ std::invoke(fn_).get_work().get_awaiter(ctx_) }
+      {
+        this->start_work_cb_ = make_member_callback<&flight::start_work>(this);
+      }
+
+      static void delete_flight(flight_base* x) noexcept
+      {
+        delete static_cast<flight*>(x);
+      }
+
+      void start_work() noexcept
+      {
+        co_awaiter_.start();
+      }
+
+      void on_result_ready() noexcept
+      {
+        std::exception_ptr e = co_awaiter_.get_result_exception();
+        if (e)
+        {
+          this->outcome_.template emplace<std::exception_ptr>(e);
+        }
+        else
+        {
+          try
+          {
+            if constexpr (std::is_same_v<void, T>)
+            {
+              co_awaiter_.await_resume();
+              this->outcome_.template emplace<ValueType>();
+            }
+            else
+            {
+              this->outcome_.template emplace<ValueType>(co_awaiter_.await_resume());
+            }
+          }
+          catch(...)
+          {
+            this->outcome_.template emplace<std::exception_ptr>(std::current_exception());
+          }
+        }
+        this->on_done();
+      }
+
+      void on_stopped() noexcept
+      {
+        this->on_done();
+      }
+    };
+
+  public:
+    template<typename Fn>
+    class [[nodiscard]] singleflight_do_task
+    {
+      struct [[nodiscard]] work
+      {
+        singleflight* sf_;
+        Key key_;
+        Fn fn_;
+
+        work(singleflight& sf, Key&& key, Fn&& fn) noexcept :
+          sf_{ &sf },
+          key_{ std::move(key) },
+          fn_{ std::move(fn) }
+        {
+        }
+
+        work(const work&) = delete;
+        work& operator=(const work&) = delete;
+        work(work&&) noexcept = default;
+        work& operator=(work&&) noexcept = default;
+
+        [[nodiscard]] awaiter get_awaiter(context& ctx)
+        {
+          auto it = sf_->flights_.find(key_);
+          if (it != sf_->flights_.end())
+          {
+            return {ctx, *it->second};
+          }
+
+          auto new_flight = std::make_unique<flight<Fn>>(*sf_, ctx, fn_);
+          it = sf_->flights_.emplace(std::move(key_), new_flight.get()).first;
+          new_flight->map_it_ = it;
+          new_flight->in_map_ = true;
+          return {ctx, *new_flight.release()};
+        }
+      };
+
+    private:
+      work work_;
+
+    public:
+      singleflight_do_task(singleflight& sf, Key&& key, Fn&& fn) noexcept :
+        work_{ sf, std::move(key), std::move(fn) }
+      {
+      }
+
+      singleflight_do_task(const singleflight_do_task&) = delete;
+      singleflight_do_task& operator=(const singleflight_do_task&) = delete;
+
+      [[nodiscard]] work get_work() noexcept
+      {
+        return std::move(work_);
+      }
+    };
+
+  private:
+    std::map<Key, flight_base*> flights_;
+
+  public:
+    singleflight() noexcept = default;
+
+    singleflight(const singleflight&) = delete;
+    singleflight& operator=(const singleflight&) = delete;
+
+    ~singleflight()
+    {
+      assert(flights_.empty());
+    }
+
+    // Number of keys with work in flight
+    size_t size() const noexcept
+    {
+      return flights_.size();
+    }
+
+    // fn is only called if there is no work in flight for the key,
+    // it has to return a task with the result type T
+    template<typename Fn>
+    [[nodiscard]] singleflight_do_task<Fn> async_do(Key key, Fn fn) noexcept
+    {
+      static_assert(is_co_task<std::invoke_result_t<Fn&>>);
+      static_assert(std::is_same_v<T, co_task_result_t<std::invoke_result_t<Fn&>>>);
+      static_assert(std::is_nothrow_move_constructible_v<Key>);
+      return singleflight_do_task<Fn>{ *this, std::move(key), std::move(fn) };
+    }
+  };
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "abi.h"
 #include "callback.h"
 #include "context.h"
 #include "stop_util.h"
@@ -8,7 +9,7 @@
 #include <coroutine>
 #include <optional>
 
-namespace coro_st
+namespace CORO_ST_NAMESPACE
 {
   class [[nodiscard]] sleep_task
   {
@@ -72,7 +73,7 @@ namespace coro_st
 
         if (parent_handle_)
         {
-          parent_handle_.resume();
+          ctx_.resume_coroutine(parent_handle_);
           return;
         }
 
@@ -89,11 +90,16 @@ namespace coro_st
 
     class [[nodiscard]] work
     {
-      std::chrono::steady_clock::time_point deadline_;
+      std::chrono::steady_clock::duration sleep_duration_;
+      std::chrono::steady_clock::duration slack_;
 
     public:
-      work(std::chrono::steady_clock::time_point deadline) noexcept :
-        deadline_{ deadline }
+      work(
+        std::chrono::steady_clock::duration sleep_duration,
+        std::chrono::steady_clock::duration slack
+      ) noexcept :
+        sleep_duration_{ sleep_duration },
+        slack_{ slack }
       {
       }
 
@@ -102,9 +108,10 @@ namespace coro_st
       work(work&&) noexcept = default;
       work& operator=(work&&) noexcept = default;
 
+      // The deadline uses the time cached by the event loop
       [[nodiscard]] awaiter get_awaiter(context& ctx) noexcept
       {
-        return {ctx, deadline_};
+        return {ctx, coalesce_deadline(ctx.now() + sleep_duration_, slack_)};
       }
     };
 
@@ -112,8 +119,11 @@ namespace coro_st
     work work_;
 
   public:
-    sleep_task(std::chrono::steady_clock::time_point deadline) noexcept :
-      work_{ deadline }
+    sleep_task(
+      std::chrono::steady_clock::duration sleep_duration,
+      std::chrono::steady_clock::duration slack
+    ) noexcept :
+      work_{ sleep_duration, slack }
     {
     }
 
@@ -128,6 +138,15 @@ namespace coro_st
 
   [[nodiscard]] inline sleep_task async_sleep_for(std::chrono::steady_clock::duration sleep_duration) noexcept
   {
-    return {std::chrono::steady_clock::now() + sleep_duration};
+    return {sleep_duration, std::chrono::steady_clock::duration::zero()};
+  }
+
+  // Sleeps at least sleep_duration, but up to slack longer
+  // to share the wake of the event loop with other timers
+  [[nodiscard]] inline sleep_task async_sleep_for(
+    std::chrono::steady_clock::duration sleep_duration,
+    std::chrono::steady_clock::duration slack) noexcept
+  {
+    return {sleep_duration, slack};
   }
 }
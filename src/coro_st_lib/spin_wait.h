@@ -0,0 +1,61 @@
+#pragma once
+
+#include "abi.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+namespace CORO_ST_NAMESPACE
+{
+  // Hint to the CPU that we're in a spin loop: on x86 `pause` reduces
+  // power and the penalty when leaving the loop, and gives the other
+  // hyper-thread on the core a chance to run
+  inline void cpu_relax() noexcept
+  {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+  }
+
+  // Exponential backoff for a busy poll: each idle poll doubles the
+  // number of pauses up to a maximum, reset when work was found
+  class spin_backoff
+  {
+    std::uint32_t count_{ 1 };
+    std::uint32_t max_count_;
+
+  public:
+    explicit spin_backoff(std::uint32_t max_count = 64) noexcept :
+      count_{ 1 },
+      max_count_{ std::max<std::uint32_t>(max_count, 1) }
+    {
+    }
+
+    void pause() noexcept
+    {
+      for (std::uint32_t i = 0; i < count_; ++i)
+      {
+        cpu_relax();
+      }
+      count_ = std::min(count_ * 2, max_count_);
+    }
+
+    void reset() noexcept
+    {
+      count_ = 1;
+    }
+
+    std::uint32_t count() const noexcept
+    {
+      return count_;
+    }
+  };
+}
@@ -0,0 +1,187 @@
+#pragma once
+
+#include "abi.h"
+#include "callback.h"
+#include "thread_signals.h"
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <stop_token>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace CORO_ST_NAMESPACE
+{
+  // Written by the event loop thread around each callback it invokes,
+  // read by the watchdog thread.
+  //
+  // The loop side only does relaxed stores and a release store: it does not
+  // read the clock, the watchdog measures the time
+  class loop_heartbeat
+  {
+    // odd while a callback runs
+    std::atomic<std::uint64_t> sequence_{ 0 };
+    std::atomic<callback::pure_callback_fn> fn_{ nullptr };
+    std::atomic<void*> x_{ nullptr };
+    std::uint64_t loop_sequence_{ 0 };
+
+  public:
+    struct snapshot
+    {
+      std::uint64_t sequence{ 0 };
+      callback::pure_callback_fn fn{ nullptr };
+      void* x{ nullptr };
+
+      bool is_running() const noexcept
+      {
+        return 1 == (sequence % 2);
+      }
+    };
+
+    loop_heartbeat() noexcept = default;
+
+    loop_heartbeat(const loop_heartbeat&) = delete;
+    loop_heartbeat& operator=(const loop_heartbeat&) = delete;
+
+    // Event loop thread
+    void begin(callback cb) noexcept
+    {
+      assert(0 == (loop_sequence_ % 2));
+      fn_.store(cb.get_fn(), std::memory_order_relaxed);
+      x_.store(cb.get_x(), std::memory_order_relaxed);
+      sequence_.store(++loop_sequence_, std::memory_order_release);
+    }
+
+    // Event loop thread
+    void end() noexcept
+    {
+      assert(1 == (loop_sequence_ % 2));
+      sequence_.store(++loop_sequence_, std::memory_order_release);
+    }
+
+    // Any thread
+    snapshot read() const noexcept
+    {
+      while (true)
+      {
+        snapshot result;
+        result.sequence = sequence_.load(std::memory_order_acquire);
+        result.fn = fn_.load(std::memory_order_relaxed);
+        result.x = x_.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (result.sequence == sequence_.load(std::memory_order_relaxed))
+        {
+          return result;
+        }
+      }
+    }
+  };
+
+  struct stall_report
+  {
+    // the function and object of the callback that blocked the loop,
+    // e.g. for a resumed coroutine x is the coroutine frame address
+    callback::pure_callback_fn fn{ nullptr };
+    void* x{ nullptr };
+    // how long the callback was observed running: a lower bound, within
+    // the poll interval
+    std::chrono::steady_clock::duration duration{};
+    // false when first detected, then true when the callback returned
+    bool finished{ false };
+  };
+
+  // Thread that polls a loop_heartbeat and calls report_fn (on the watchdog
+  // thread) when a single callback runs for longer than the threshold: once
+  // when detected and once more when the callback returns
+  template<typename ReportFn>
+  class stall_watchdog
+  {
+    static_assert(std::is_nothrow_invocable_v<ReportFn&, const stall_report&>);
+
+    const loop_heartbeat& heartbeat_;
+    std::chrono::steady_clock::duration threshold_;
+    std::chrono::steady_clock::duration poll_interval_;
+    ReportFn report_fn_;
+    std::jthread thread_;
+
+  public:
+    stall_watchdog(
+      const loop_heartbeat& heartbeat,
+      std::chrono::steady_clock::duration threshold,
+      ReportFn report_fn
+    ) :
+      stall_watchdog(heartbeat, threshold, threshold / 10, std::move(report_fn))
+    {
+    }
+
+    stall_watchdog(
+      const loop_heartbeat& heartbeat,
+      std::chrono::steady_clock::duration threshold,
+      std::chrono::steady_clock::duration poll_interval,
+      ReportFn report_fn
+    ) :
+      heartbeat_{ heartbeat },
+      threshold_{ threshold },
+      poll_interval_{ poll_interval },
+      report_fn_(std::move(report_fn)),
+      thread_{}
+    {
+      assert(poll_interval_ > std::chrono::steady_clock::duration::zero());
+      impl::all_signals_blocked blocked;
+      thread_ = std::jthread([this](std::stop_token token) {
+        watch(token);
+      });
+    }
+
+    stall_watchdog(const stall_watchdog&) = delete;
+    stall_watchdog& operator=(const stall_watchdog&) = delete;
+
+    // The destructor of the jthread stops and joins
+
+  private:
+    void watch(std::stop_token token) noexcept
+    {
+      loop_heartbeat::snapshot last{};
+      auto first_seen = std::chrono::steady_clock::now();
+      bool reported{ false };
+      stall_report report{};
+
+      while (!token.stop_requested())
+      {
+        std::this_thread::sleep_for(poll_interval_);
+
+        auto crt = heartbeat_.read();
+        auto now = std::chrono::steady_clock::now();
+
+        if (crt.sequence == last.sequence)
+        {
+          if (crt.is_running() && !reported && (now - first_seen >= threshold_))
+          {
+            report.fn = crt.fn;
+            report.x = crt.x;
+            report.duration = now - first_seen;
+            report.finished = false;
+            report_fn_(std::as_const(report));
+            reported = true;
+          }
+          continue;
+        }
+
+        if (reported)
+        {
+          // the stalled callback returned
+          report.duration = now - first_seen;
+          report.finished = true;
+          report_fn_(std::as_const(report));
+          reported = false;
+        }
+
+        last = crt;
+        first_seen = now;
+      }
+    }
+  };
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "abi.h"
 #include "callback.h"
 
 #include "../cpp_util_lib/intrusive_list.h"
@@ -7,7 +8,7 @@
 #include <cassert>
 #include <utility>
 
-namespace coro_st
+namespace CORO_ST_NAMESPACE
 {
   struct stop_list_node
   {
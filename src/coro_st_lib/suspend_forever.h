@@ -1,5 +1,6 @@
 #pragma once
 
+#include "abi.h"
 #include "callback.h"
 #include "context.h"
 #include "stop_util.h"
@@ -8,7 +9,7 @@
 #include <optional>
 #include <utility>
 
-namespace coro_st
+namespace CORO_ST_NAMESPACE
 {
   class [[nodiscard]] suspend_forever_task
   {
@@ -1,10 +1,12 @@
 #pragma once
 
+#include "abi.h"
+
 #include <cassert>
 #include <coroutine>
 #include <utility>
 
-namespace coro_st
+namespace CORO_ST_NAMESPACE
 {
   struct coroutine_frame_abi
   {
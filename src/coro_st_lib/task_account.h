@@ -0,0 +1,152 @@
+#pragma once
+
+#include "abi.h"
+#include "loop_clock.h"
+#include "loop_hooks_policy.h"
+
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+
+namespace CORO_ST_NAMESPACE
+{
+  // Cost of a task e.g. a request, opt-in via the task_account_hooks loop
+  // hooks policy and async_with_account.
+  // Readable while the task runs, the time of a coroutine that is running
+  // is added when it suspends
+  struct task_account
+  {
+    // time spent running the coroutines of the task
+    std::chrono::steady_clock::duration run_time{};
+    // times the coroutines of the task were resumed, including their start
+    size_t resumes{ 0 };
+    // heap allocations while the task was running e.g. coroutine frames
+    size_t allocations{ 0 };
+    size_t allocated_bytes{ 0 };
+  };
+
+  namespace impl
+  {
+    // The account charged for the code running on this thread
+    struct task_account_state
+    {
+      task_account* current{ nullptr };
+      std::chrono::steady_clock::time_point since{};
+
+      void switch_to(task_account* account, std::chrono::steady_clock::time_point now) noexcept
+      {
+        if (nullptr != current)
+        {
+          current->run_time += now - since;
+        }
+        current = account;
+        since = now;
+      }
+    };
+
+    inline thread_local task_account_state current_task_account{};
+
+    inline void account_allocation(size_t bytes) noexcept
+    {
+      task_account* account = current_task_account.current;
+      if (nullptr != account)
+      {
+        ++account->allocations;
+        account->allocated_bytes += bytes;
+      }
+    }
+
+    // Per coroutine frame: the account and the one it interrupted
+    struct task_account_frame
+    {
+      task_account* account{ nullptr };
+      task_account* interrupted{ nullptr };
+      // the loop clock, read when switching accounts
+      const loop_clock* clock{ nullptr };
+      bool running{ false };
+
+      void on_resume() noexcept
+      {
+        if ((nullptr == account) || running)
+        {
+          return;
+        }
+        running = true;
+        ++account->resumes;
+        interrupted = current_task_account.current;
+        current_task_account.switch_to(account, clock->read());
+      }
+
+      void on_suspend() noexcept
+      {
+        if (!running)
+        {
+          return;
+        }
+        running = false;
+        current_task_account.switch_to(interrupted, clock->read());
+      }
+
+      // The awaiter did not suspend after all: back to the account without
+      // counting a resume or reading the clock, the time since the last
+      // switch is charged to it
+      void undo_suspend() noexcept
+      {
+        if ((nullptr == account) || running)
+        {
+          return;
+        }
+        running = true;
+        current_task_account.current = account;
+      }
+    };
+  }
+
+  // The loop hooks policy for task accounts (see loop_hooks.h), alone:
+  // -DCORO_ST_LOOP_HOOKS=task_account_hooks
+  // -DCORO_ST_LOOP_HOOKS_HEADER='"task_account.h"'
+  // or in a combine_loop_hooks
+  struct task_account_hooks : no_loop_hooks
+  {
+    using co_frame = impl::task_account_frame;
+
+    // Set by async_with_account, inherited by child contexts
+    struct context_data
+    {
+      task_account* account{ nullptr };
+    };
+
+    template<typename Context>
+    static void on_co_attach(
+      co_frame& frame,
+      Context& ctx,
+      std::coroutine_handle<>,
+      const std::coroutine_handle<>*) noexcept
+    {
+      frame.account = ctx.template get_hooks_data<task_account_hooks>().account;
+      frame.clock = &ctx.get_event_loop_context().get_clock();
+    }
+
+    static void on_co_suspend(co_frame& frame) noexcept
+    {
+      frame.on_suspend();
+    }
+
+    static void on_co_resume(co_frame& frame, bool suspended) noexcept
+    {
+      if (suspended)
+      {
+        frame.on_resume();
+      }
+      else
+      {
+        frame.undo_suspend();
+      }
+    }
+
+    static void on_allocation(size_t bytes) noexcept
+    {
+      impl::account_allocation(bytes);
+    }
+  };
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "abi.h"
 #include "context.h"
 #include "coro_type_traits.h"
 #include "stop_util.h"
@@ -10,7 +11,7 @@
 #include <type_traits>
 #include <variant>
 
-namespace coro_st
+namespace CORO_ST_NAMESPACE
 {
   template<is_co_task CoTask, typename Fn>
   struct [[nodiscard]] then_task
@@ -157,7 +158,7 @@ namespace coro_st
 
         if (parent_handle_)
         {
-          parent_handle_.resume();
+          parent_ctx_.resume_coroutine(parent_handle_);
           return;
         }
 
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "abi.h"
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <signal.h>
+#endif
+
+namespace CORO_ST_NAMESPACE
+{
+  namespace impl
+  {
+    // Blocks all signals for the calling thread while in scope, so that the
+    // threads created meanwhile inherit a full mask: a process directed signal
+    // e.g. SIGTERM, is then not delivered to a library thread where it would
+    // run the default action instead of waking async_wait_signal
+    class all_signals_blocked
+    {
+#if defined(__linux__)
+      sigset_t old_{};
+      bool restore_{ false };
+#endif
+
+    public:
+      all_signals_blocked() noexcept
+      {
+#if defined(__linux__)
+        sigset_t all;
+        sigfillset(&all);
+        restore_ = (0 == ::pthread_sigmask(SIG_SETMASK, &all, &old_));
+#endif
+      }
+
+      all_signals_blocked(const all_signals_blocked&) = delete;
+      all_signals_blocked& operator=(const all_signals_blocked&) = delete;
+
+      ~all_signals_blocked()
+      {
+#if defined(__linux__)
+        if (restore_)
+        {
+          ::pthread_sigmask(SIG_SETMASK, &old_, nullptr);
+        }
+#endif
+      }
+    };
+  }
+}
@@ -1,12 +1,13 @@
 #pragma once
 
+#include "abi.h"
 #include "../cpp_util_lib/intrusive_heap.h"
 
 #include "callback.h"
 
 #include <chrono>
 
-namespace coro_st
+namespace CORO_ST_NAMESPACE
 {
   struct timer_node
   {
@@ -34,4 +35,27 @@ namespace coro_st
   };
 
   using timer_heap = cpp_util::intrusive_heap<timer_node, &timer_node::parent, &timer_node::left, &timer_node::right, compare_timer_node_by_deadline>;
+
+  // Timer slack: rounds the deadline up to a multiple of the slack so that
+  // timers with close deadlines end up with the same deadline and fire in
+  // the same wake of the event loop
+  [[nodiscard]] inline std::chrono::steady_clock::time_point coalesce_deadline(
+    std::chrono::steady_clock::time_point deadline,
+    std::chrono::steady_clock::duration slack) noexcept
+  {
+    if (slack <= std::chrono::steady_clock::duration::zero())
+    {
+      return deadline;
+    }
+    auto remainder = deadline.time_since_epoch() % slack;
+    if (remainder < std::chrono::steady_clock::duration::zero())
+    {
+      remainder += slack;
+    }
+    if (remainder == std::chrono::steady_clock::duration::zero())
+    {
+      return deadline;
+    }
+    return deadline + (slack - remainder);
+  }
 }
\ No newline at end of file
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "abi.h"
+#include "child_slots.h"
+#include "context.h"
+#include "coro_type_traits.h"
+#include "value_type_traits.h"
+
+#include <cassert>
+#include <optional>
+#include <ranges>
+#include <type_traits>
+#include <vector>
+
+namespace CORO_ST_NAMESPACE
+{
+  template<std::ranges::forward_range Range, typename Fn>
+    requires std::ranges::sized_range<Range>
+  class [[nodiscard]] transform_task
+  {
+    using CoTask = std::invoke_result_t<Fn&, std::ranges::range_reference_t<Range>>;
+    static_assert(is_co_task<CoTask>);
+    using CoAwaiter = co_task_awaiter_t<CoTask>;
+    using ValueType = value_type_traits::value_type_t<
+      co_task_result_t<CoTask>>;
+    using ResultType = std::vector<ValueType>;
+
+    class [[nodiscard]] awaiter :
+      public impl::child_slots_awaiter<awaiter, Range, Fn>
+    {
+      using base = impl::child_slots_awaiter<awaiter, Range, Fn>;
+      friend base;
+
+      // results arrive in completion order, constructed in place
+      std::vector<std::optional<ValueType>> results_;
+
+    public:
+      awaiter(
+        context& parent_ctx,
+        Range& range,
+        size_t max_in_flight,
+        Fn& fn
+      ) :
+        base{ parent_ctx, range, max_in_flight, fn },
+        results_(base::item_count())
+      {
+        assert(max_in_flight > 0);
+      }
+
+      ResultType await_resume()
+      {
+        base::rethrow_if_exception();
+
+        ResultType results;
+        results.reserve(results_.size());
+        for (auto& result : results_)
+        {
+          assert(result.has_value());
+          results.push_back(std::move(*result));
+        }
+        return results;
+      }
+
+    private:
+      void on_child_result(size_t index, CoAwaiter& co_awaiter)
+      {
+        if constexpr (std::is_same_v<void, co_task_result_t<CoTask>>)
+        {
+          co_awaiter.await_resume();
+          results_[index].emplace();
+        }
+        else
+        {
+          results_[index].emplace(co_awaiter.await_resume());
+        }
+      }
+    };
+
+    struct [[nodiscard]] work
+    {
+      Range* range_;
+      size_t max_in_flight_;
+      Fn fn_;
+
+      work(Range& range, size_t max_in_flight, Fn&& fn) noexcept :
+        range_{ &range },
+        max_in_flight_{ max_in_flight },
+        fn_{ std::move(fn) }
+      {
+      }
+
+      work(const work&) = delete;
+      work& operator=(const work&) = delete;
+      work(work&&) noexcept = default;
+      work& operator=(work&&) noexcept = default;
+
+      [[nodiscard]] awaiter get_awaiter(context& ctx)
+      {
+        return {ctx, *range_, max_in_flight_, fn_};
+      }
+    };
+
+  private:
+    work work_;
+
+  public:
+    transform_task(Range& range, size_t max_in_flight, Fn&& fn) noexcept :
+      work_{ range, max_in_flight, std::move(fn) }
+    {
+    }
+
+    transform_task(const transform_task&) = delete;
+    transform_task& operator=(const transform_task&) = delete;
+
+    [[nodiscard]] work get_work() noexcept
+    {
+      return std::move(work_);
+    }
+  };
+
+  template<std::ranges::forward_range Range, typename Fn>
+    requires std::ranges::sized_range<Range>
+  [[nodiscard]] transform_task<Range, Fn>
+    async_transform(Range& range, size_t max_in_flight, Fn fn) noexcept
+  {
+    static_assert(std::is_nothrow_move_constructible_v<Fn>);
+    return transform_task<Range, Fn>{ range, max_in_flight, std::move(fn) };
+  }
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+// x86/x64 only, empty otherwise
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+
+#include "abi.h"
+
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+namespace CORO_ST_NAMESPACE
+{
+  namespace impl
+  {
+    struct tsc_calibration
+    {
+      std::uint64_t base_ticks{ 0 };
+      std::chrono::steady_clock::time_point base_time{};
+      double ns_per_tick{ 0.0 };
+    };
+  }
+
+  // Clock based on the CPU time stamp counter, cheaper to read than
+  // steady_clock::now() in some environments.
+  //
+  // x86/x64 only (hence not included from coro_st.h). Assumes an invariant
+  // TSC i.e. constant rate, synchronized across cores, as on modern CPUs.
+  //
+  // Call calibrate() once at startup, then use via
+  // `run(task, run_options{ .now_fn = &tsc_clock_now })`
+  class tsc_clock
+  {
+    static inline impl::tsc_calibration calibration_{};
+
+  public:
+    static std::uint64_t read_ticks() noexcept
+    {
+      return __rdtsc();
+    }
+
+    // Measures the TSC rate against steady_clock, blocks for the interval
+    static void calibrate(
+      std::chrono::steady_clock::duration interval = std::chrono::milliseconds(10))
+    {
+      auto start_time = std::chrono::steady_clock::now();
+      auto start_ticks = read_ticks();
+      std::this_thread::sleep_for(interval);
+      auto end_time = std::chrono::steady_clock::now();
+      auto end_ticks = read_ticks();
+
+      assert(end_ticks > start_ticks);
+      auto elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        end_time - start_time).count();
+
+      calibration_.base_ticks = end_ticks;
+      calibration_.base_time = end_time;
+      calibration_.ns_per_tick =
+        static_cast<double>(elapsed_ns) / static_cast<double>(end_ticks - start_ticks);
+    }
+
+    static bool is_calibrated() noexcept
+    {
+      return calibration_.ns_per_tick > 0.0;
+    }
+
+    static std::chrono::steady_clock::time_point now() noexcept
+    {
+      assert(is_calibrated());
+      // signed: the TSC of another core might read slightly behind the base,
+      // clamp to the base rather than wrap to a huge time
+      auto ticks = static_cast<std::int64_t>(read_ticks() - calibration_.base_ticks);
+      if (ticks < 0)
+      {
+        ticks = 0;
+      }
+      auto ns = std::chrono::nanoseconds{ static_cast<std::int64_t>(
+        static_cast<double>(ticks) * calibration_.ns_per_tick) };
+      return calibration_.base_time +
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(ns);
+    }
+  };
+
+  inline std::chrono::steady_clock::time_point tsc_clock_now() noexcept
+  {
+    return tsc_clock::now();
+  }
+}
+
+#endif
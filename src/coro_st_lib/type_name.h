@@ -0,0 +1,102 @@
+#pragma once
+
+#include "abi.h"
+
+#include <cstddef>
+#include <string_view>
+
+namespace CORO_ST_NAMESPACE
+{
+  namespace impl
+  {
+    // Readable type name without RTTI, from the compiler's
+    // pretty function name
+    template<typename T>
+    constexpr std::string_view raw_type_name() noexcept
+    {
+#if defined(_MSC_VER)
+      std::string_view name = __FUNCSIG__;
+      constexpr std::string_view prefix = "type_name<";
+      constexpr std::string_view suffix = ">(void) noexcept";
+      auto start = name.find(prefix);
+      auto end = name.rfind(suffix);
+      if ((std::string_view::npos == start) || (std::string_view::npos == end))
+      {
+        return name;
+      }
+      start += prefix.size();
+      return name.substr(start, end - start);
+#else
+      // g++:     "... type_name() [with T = X; std::string_view = ...]"
+      // clang++: "... type_name() [T = X]"
+      std::string_view name = __PRETTY_FUNCTION__;
+      constexpr std::string_view prefix = "T = ";
+      auto start = name.find(prefix);
+      if (std::string_view::npos == start)
+      {
+        return name;
+      }
+      start += prefix.size();
+      auto end = name.find_first_of(";]", start);
+      if (std::string_view::npos == end)
+      {
+        return name.substr(start);
+      }
+      return name.substr(start, end - start);
+#endif
+    }
+
+#if defined(CORO_ST_ABI_NAMESPACE)
+    inline constexpr std::string_view abi_namespace_prefix =
+      "coro_st::" CORO_ST_ABI_STRINGIFY(CORO_ST_ABI_NAMESPACE) "::";
+
+    template<size_t N>
+    struct type_name_chars
+    {
+      char data[N]{};
+      size_t size{ 0 };
+    };
+
+    // Without the inline namespace (see abi.h)
+    // e.g. "coro_st::sleep_task" rather than "coro_st::hooks_my_hooks::sleep_task"
+    template<typename T>
+    constexpr auto make_type_name_chars() noexcept
+    {
+      constexpr std::string_view name = raw_type_name<T>();
+      constexpr std::string_view ns = "coro_st::";
+      type_name_chars<name.size()> result;
+      for (size_t i = 0; i < name.size(); )
+      {
+        if (name.substr(i).starts_with(abi_namespace_prefix))
+        {
+          for (char c : ns)
+          {
+            result.data[result.size++] = c;
+          }
+          i += abi_namespace_prefix.size();
+        }
+        else
+        {
+          result.data[result.size++] = name[i++];
+        }
+      }
+      return result;
+    }
+
+    template<typename T>
+    inline constexpr auto type_name_chars_v = make_type_name_chars<T>();
+
+    template<typename T>
+    constexpr std::string_view type_name() noexcept
+    {
+      return { type_name_chars_v<T>.data, type_name_chars_v<T>.size };
+    }
+#else
+    template<typename T>
+    constexpr std::string_view type_name() noexcept
+    {
+      return raw_type_name<T>();
+    }
+#endif
+  }
+}
@@ -1,10 +1,11 @@
 #pragma once
 
+#include "abi.h"
 #include "../cpp_util_lib/unique_handle.h"
 
 #include <coroutine>
 
-namespace coro_st
+namespace CORO_ST_NAMESPACE
 {
   template<typename Promise>
   struct unique_coroutine_handle_traits : cpp_util::unique_handle_basic_access
@@ -1,6 +1,8 @@
 #pragma once
 
-namespace coro_st
+#include "abi.h"
+
+namespace CORO_ST_NAMESPACE
 {
   struct void_result
   {
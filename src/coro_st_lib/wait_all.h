@@ -1,5 +1,6 @@
 #pragma once
 
+#include "abi.h"
 #include "callback.h"
 #include "context.h"
 #include "coro_type_traits.h"
@@ -10,7 +11,7 @@
 #include <optional>
 #include <tuple>
 
-namespace coro_st
+namespace CORO_ST_NAMESPACE
 {
   namespace impl
   {
@@ -63,7 +64,7 @@ namespace coro_st
 
         if (parent_handle_)
         {
-          parent_handle_.resume();
+          parent_ctx_.resume_coroutine(parent_handle_);
           return;
         }
 
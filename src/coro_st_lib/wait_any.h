@@ -1,5 +1,6 @@
 #pragma once
 
+#include "abi.h"
 #include "callback.h"
 #include "context.h"
 #include "coro_type_traits.h"
@@ -12,7 +13,7 @@
 #include <type_traits>
 #include <variant>
 
-namespace coro_st
+namespace CORO_ST_NAMESPACE
 {
   template<typename T>
   struct wait_any_result
@@ -79,7 +80,7 @@ namespace coro_st
 
         if (parent_handle_)
         {
-          parent_handle_.resume();
+          parent_ctx_.resume_coroutine(parent_handle_);
           return;
         }
 
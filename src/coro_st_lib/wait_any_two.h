@@ -2,6 +2,7 @@
 
   // use wait_any, this largely serves learning purposes
 
+#include "abi.h"
 #include "callback.h"
 #include "context.h"
 #include "coro_type_traits.h"
@@ -11,7 +12,7 @@
 #include <coroutine>
 #include <type_traits>
 
-namespace coro_st
+namespace CORO_ST_NAMESPACE
 {
   template<is_co_task CoTask1, is_co_task CoTask2>
   class [[nodiscard]] wait_any_two_task
@@ -180,7 +181,7 @@ namespace coro_st
 
         if (parent_handle_)
         {
-          parent_handle_.resume();
+          parent_ctx_.resume_coroutine(parent_handle_);
           return;
         }
 
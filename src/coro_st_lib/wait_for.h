@@ -1,5 +1,6 @@
 #pragma once
 
+#include "abi.h"
 #include "callback.h"
 #include "context.h"
 #include "coro_type_traits.h"
@@ -11,7 +12,7 @@
 #include <coroutine>
 #include <optional>
 
-namespace coro_st
+namespace CORO_ST_NAMESPACE
 {
   template<is_co_task CoTask>
   class [[nodiscard]] wait_for_task
@@ -179,7 +180,7 @@ namespace coro_st
 
         if (parent_handle_)
         {
-          parent_handle_.resume();
+          parent_ctx_.resume_coroutine(parent_handle_);
           return;
         }
 
@@ -288,7 +289,7 @@ namespace coro_st
 
         if (parent_handle_)
         {
-          parent_handle_.resume();
+          parent_ctx_.resume_coroutine(parent_handle_);
           return;
         }
 
@@ -312,14 +313,17 @@ namespace coro_st
     struct [[nodiscard]] work
     {
       CoWork co_work_;
-      std::chrono::steady_clock::time_point deadline_;
+      std::chrono::steady_clock::duration sleep_duration_;
+      std::chrono::steady_clock::duration slack_;
 
       work(
         CoTask& co_task,
-        std::chrono::steady_clock::time_point deadline
+        std::chrono::steady_clock::duration sleep_duration,
+        std::chrono::steady_clock::duration slack
       ) noexcept:
         co_work_{ co_task.get_work() },
-        deadline_{ deadline }
+        sleep_duration_{ sleep_duration },
+        slack_{ slack }
       {
       }
 
@@ -328,9 +332,10 @@ namespace coro_st
       work(work&&) noexcept = default;
       work& operator=(work&&) noexcept = default;
 
+      // The deadline uses the time cached by the event loop
       [[nodiscard]] awaiter get_awaiter(context& ctx)
       {
-        return {ctx, co_work_, deadline_};
+        return {ctx, co_work_, coalesce_deadline(ctx.now() + sleep_duration_, slack_)};
       }
     };
 
@@ -340,9 +345,10 @@ namespace coro_st
   public:
     wait_for_task(
       CoTask& co_task,
-      std::chrono::steady_clock::time_point deadline
+      std::chrono::steady_clock::duration sleep_duration,
+      std::chrono::steady_clock::duration slack
     ) noexcept :
-      work_{ co_task, deadline }
+      work_{ co_task, sleep_duration, slack }
     {
     }
 
@@ -359,6 +365,18 @@ namespace coro_st
   [[nodiscard]] wait_for_task<CoTask>
     async_wait_for(CoTask co_task, std::chrono::steady_clock::duration sleep_duration)
   {
-    return wait_for_task<CoTask>{ co_task, std::chrono::steady_clock::now() + sleep_duration };
+    return wait_for_task<CoTask>{ co_task, sleep_duration, std::chrono::steady_clock::duration::zero() };
+  }
+
+  // The timeout fires at least after sleep_duration, but up to slack later
+  // e.g. for many connection timeouts that don't need to be precise
+  template<is_co_task CoTask>
+  [[nodiscard]] wait_for_task<CoTask>
+    async_wait_for(
+      CoTask co_task,
+      std::chrono::steady_clock::duration sleep_duration,
+      std::chrono::steady_clock::duration slack)
+  {
+    return wait_for_task<CoTask>{ co_task, sleep_duration, slack };
   }
 }
\ No newline at end of file
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "abi.h"
+#include "fd_io.h"
+#include "io_poller.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <optional>
+#include <system_error>
+
+#include <pthread.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <unistd.h>
+
+namespace CORO_ST_NAMESPACE
+{
+  namespace impl
+  {
+    struct wait_signal_op
+    {
+      using result_type = int;
+
+      fd_handle fd_;
+
+      int fd() const noexcept
+      {
+        return fd_.get();
+      }
+
+      std::uint32_t events() const noexcept
+      {
+        return EPOLLIN;
+      }
+
+      // The signal number
+      std::optional<int> try_op()
+      {
+        signalfd_siginfo info;
+        ssize_t count = ::read(fd_.get(), &info, sizeof(info));
+        if (count == static_cast<ssize_t>(sizeof(info)))
+        {
+          return static_cast<int>(info.ssi_signo);
+        }
+        if ((count < 0) && ((EAGAIN == errno) || (EINTR == errno)))
+        {
+          return std::nullopt;
+        }
+        throw std::system_error(errno, std::generic_category(), "read signalfd");
+      }
+    };
+
+    struct make_wait_signal_op
+    {
+      sigset_t signals_;
+
+      wait_signal_op operator()() const
+      {
+        // Otherwise the default action e.g. terminate, runs instead.
+        // Permanent: the mask is not restored when the wait ends, a signal
+        // delivered between two waits e.g. in a loop, is left pending for
+        // the next wait rather than running the default action
+        int error = ::pthread_sigmask(SIG_BLOCK, &signals_, nullptr);
+        if (0 != error)
+        {
+          throw std::system_error(error, std::generic_category(), "pthread_sigmask");
+        }
+
+        fd_handle fd{ ::signalfd(-1, &signals_, SFD_NONBLOCK | SFD_CLOEXEC) };
+        if (!fd.is_valid())
+        {
+          throw std::system_error(errno, std::generic_category(), "signalfd");
+        }
+        return wait_signal_op{ std::move(fd) };
+      }
+    };
+  }
+
+  using wait_signal_task = impl::fd_op_task<impl::make_wait_signal_op>;
+
+  [[nodiscard]] inline wait_signal_task async_wait_signal(const sigset_t& signals) noexcept
+  {
+    return wait_signal_task{ impl::make_wait_signal_op{ signals } };
+  }
+
+  [[nodiscard]] inline wait_signal_task async_wait_signal(int signal_number) noexcept
+  {
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, signal_number);
+    return wait_signal_task{ impl::make_wait_signal_op{ signals } };
+  }
+}
@@ -0,0 +1,250 @@
+#pragma once
+
+#include "abi.h"
+#include "context.h"
+
+#include "../cpp_util_lib/intrusive_list.h"
+
+#include <cassert>
+#include <coroutine>
+#include <optional>
+#include <utility>
+
+namespace CORO_ST_NAMESPACE
+{
+  template<typename T>
+  class watch
+  {
+  public:
+    class [[nodiscard]] watch_changed_task
+    {
+      friend class watch;
+
+      class [[nodiscard]] awaiter
+      {
+        friend class watch;
+
+        context& ctx_;
+        std::coroutine_handle<> parent_handle_;
+        watch& w_;
+        size_t last_seen_version_;
+        awaiter* next_waiting_{ nullptr };
+        awaiter* prev_waiting_{ nullptr };
+        std::optional<stop_callback<callback>> parent_stop_cb_;
+
+      public:
+        awaiter(context& ctx, watch& w, size_t last_seen_version) noexcept :
+          ctx_{ ctx },
+          parent_handle_{},
+          w_{ w },
+          last_seen_version_{ last_seen_version },
+          next_waiting_{ nullptr },
+          prev_waiting_{ nullptr },
+          parent_stop_cb_{ std::nullopt }
+        {
+        }
+
+        awaiter(const awaiter&) = delete;
+        awaiter& operator=(const awaiter&) = delete;
+
+        [[nodiscard]] constexpr bool await_ready() const noexcept
+        {
+          return false;
+        }
+
+        bool await_suspend(std::coroutine_handle<> handle) noexcept
+        {
+          parent_handle_ = handle;
+          if (last_seen_version_ != w_.version_)
+          {
+            if (ctx_.get_stop_token().stop_requested())
+            {
+              ctx_.invoke_stopped();
+              return true;
+            }
+            return false;
+          }
+          enqueue_wait_node();
+          return true;
+        }
+
+        // The value is read when the awaiter resumes, not when it was
+        // woken up: publications in between are skipped
+        const T& await_resume() const noexcept
+        {
+          return w_.value_;
+        }
+
+        std::exception_ptr get_result_exception() const noexcept
+        {
+          return {};
+        }
+
+        void start() noexcept
+        {
+          if (last_seen_version_ != w_.version_)
+          {
+            if (ctx_.get_stop_token().stop_requested())
+            {
+              ctx_.invoke_stopped();
+              return;
+            }
+            ctx_.invoke_result_ready();
+            return;
+          }
+          enqueue_wait_node();
+        }
+
+      private:
+        void enqueue_wait_node() noexcept
+        {
+          w_.wait_list_.push_back(this);
+          parent_stop_cb_.emplace(
+            ctx_.get_stop_token(),
+            make_member_callback<&awaiter::on_cancel>(this));
+        }
+
+        // Called after the watch already unlinked it from the wait list
+        void on_publish() noexcept
+        {
+          parent_stop_cb_.reset();
+
+          if (parent_handle_)
+          {
+            ctx_.schedule_coroutine_resume(parent_handle_);
+            return;
+          }
+
+          ctx_.schedule_result_ready();
+        }
+
+        void on_cancel() noexcept
+        {
+          parent_stop_cb_.reset();
+          w_.wait_list_.remove(this);
+          ctx_.schedule_stopped();
+        }
+      };
+
+      struct [[nodiscard]] work
+      {
+        watch* w_;
+        size_t last_seen_version_;
+
+        work(watch& w, size_t last_seen_version) noexcept :
+          w_{ &w },
+          last_seen_version_{ last_seen_version }
+        {
+        }
+
+        work(const work&) = delete;
+        work& operator=(const work&) = delete;
+        work(work&&) noexcept = default;
+        work& operator=(work&&) noexcept = default;
+
+        [[nodiscard]] awaiter get_awaiter(context& ctx) noexcept
+        {
+          return {ctx, *w_, last_seen_version_};
+        }
+      };
+
+    private:
+      work work_;
+
+    public:
+      watch_changed_task(watch& w, size_t last_seen_version) noexcept :
+        work_{ w, last_seen_version }
+      {
+      }
+
+      watch_changed_task(const watch_changed_task&) = delete;
+      watch_changed_task& operator=(const watch_changed_task&) = delete;
+
+      [[nodiscard]] work get_work() noexcept
+      {
+        return std::move(work_);
+      }
+    };
+
+  private:
+    using wait_list = cpp_util::intrusive_list<
+      typename watch_changed_task::awaiter,
+      &watch_changed_task::awaiter::next_waiting_,
+      &watch_changed_task::awaiter::prev_waiting_>;
+
+    T value_;
+    size_t version_{ 0 };
+    wait_list wait_list_;
+
+  public:
+    template<typename... Args>
+    explicit watch(Args&&... args) :
+      value_(std::forward<Args>(args)...),
+      version_{ 0 },
+      wait_list_{}
+    {
+    }
+
+    watch(const watch&) = delete;
+    watch& operator=(const watch&) = delete;
+
+    ~watch()
+    {
+      assert(wait_list_.empty());
+    }
+
+    const T& get() const noexcept
+    {
+      return value_;
+    }
+
+    size_t version() const noexcept
+    {
+      return version_;
+    }
+
+    // Returns the number of waiters scheduled to resume
+    template<typename U>
+    size_t publish(U&& value)
+    {
+      value_ = std::forward<U>(value);
+      return notify_published();
+    }
+
+    // Modify the value in place, e.g. to avoid a copy of a large value
+    template<typename Fn>
+    size_t modify(Fn&& fn)
+    {
+      std::forward<Fn>(fn)(value_);
+      return notify_published();
+    }
+
+    [[nodiscard]] watch_changed_task async_changed(size_t last_seen_version) noexcept
+    {
+      return watch_changed_task{*this, last_seen_version};
+    }
+
+  private:
+    size_t notify_published() noexcept
+    {
+      ++version_;
+
+      // take the whole list in one go, waiters that subscribe
+      // while we schedule (none in the single threaded case)
+      // would wait for the next publication
+      wait_list local_wait_list = std::move(wait_list_);
+      size_t count = 0;
+      while (true)
+      {
+        auto* waiting = local_wait_list.pop_front();
+        if (waiting == nullptr)
+        {
+          break;
+        }
+        waiting->on_publish();
+        ++count;
+      }
+      return count;
+    }
+  };
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include "abi.h"
+#include "fd_io.h"
+#include "io_poller.h"
+
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace CORO_ST_NAMESPACE
+{
+  struct path_event
+  {
+    // the watch descriptor returned by path_watcher::add,
+    // -1 for IN_Q_OVERFLOW when events were lost
+    int wd;
+    // e.g. IN_MODIFY, IN_IGNORED when the watch was removed
+    std::uint32_t mask;
+    // relates IN_MOVED_FROM to IN_MOVED_TO
+    std::uint32_t cookie;
+    // for a watched directory the name of the file in it, otherwise empty
+    std::string name;
+  };
+
+  namespace impl
+  {
+    inline fd_handle make_inotify_fd()
+    {
+      fd_handle fd{ ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC) };
+      if (!fd.is_valid())
+      {
+        throw std::system_error(errno, std::generic_category(), "inotify_init1");
+      }
+      return fd;
+    }
+
+    inline int add_inotify_watch(int fd, const std::string& path, std::uint32_t mask)
+    {
+      int wd = ::inotify_add_watch(fd, path.c_str(), mask);
+      if (wd < 0)
+      {
+        throw std::system_error(errno, std::generic_category(), "inotify_add_watch " + path);
+      }
+      return wd;
+    }
+
+    // All the events queued (that fit in a read), nullopt if none
+    inline std::optional<std::vector<path_event>> read_path_events(int fd)
+    {
+      alignas(inotify_event) char buffer[16 * (sizeof(inotify_event) + NAME_MAX + 1)];
+      ssize_t count;
+      while (true)
+      {
+        count = ::read(fd, buffer, sizeof(buffer));
+        if (count > 0)
+        {
+          break;
+        }
+        if ((count < 0) && (EINTR == errno))
+        {
+          continue;
+        }
+        if ((count < 0) && ((EAGAIN == errno) || (EWOULDBLOCK == errno)))
+        {
+          return std::nullopt;
+        }
+        if (0 == count)
+        {
+          // errno is not set for it
+          throw std::system_error(std::make_error_code(std::errc::io_error), "read inotify returned no data");
+        }
+        throw std::system_error(errno, std::generic_category(), "read inotify");
+      }
+
+      std::vector<path_event> events;
+      for (const char* p = buffer; p < buffer + count; )
+      {
+        const inotify_event* e = reinterpret_cast<const inotify_event*>(p);
+        events.push_back(path_event{
+          .wd = e->wd,
+          .mask = e->mask,
+          .cookie = e->cookie,
+          // the name is padded with '\0'
+          .name = (e->len > 0) ? std::string(e->name) : std::string{} });
+        p += sizeof(inotify_event) + e->len;
+      }
+      return events;
+    }
+
+    struct path_events_op
+    {
+      using result_type = std::vector<path_event>;
+
+      int fd_;
+
+      int fd() const noexcept
+      {
+        return fd_;
+      }
+
+      std::uint32_t events() const noexcept
+      {
+        return EPOLLIN;
+      }
+
+      std::optional<std::vector<path_event>> try_op()
+      {
+        return read_path_events(fd_);
+      }
+    };
+  }
+
+  using path_events_task = impl::fd_op_task<impl::make_op<impl::path_events_op>>;
+
+  // Watches many paths with one inotify fd, events that happen between
+  // calls to async_next are queued by the kernel (until IN_Q_OVERFLOW)
+  class path_watcher
+  {
+    fd_handle fd_;
+
+  public:
+    path_watcher() :
+      fd_{ impl::make_inotify_fd() }
+    {
+    }
+
+    int fd() const noexcept
+    {
+      return fd_.get();
+    }
+
+    // mask e.g. IN_MODIFY | IN_CLOSE_WRITE, returns the watch descriptor.
+    // Adding the same path again returns the same watch descriptor
+    int add(const std::string& path, std::uint32_t mask)
+    {
+      return impl::add_inotify_watch(fd_.get(), path, mask);
+    }
+
+    // An IN_IGNORED event follows
+    void remove(int wd) noexcept
+    {
+      static_cast<void>(::inotify_rm_watch(fd_.get(), wd));
+    }
+
+    // The next batch of events, at least one
+    [[nodiscard]] path_events_task async_next() noexcept
+    {
+      return path_events_task{ impl::make_op<impl::path_events_op>{ { fd_.get() } } };
+    }
+  };
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "abi.h"
+#include "context.h"
+#include "coro_type_traits.h"
+#include "task_account.h"
+#include "with_context.h"
+
+namespace CORO_ST_NAMESPACE
+{
+  namespace impl
+  {
+    struct set_task_account
+    {
+      task_account* account;
+
+      // A template, so it is only compiled if used
+      template<typename Context>
+      void operator()(const Context&, Context& task_ctx) const noexcept
+      {
+        task_ctx.template get_hooks_data<task_account_hooks>().account = account;
+      }
+    };
+
+    // Dependent on the task, so it is only checked if used
+    template<typename CoTask>
+    inline constexpr bool has_task_account_hooks_v = has_hooks_part<task_account_hooks>;
+  }
+
+  template<is_co_task CoTask>
+  using with_account_task = with_context_task<CoTask, impl::set_task_account>;
+
+  // Charges the coroutines of the task (including nested ones, unless
+  // they have their own account) to account: run time, resumes and
+  // allocations e.g. frames, for per request cost attribution.
+  // account has to outlive the task.
+  // Needs task_account_hooks in the loop hooks policy
+  template<is_co_task CoTask>
+  [[nodiscard]] with_account_task<CoTask>
+    async_with_account(CoTask co_task, task_account& account)
+  {
+    static_assert(
+      impl::has_task_account_hooks_v<CoTask>,
+      "async_with_account needs task_account_hooks in the loop hooks policy");
+    return with_account_task<CoTask>{ co_task, impl::set_task_account{ &account } };
+  }
+}
@@ -0,0 +1,209 @@
+#pragma once
+
+#include "abi.h"
+#include "callback.h"
+#include "context.h"
+#include "coro_type_traits.h"
+#include "stop_util.h"
+
+#include <cassert>
+#include <coroutine>
+#include <utility>
+
+namespace CORO_ST_NAMESPACE
+{
+  // Runs the task in a child context adjusted by
+  // `adjust(const context& parent_ctx, context& task_ctx)` before the task
+  // gets it e.g. with a deadline or a task account, see with_deadline.h
+  // and with_account.h
+  template<is_co_task CoTask, typename Adjust>
+  class [[nodiscard]] with_context_task
+  {
+    using CoWork = co_task_work_t<CoTask>;
+    using CoAwaiter = co_task_awaiter_t<CoTask>;
+    using T = co_task_result_t<CoTask>;
+
+    class [[nodiscard]] awaiter
+    {
+      enum class outcome_state
+      {
+        none,
+        has_result,
+        has_stopped,
+      };
+
+      context& parent_ctx_;
+      std::coroutine_handle<> parent_handle_;
+      bool pending_start_{ false };
+      outcome_state outcome_state_{ outcome_state::none };
+
+      context task_ctx_;
+      CoAwaiter co_awaiter_;
+
+    public:
+      awaiter(
+        context& parent_ctx,
+        CoWork& co_work,
+        const Adjust& adjust
+      ) :
+        parent_ctx_{ parent_ctx },
+        parent_handle_{},
+        pending_start_{ false },
+        outcome_state_{ outcome_state::none },
+        task_ctx_{
+          parent_ctx_,
+          parent_ctx_.get_stop_token(),
+          make_member_completion<
+            &awaiter::on_task_result_ready,
+            &awaiter::on_task_stopped
+            >(this)
+        },
+        co_awaiter_{ adjust_and_get_awaiter(co_work, adjust) }
+      {
+      }
+
+      awaiter(const awaiter&) = delete;
+      awaiter& operator=(const awaiter&) = delete;
+
+      [[nodiscard]] constexpr bool await_ready() const noexcept
+      {
+        return false;
+      }
+
+      bool await_suspend(std::coroutine_handle<> handle) noexcept
+      {
+        parent_handle_ = handle;
+
+        pending_start_ = true;
+        co_awaiter_.start();
+        pending_start_ = false;
+
+        if (outcome_state::none == outcome_state_)
+        {
+          return true;
+        }
+
+        if (outcome_state::has_stopped == outcome_state_)
+        {
+          parent_ctx_.invoke_stopped();
+          return true;
+        }
+
+        return false;
+      }
+
+      T await_resume()
+      {
+        assert(outcome_state::has_result == outcome_state_);
+        return co_awaiter_.await_resume();
+      }
+
+      std::exception_ptr get_result_exception() const noexcept
+      {
+        return co_awaiter_.get_result_exception();
+      }
+
+      void start() noexcept
+      {
+        pending_start_ = true;
+        co_awaiter_.start();
+        pending_start_ = false;
+
+        if (outcome_state::none == outcome_state_)
+        {
+          return;
+        }
+
+        if (outcome_state::has_stopped == outcome_state_)
+        {
+          parent_ctx_.invoke_stopped();
+          return;
+        }
+
+        parent_ctx_.invoke_result_ready();
+      }
+
+    private:
+      CoAwaiter adjust_and_get_awaiter(
+        CoWork& co_work,
+        const Adjust& adjust)
+      {
+        adjust(parent_ctx_, task_ctx_);
+        return co_work.get_awaiter(task_ctx_);
+      }
+
+      void on_shared_continue() noexcept
+      {
+        if (pending_start_)
+        {
+          return;
+        }
+
+        if (outcome_state::has_stopped == outcome_state_)
+        {
+          parent_ctx_.invoke_stopped();
+          return;
+        }
+
+        if (parent_handle_)
+        {
+          parent_ctx_.resume_coroutine(parent_handle_);
+          return;
+        }
+
+        parent_ctx_.invoke_result_ready();
+      }
+
+      void on_task_result_ready() noexcept
+      {
+        outcome_state_ = outcome_state::has_result;
+        on_shared_continue();
+      }
+
+      void on_task_stopped() noexcept
+      {
+        outcome_state_ = outcome_state::has_stopped;
+        on_shared_continue();
+      }
+    };
+
+    struct [[nodiscard]] work
+    {
+      CoWork co_work_;
+      Adjust adjust_;
+
+      work(CoTask& co_task, Adjust adjust) noexcept:
+        co_work_{ co_task.get_work() },
+        adjust_{ std::move(adjust) }
+      {
+      }
+
+      work(const work&) = delete;
+      work& operator=(const work&) = delete;
+      work(work&&) noexcept = default;
+      work& operator=(work&&) noexcept = default;
+
+      [[nodiscard]] awaiter get_awaiter(context& ctx)
+      {
+        return {ctx, co_work_, adjust_};
+      }
+    };
+
+  private:
+    work work_;
+
+  public:
+    with_context_task(CoTask& co_task, Adjust adjust) noexcept :
+      work_{ co_task, std::move(adjust) }
+    {
+    }
+
+    with_context_task(const with_context_task&) = delete;
+    with_context_task& operator=(const with_context_task&) = delete;
+
+    [[nodiscard]] work get_work() noexcept
+    {
+      return std::move(work_);
+    }
+  };
+}
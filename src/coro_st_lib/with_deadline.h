@@ -0,0 +1,64 @@
+#pragma once
+
+#include "abi.h"
+#include "context.h"
+#include "coro_type_traits.h"
+#include "with_context.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace CORO_ST_NAMESPACE
+{
+  namespace impl
+  {
+    struct set_deadline
+    {
+      std::chrono::steady_clock::duration duration;
+
+      // A child can't be less urgent than its parent
+      void operator()(const context& parent_ctx, context& task_ctx) const noexcept
+      {
+        task_ctx.set_deadline(std::min(
+          parent_ctx.get_deadline(),
+          saturated_deadline(parent_ctx.now())));
+      }
+
+      // now + duration overflows for a large duration e.g. duration::max(),
+      // that's no deadline
+      std::chrono::steady_clock::time_point saturated_deadline(
+        std::chrono::steady_clock::time_point now) const noexcept
+      {
+        if (duration >= no_deadline - now)
+        {
+          return no_deadline;
+        }
+        return now + duration;
+      }
+    };
+  }
+
+  namespace impl
+  {
+    // Dependent on the task, so it is only checked if used
+    template<typename CoTask>
+    inline constexpr bool has_deadline_scheduling_v = deadline_scheduling_v<loop_hooks>;
+  }
+
+  template<is_co_task CoTask>
+  using with_deadline_task = with_context_task<CoTask, impl::set_deadline>;
+
+  // Runs the task with a scheduling deadline of duration from the loop time,
+  // it does not stop the task at the deadline (see async_wait_for for that).
+  // Needs deadline_scheduling in the loop hooks policy
+  // e.g. deadline_scheduling_hooks
+  template<is_co_task CoTask>
+  [[nodiscard]] with_deadline_task<CoTask>
+    async_with_deadline(CoTask co_task, std::chrono::steady_clock::duration duration)
+  {
+    static_assert(
+      impl::has_deadline_scheduling_v<CoTask>,
+      "async_with_deadline needs deadline_scheduling in the loop hooks policy");
+    return with_deadline_task<CoTask>{ co_task, impl::set_deadline{ duration } };
+  }
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include "abi.h"
+#include "fd_io.h"
+#include "io_poller.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <system_error>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/sendfile.h>
+#include <sys/types.h>
+
+namespace CORO_ST_NAMESPACE
+{
+  namespace impl
+  {
+    // Bytes transferred before yielding to the event loop, so that other
+    // work runs and cancellation is checked between chunks
+    inline constexpr size_t zero_copy_chunk_size = 1024 * 1024;
+
+    struct sendfile_op
+    {
+      using result_type = size_t;
+
+      int out_fd_;
+      int in_fd_;
+      off_t offset_;
+      size_t remaining_;
+      size_t transferred_{ 0 };
+
+      int fd() const noexcept
+      {
+        return out_fd_;
+      }
+
+      std::uint32_t events() const noexcept
+      {
+        return EPOLLOUT;
+      }
+
+      std::optional<size_t> try_op()
+      {
+        size_t chunk_remaining = zero_copy_chunk_size;
+        while (remaining_ > 0)
+        {
+          if (0 == chunk_remaining)
+          {
+            return std::nullopt;
+          }
+          ssize_t count = ::sendfile(
+            out_fd_, in_fd_, &offset_, std::min(remaining_, chunk_remaining));
+          if (count > 0)
+          {
+            transferred_ += static_cast<size_t>(count);
+            remaining_ -= static_cast<size_t>(count);
+            chunk_remaining -= std::min(chunk_remaining, static_cast<size_t>(count));
+            continue;
+          }
+          if (0 == count)
+          {
+            // end of file
+            break;
+          }
+          if (EINTR == errno)
+          {
+            continue;
+          }
+          if ((EAGAIN == errno) || (EWOULDBLOCK == errno))
+          {
+            return std::nullopt;
+          }
+          throw std::system_error(errno, std::generic_category(), "sendfile");
+        }
+        return transferred_;
+      }
+    };
+
+    struct splice_op
+    {
+      using result_type = size_t;
+
+      int in_fd_;
+      int out_fd_;
+      size_t remaining_;
+      size_t transferred_{ 0 };
+      // which side the last attempt blocked on
+      bool wait_out_{ false };
+
+      int fd() const noexcept
+      {
+        return wait_out_ ? out_fd_ : in_fd_;
+      }
+
+      std::uint32_t events() const noexcept
+      {
+        return wait_out_ ? EPOLLOUT : EPOLLIN;
+      }
+
+      std::optional<size_t> try_op()
+      {
+        size_t chunk_remaining = zero_copy_chunk_size;
+        while (remaining_ > 0)
+        {
+          if (0 == chunk_remaining)
+          {
+            return std::nullopt;
+          }
+          ssize_t count = ::splice(
+            in_fd_, nullptr, out_fd_, nullptr,
+            std::min(remaining_, chunk_remaining),
+            SPLICE_F_NONBLOCK | SPLICE_F_MOVE);
+          if (count > 0)
+          {
+            transferred_ += static_cast<size_t>(count);
+            remaining_ -= static_cast<size_t>(count);
+            chunk_remaining -= std::min(chunk_remaining, static_cast<size_t>(count));
+            continue;
+          }
+          if (0 == count)
+          {
+            // end of file
+            break;
+          }
+          if (EINTR == errno)
+          {
+            continue;
+          }
+          if ((EAGAIN == errno) || (EWOULDBLOCK == errno))
+          {
+            wait_out_ = is_readable();
+            return std::nullopt;
+          }
+          throw std::system_error(errno, std::generic_category(), "splice");
+        }
+        return transferred_;
+      }
+
+    private:
+      // EAGAIN does not say which side would block, if the input has data
+      // (or an error/hang up to report) then it's the output
+      bool is_readable() const noexcept
+      {
+        pollfd p{ .fd = in_fd_, .events = POLLIN, .revents = 0 };
+        return (1 == ::poll(&p, 1, 0)) && (0 != p.revents);
+      }
+    };
+  }
+
+  using sendfile_task = impl::fd_op_task<impl::make_op<impl::sendfile_op>>;
+  using splice_task = impl::fd_op_task<impl::make_op<impl::splice_op>>;
+
+  // Copies count bytes from in_fd (a regular file) starting at offset, to a
+  // non-blocking out_fd e.g. a socket, without copying through user space.
+  // Does not change the file offset of in_fd.
+  // Returns the bytes transferred, less than count at end of file.
+  //
+  // Only waits for out_fd: reading in_fd from the page cache is not
+  // non-blocking, for a file not in the page cache (cold) sendfile blocks the
+  // event loop on disk I/O (up to a chunk at a time). For cold files read
+  // through the file_io_pool instead, e.g. async_file_read, or warm the
+  // page cache first
+  [[nodiscard]] inline sendfile_task async_sendfile(
+    fd_arg out_fd, fd_arg in_fd, off_t offset, size_t count) noexcept
+  {
+    return sendfile_task{ impl::make_op<impl::sendfile_op>{
+      { out_fd.h, in_fd.h, offset, count } } };
+  }
+
+  // Moves count bytes from in_fd to out_fd, at least one of them a pipe,
+  // without copying through user space. Both should be non-blocking.
+  // Returns the bytes transferred, less than count at end of file
+  [[nodiscard]] inline splice_task async_splice(
+    fd_arg in_fd, fd_arg out_fd, size_t count) noexcept
+  {
+    return splice_task{ impl::make_op<impl::splice_op>{
+      { in_fd.h, out_fd.h, count } } };
+  }
+}
@@ -0,0 +1,163 @@
+#include "../test_lib/test.h"
+
+#include "../coro_st_lib/async_stack.h"
+
+#include "../coro_st_lib/coro_st.h"
+
+#include "../coro_st_lib_test/test_loop.h"
+
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+  static_assert("int" == coro_st::impl::type_name<int>());
+  static_assert("coro_st::sleep_task" == coro_st::impl::type_name<coro_st::sleep_task>());
+  static_assert("coro_st::co<coro_st::void_result>" == coro_st::impl::type_name<coro_st::co<coro_st::void_result>>());
+
+  coro_st::co<int> async_inner()
+  {
+    co_await coro_st::async_sleep_for(std::chrono::hours(24));
+    co_return 42;
+  }
+
+  coro_st::co<int> async_outer()
+  {
+    int x = co_await async_inner();
+    co_return x;
+  }
+
+  coro_st::co<void> async_both()
+  {
+    co_await coro_st::async_wait_all(
+      async_inner(),
+      async_inner());
+  }
+
+  coro_st::co<size_t> async_count_frames(const coro_st::async_stack_registry& registry)
+  {
+    co_await coro_st::async_yield();
+    co_return registry.size();
+  }
+
+  TEST(async_stack_chain)
+  {
+    coro_st::async_stack_registry registry;
+    coro_st_test::test_loop tl;
+    tl.el_ctx.set_async_stacks(&registry);
+
+    auto task = async_outer();
+    auto awaiter = task.get_work().get_awaiter(tl.ctx);
+    ASSERT_EQ(1, registry.size());
+
+    awaiter.start();
+    ASSERT_EQ(2, registry.size());
+
+    std::vector<std::vector<std::string>> stacks;
+    registry.for_each_stack([&](std::span<const coro_st::async_frame* const> stack) {
+      std::vector<std::string> frames;
+      for (const coro_st::async_frame* f : stack)
+      {
+        frames.emplace_back(f->awaiting);
+      }
+      stacks.push_back(std::move(frames));
+    });
+    ASSERT_EQ(1, stacks.size());
+    ASSERT_EQ(2, stacks[0].size());
+    ASSERT_EQ("coro_st::sleep_task", stacks[0][0]);
+    ASSERT_EQ("coro_st::co<int>", stacks[0][1]);
+
+    std::ostringstream os;
+    registry.dump(os);
+    std::string text = os.str();
+    ASSERT_NE(std::string::npos, text.find("async stack 0:"));
+    ASSERT_NE(std::string::npos, text.find("#1"));
+    ASSERT_NE(std::string::npos, text.find("async_stack_test.cpp:22"));
+    ASSERT_NE(std::string::npos, text.find("async_stack_test.cpp:28"));
+    ASSERT_EQ(std::string::npos, text.find("async stack 1:"));
+
+    tl.run_one_timer();
+    ASSERT_EQ(1, registry.size());
+    tl.run_one_ready();
+    ASSERT_TRUE(tl.result_ready);
+    ASSERT_EQ(42, awaiter.await_resume());
+  }
+
+  TEST(async_stack_not_started)
+  {
+    coro_st::async_stack_registry registry;
+    coro_st_test::test_loop tl;
+    tl.el_ctx.set_async_stacks(&registry);
+
+    {
+      auto task = async_outer();
+      auto awaiter = task.get_work().get_awaiter(tl.ctx);
+
+      std::ostringstream os;
+      registry.dump(os);
+      ASSERT_NE(std::string::npos, os.str().find("not started"));
+    }
+    ASSERT_EQ(0, registry.size());
+  }
+
+  TEST(async_stack_combinator_children)
+  {
+    coro_st::async_stack_registry registry;
+    coro_st_test::test_loop tl;
+    tl.el_ctx.set_async_stacks(&registry);
+
+    auto task = async_both();
+    auto awaiter = task.get_work().get_awaiter(tl.ctx);
+    awaiter.start();
+    ASSERT_EQ(3, registry.size());
+
+    size_t stack_count = 0;
+    size_t sleeping = 0;
+    registry.for_each_stack([&](std::span<const coro_st::async_frame* const> stack) {
+      ++stack_count;
+      ASSERT_EQ(1, stack.size());
+      if (stack[0]->awaiting == "coro_st::sleep_task")
+      {
+        ++sleeping;
+      }
+      else
+      {
+        ASSERT_NE(std::string_view::npos, stack[0]->awaiting.find("wait_all_task"));
+      }
+    });
+    ASSERT_EQ(3, stack_count);
+    ASSERT_EQ(2, sleeping);
+
+    tl.stop_source.request_stop();
+    tl.run_one_ready(2);
+    ASSERT_TRUE(tl.stopped);
+    // the stopped frames are destroyed with the root
+    ASSERT_EQ(3, registry.size());
+  }
+
+  TEST(async_stack_not_registered)
+  {
+    coro_st_test::test_loop tl;
+
+    auto task = async_outer();
+    auto awaiter = task.get_work().get_awaiter(tl.ctx);
+    awaiter.start();
+
+    ASSERT_EQ(nullptr, tl.ctx.get_async_stacks());
+    tl.run_one_timer();
+    tl.run_one_ready();
+    ASSERT_TRUE(tl.result_ready);
+  }
+
+  TEST(async_stack_run)
+  {
+    coro_st::async_stack_registry registry;
+    auto result = coro_st::run(
+      async_count_frames(registry),
+      coro_st::run_options{ .async_stacks = &registry }).value();
+    ASSERT_EQ(1, result);
+    ASSERT_EQ(0, registry.size());
+  }
+} // anonymous namespace
@@ -0,0 +1,139 @@
+#pragma once
+
+// Part of test_hooks
+
+#include "../coro_st_lib/loop_hooks_policy.h"
+
+#include <cassert>
+#include <coroutine>
+#include <cstddef>
+#include <source_location>
+#include <string_view>
+
+struct counting_hooks
+{
+  static inline size_t push_ready_count{ 0 };
+  static inline size_t timer_insert_count{ 0 };
+  static inline size_t timer_remove_count{ 0 };
+  static inline size_t timer_fire_count{ 0 };
+  static inline size_t coroutine_resume_count{ 0 };
+  static inline size_t result_ready_count{ 0 };
+  static inline size_t stopped_count{ 0 };
+  static inline size_t co_attach_count{ 0 };
+  static inline size_t co_await_count{ 0 };
+  static inline std::string_view last_awaiting{};
+  static inline size_t co_suspend_count{ 0 };
+  static inline size_t co_resume_count{ 0 };
+  static inline size_t co_resume_not_suspended_count{ 0 };
+  static inline size_t allocation_count{ 0 };
+
+  struct co_frame
+  {
+    bool running{ false };
+  };
+
+  struct context_data
+  {
+    int tag{ 0 };
+  };
+
+  static void reset() noexcept
+  {
+    push_ready_count = 0;
+    timer_insert_count = 0;
+    timer_remove_count = 0;
+    timer_fire_count = 0;
+    coroutine_resume_count = 0;
+    result_ready_count = 0;
+    stopped_count = 0;
+    co_attach_count = 0;
+    co_await_count = 0;
+    last_awaiting = {};
+    co_suspend_count = 0;
+    co_resume_count = 0;
+    co_resume_not_suspended_count = 0;
+    allocation_count = 0;
+  }
+
+  static void on_push_ready(coro_st::ready_node&) noexcept
+  {
+    ++push_ready_count;
+  }
+
+  static void on_timer_insert(coro_st::timer_node&) noexcept
+  {
+    ++timer_insert_count;
+  }
+
+  static void on_timer_remove(coro_st::timer_node&) noexcept
+  {
+    ++timer_remove_count;
+  }
+
+  static void on_timer_fire(coro_st::timer_node&) noexcept
+  {
+    ++timer_fire_count;
+  }
+
+  static void on_coroutine_resume(std::coroutine_handle<>) noexcept
+  {
+    ++coroutine_resume_count;
+  }
+
+  static void on_completion(coro_st::context&, bool stopped) noexcept
+  {
+    if (stopped)
+    {
+      ++stopped_count;
+    }
+    else
+    {
+      ++result_ready_count;
+    }
+  }
+
+  template<typename Context>
+  static void on_co_attach(
+    co_frame& frame,
+    Context&,
+    std::coroutine_handle<>,
+    const std::coroutine_handle<>*) noexcept
+  {
+    assert(!frame.running);
+    ++co_attach_count;
+  }
+
+  static void on_co_await(
+    co_frame& frame, std::string_view awaiting, std::source_location) noexcept
+  {
+    assert(frame.running);
+    ++co_await_count;
+    last_awaiting = awaiting;
+  }
+
+  static void on_co_suspend(co_frame& frame) noexcept
+  {
+    assert(frame.running);
+    frame.running = false;
+    ++co_suspend_count;
+  }
+
+  static void on_co_resume(co_frame& frame, bool suspended) noexcept
+  {
+    assert(!frame.running);
+    frame.running = true;
+    if (suspended)
+    {
+      ++co_resume_count;
+    }
+    else
+    {
+      ++co_resume_not_suspended_count;
+    }
+  }
+
+  static void on_allocation(size_t) noexcept
+  {
+    ++allocation_count;
+  }
+};
@@ -0,0 +1,93 @@
+#include "../test_lib/test.h"
+
+#include "../coro_st_lib/event_loop.h"
+#include "../coro_st_lib/event_loop_context.h"
+
+#include <chrono>
+
+namespace
+{
+  static_assert(coro_st::loop_hooks::deadline_scheduling);
+
+  TEST(deadline_scheduling_same_deadline_fifo)
+  {
+    coro_st::ready_queue q;
+    coro_st::ready_heap rh;
+    coro_st::timer_heap h;
+    coro_st::loop_clock c;
+
+    coro_st::event_loop_context event_loop_context{ q, rh, h, c };
+
+    auto deadline = std::chrono::steady_clock::now();
+
+    constexpr size_t count = 16;
+    coro_st::deadline_ready_node nodes[count];
+    for (auto& node : nodes)
+    {
+      node.cb = coro_st::callback(&node, +[](void*) noexcept {});
+      node.deadline = deadline;
+      event_loop_context.push_ready_node(node);
+    }
+
+    ASSERT_TRUE(q.empty());
+    for (auto& node : nodes)
+    {
+      ASSERT_EQ(&node, rh.min_node());
+      rh.pop_min();
+    }
+    ASSERT_TRUE(rh.empty());
+  }
+
+  TEST(deadline_scheduling_no_deadline_fifo)
+  {
+    coro_st::ready_queue q;
+    coro_st::ready_heap rh;
+    coro_st::timer_heap h;
+    coro_st::loop_clock c;
+
+    coro_st::event_loop_context event_loop_context{ q, rh, h, c };
+
+    coro_st::deadline_ready_node node;
+    node.cb = coro_st::callback(&node, +[](void*) noexcept {});
+    event_loop_context.push_ready_node(node);
+
+    ASSERT_TRUE(rh.empty());
+    ASSERT_EQ(&node, q.pop());
+  }
+
+  struct record
+  {
+    int& order;
+    int value{ 0 };
+  };
+
+  void on_record(void* x) noexcept
+  {
+    record& r = *static_cast<record*>(x);
+    r.value = ++r.order;
+  }
+
+  TEST(deadline_scheduling_ready_heap_before_ready_queue)
+  {
+    coro_st::event_loop el;
+
+    int order{ 0 };
+
+    coro_st::ready_node n0;
+    record r0{ order };
+    n0.cb = coro_st::callback(&r0, &on_record);
+    el.ready_queue_.push(&n0);
+
+    coro_st::deadline_ready_node n1;
+    record r1{ order };
+    n1.deadline = std::chrono::steady_clock::now();
+    n1.cb = coro_st::callback(&r1, &on_record);
+    el.ready_heap_.insert(&n1);
+
+    auto sleep = el.do_current_pending_work();
+
+    ASSERT_FALSE(sleep.has_value());
+    ASSERT_EQ(1, r1.value);
+    ASSERT_EQ(2, r0.value);
+  }
+} // anonymous namespace
@@ -0,0 +1,203 @@
+#include "../test_lib/test.h"
+
+#include "../coro_st_lib/coro_st.h"
+
+#include "../coro_st_lib_test/test_loop.h"
+
+#include <chrono>
+#include <type_traits>
+
+namespace
+{
+  static_assert(std::is_same_v<test_hooks, coro_st::loop_hooks>);
+  // the policy is part of the ABI
+  static_assert(std::is_same_v<coro_st::hooks_test_hooks::context, coro_st::context>);
+
+  // only the optional parts that some policy has
+  using no_combined_hooks = coro_st::combine_loop_hooks<coro_st::no_loop_hooks>;
+  static_assert(coro_st::is_loop_hooks<no_combined_hooks>);
+  static_assert(!coro_st::impl::has_co_suspend_hooks<no_combined_hooks>);
+  static_assert(!coro_st::impl::has_on_allocation<no_combined_hooks>);
+  static_assert(!no_combined_hooks::deadline_scheduling);
+  using combined_hooks = coro_st::combine_loop_hooks<coro_st::no_loop_hooks, counting_hooks>;
+  static_assert(coro_st::is_loop_hooks<combined_hooks>);
+  static_assert(coro_st::impl::has_on_co_attach<combined_hooks>);
+  static_assert(coro_st::impl::has_on_co_await<combined_hooks>);
+  static_assert(coro_st::impl::has_co_suspend_hooks<combined_hooks>);
+  static_assert(coro_st::impl::has_on_allocation<combined_hooks>);
+
+  TEST(loop_hooks_push_ready)
+  {
+    counting_hooks::reset();
+    coro_st_test::test_loop tl;
+
+    coro_st::ready_node node;
+    node.cb = coro_st::make_member_callback<&coro_st_test::test_loop::on_result_ready>(&tl);
+    tl.el_ctx.push_ready_node(node);
+    ASSERT_EQ(1, counting_hooks::push_ready_count);
+
+    tl.run_one_ready();
+    ASSERT_TRUE(tl.result_ready);
+  }
+
+  TEST(loop_hooks_timer_insert_remove)
+  {
+    counting_hooks::reset();
+    coro_st_test::test_loop tl;
+
+    coro_st::timer_node t0{ tl.el_ctx.now() };
+    t0.cb = coro_st::make_member_callback<&coro_st_test::test_loop::on_result_ready>(&tl);
+    tl.el_ctx.insert_timer_node(t0);
+    coro_st::timer_node t1{ tl.el_ctx.now() + std::chrono::hours(1) };
+    t1.cb = coro_st::make_member_callback<&coro_st_test::test_loop::on_stopped>(&tl);
+    tl.el_ctx.insert_timer_node(t1);
+    ASSERT_EQ(2, counting_hooks::timer_insert_count);
+
+    tl.el_ctx.remove_timer_node(t1);
+    ASSERT_EQ(1, counting_hooks::timer_remove_count);
+
+    tl.run_one_timer();
+    ASSERT_TRUE(tl.result_ready);
+  }
+
+  coro_st::co<void> async_sleep_twice()
+  {
+    co_await coro_st::async_sleep_for(std::chrono::microseconds(1));
+    co_await coro_st::async_sleep_for(std::chrono::microseconds(1));
+  }
+
+  TEST(loop_hooks_timer_fire)
+  {
+    counting_hooks::reset();
+
+    ASSERT_TRUE(coro_st::run(async_sleep_twice()).has_value());
+    ASSERT_EQ(2, counting_hooks::timer_insert_count);
+    ASSERT_EQ(2, counting_hooks::timer_fire_count);
+    ASSERT_EQ(0, counting_hooks::timer_remove_count);
+  }
+
+  coro_st::co<int> async_child()
+  {
+    co_return 21;
+  }
+
+  coro_st::co<int> async_parent()
+  {
+    int x = co_await async_child();
+    co_return x + co_await async_child();
+  }
+
+  TEST(loop_hooks_coroutine_resume_symmetric_transfer)
+  {
+    counting_hooks::reset();
+
+    ASSERT_EQ(42, coro_st::run(async_parent()).value());
+    // start the parent, then for each child: start it
+    // and resume the parent when it completes
+    ASSERT_EQ(5, counting_hooks::coroutine_resume_count);
+  }
+
+  coro_st::co<int> async_yield_twice()
+  {
+    co_await coro_st::async_yield();
+    co_await coro_st::async_yield();
+    co_return 42;
+  }
+
+  TEST(loop_hooks_coroutine_resume_scheduled)
+  {
+    counting_hooks::reset();
+
+    ASSERT_EQ(42, coro_st::run(async_yield_twice()).value());
+    // start, then a resume from the ready queue for each yield
+    ASSERT_EQ(3, counting_hooks::coroutine_resume_count);
+  }
+
+  coro_st::co<int> async_wait_all_yield()
+  {
+    co_await coro_st::async_wait_all(
+      coro_st::async_yield(), coro_st::async_yield());
+    co_return 42;
+  }
+
+  TEST(loop_hooks_coroutine_resume_inline)
+  {
+    counting_hooks::reset();
+
+    ASSERT_EQ(42, coro_st::run(async_wait_all_yield()).value());
+    // start, then the inline resume by wait_all when the last child completes
+    ASSERT_EQ(2, counting_hooks::coroutine_resume_count);
+  }
+
+  TEST(loop_hooks_completion_result_ready)
+  {
+    counting_hooks::reset();
+
+    ASSERT_EQ(21, coro_st::run(async_child()).value());
+    ASSERT_EQ(1, counting_hooks::result_ready_count);
+    ASSERT_EQ(0, counting_hooks::stopped_count);
+  }
+
+  TEST(loop_hooks_completion_stopped)
+  {
+    counting_hooks::reset();
+
+    ASSERT_FALSE(coro_st::run(coro_st::async_just_stopped()).has_value());
+    ASSERT_EQ(0, counting_hooks::result_ready_count);
+    ASSERT_EQ(1, counting_hooks::stopped_count);
+  }
+
+  TEST(loop_hooks_co_frame)
+  {
+    counting_hooks::reset();
+
+    ASSERT_EQ(42, coro_st::run(async_parent()).value());
+    ASSERT_EQ(3, counting_hooks::co_attach_count);
+    ASSERT_EQ(2, counting_hooks::co_await_count);
+    ASSERT_EQ("coro_st::co<int>", counting_hooks::last_awaiting);
+    // the initial resume of each coroutine and the parent after each child
+    ASSERT_EQ(5, counting_hooks::co_resume_count);
+    // the parent at each co_await and each coroutine at the end
+    ASSERT_EQ(5, counting_hooks::co_suspend_count);
+    ASSERT_EQ(0, counting_hooks::co_resume_not_suspended_count);
+    ASSERT_EQ(3, counting_hooks::allocation_count);
+  }
+
+  coro_st::co<int> async_arrive_and_wait()
+  {
+    coro_st::latch ltch{ 1 };
+    co_await ltch.async_arrive_and_wait();
+    co_return 42;
+  }
+
+  TEST(loop_hooks_co_resume_not_suspended)
+  {
+    counting_hooks::reset();
+
+    ASSERT_EQ(42, coro_st::run(async_arrive_and_wait()).value());
+    ASSERT_EQ(1, counting_hooks::co_await_count);
+    ASSERT_EQ(1, counting_hooks::co_resume_count);
+    // the latch is ready in await_suspend
+    ASSERT_EQ(1, counting_hooks::co_resume_not_suspended_count);
+    ASSERT_EQ(2, counting_hooks::co_suspend_count);
+  }
+
+  TEST(loop_hooks_context_data)
+  {
+    coro_st_test::test_loop tl;
+
+    ASSERT_EQ(0, tl.ctx.get_hooks_data<counting_hooks>().tag);
+    tl.ctx.get_hooks_data<counting_hooks>().tag = 42;
+
+    coro_st::stop_source child_stop_source;
+    coro_st::context child_ctx{
+      tl.ctx,
+      child_stop_source.get_token(),
+      coro_st::make_member_completion<
+        &coro_st_test::test_loop::on_result_ready,
+        &coro_st_test::test_loop::on_stopped
+      >(&tl)
+    };
+    ASSERT_EQ(42, child_ctx.get_hooks_data<counting_hooks>().tag);
+  }
+} // anonymous namespace
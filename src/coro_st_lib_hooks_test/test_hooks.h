@@ -0,0 +1,18 @@
+#pragma once
+
+// Included by loop_hooks.h, the project is built with
+// -DCORO_ST_LOOP_HOOKS=test_hooks
+
+#include "../coro_st_lib/async_stack.h"
+#include "../coro_st_lib/loop_hooks_policy.h"
+#include "../coro_st_lib/task_account.h"
+
+#include "counting_hooks.h"
+
+struct test_hooks : coro_st::combine_loop_hooks<
+  counting_hooks,
+  coro_st::async_stack_hooks,
+  coro_st::task_account_hooks,
+  coro_st::deadline_scheduling_hooks>
+{
+};
@@ -0,0 +1,218 @@
+#include "../test_lib/test.h"
+
+#include "../coro_st_lib/with_account.h"
+
+#include "../coro_st_lib/coro_st.h"
+
+#include "../coro_st_lib_test/test_loop.h"
+
+#include <chrono>
+#include <memory>
+#include <optional>
+
+namespace
+{
+  static_assert(
+    coro_st::is_co_task<
+      coro_st::with_account_task<
+        coro_st::co<void>>>);
+  static_assert(
+    coro_st::is_co_task<
+      coro_st::with_account_task<
+        coro_st::co<int>>>);
+
+  void busy_wait(std::chrono::steady_clock::duration duration)
+  {
+    auto end = std::chrono::steady_clock::now() + duration;
+    while (std::chrono::steady_clock::now() < end)
+    {
+    }
+  }
+
+  TEST(with_account_context_inherits_account)
+  {
+    coro_st_test::test_loop tl;
+
+    ASSERT_EQ(nullptr, tl.ctx.get_hooks_data<coro_st::task_account_hooks>().account);
+
+    coro_st::task_account account;
+    tl.ctx.get_hooks_data<coro_st::task_account_hooks>().account = &account;
+
+    coro_st::context ctx2{
+      tl.ctx,
+      tl.stop_source.get_token(),
+      coro_st::make_member_completion<
+        &coro_st_test::test_loop::on_result_ready,
+        &coro_st_test::test_loop::on_stopped
+      >(&tl)
+    };
+    ASSERT_EQ(&account, ctx2.get_hooks_data<coro_st::task_account_hooks>().account);
+  }
+
+  constexpr auto sleep_duration = std::chrono::milliseconds(20);
+
+  coro_st::co<int> async_nested()
+  {
+    busy_wait(std::chrono::milliseconds(1));
+    co_return 42;
+  }
+
+  coro_st::co<int> async_busy_then_sleep()
+  {
+    co_await coro_st::async_sleep_for(sleep_duration);
+    co_return co_await async_nested();
+  }
+
+  TEST(with_account_run)
+  {
+    coro_st::task_account account;
+
+    auto start = std::chrono::steady_clock::now();
+    auto result = coro_st::run(
+      coro_st::async_with_account(async_busy_then_sleep(), account)).value();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    ASSERT_EQ(42, result);
+
+    ASSERT_TRUE(account.run_time > std::chrono::steady_clock::duration::zero());
+    // not charged while sleeping
+    ASSERT_TRUE(account.run_time + sleep_duration <= elapsed);
+    // start, after sleep, start nested, after nested
+    ASSERT_EQ(4, account.resumes);
+    // the frame of async_nested (the frame of the root was allocated before)
+    ASSERT_EQ(1, account.allocations);
+    ASSERT_TRUE(account.allocated_bytes > 0);
+  }
+
+  TEST(with_account_virtual_time)
+  {
+    coro_st::task_account account;
+
+    auto result = coro_st::run(
+      coro_st::async_with_account(async_busy_then_sleep(), account),
+      coro_st::run_options{ .virtual_time = true }).value();
+    ASSERT_EQ(42, result);
+
+    // the run time is measured with the loop clock,
+    // the virtual time does not move while running
+    ASSERT_EQ(std::chrono::steady_clock::duration::zero(), account.run_time);
+    ASSERT_EQ(4, account.resumes);
+  }
+
+  coro_st::co<void> async_busy(std::chrono::steady_clock::duration duration)
+  {
+    co_await coro_st::async_yield();
+    busy_wait(duration);
+  }
+
+  coro_st::co<void> async_two_tenants(coro_st::task_account& a, coro_st::task_account& b)
+  {
+    co_await coro_st::async_wait_all(
+      coro_st::async_with_account(async_busy(std::chrono::milliseconds(20)), a),
+      coro_st::async_with_account(async_busy(std::chrono::milliseconds(0)), b));
+  }
+
+  TEST(with_account_separate)
+  {
+    coro_st::task_account a;
+    coro_st::task_account b;
+
+    coro_st::run(async_two_tenants(a, b)).value();
+
+    ASSERT_TRUE(a.run_time > b.run_time);
+    ASSERT_EQ(2, a.resumes);
+    ASSERT_EQ(2, b.resumes);
+  }
+
+  coro_st::co<int> async_no_suspend()
+  {
+    // the children complete immediately, wait_all does not suspend
+    auto [x, y] = co_await coro_st::async_wait_all(
+      coro_st::async_just(1), coro_st::async_just(2));
+    co_return x + y;
+  }
+
+  TEST(with_account_await_without_suspend)
+  {
+    coro_st::task_account account;
+
+    auto result = coro_st::run(
+      coro_st::async_with_account(async_no_suspend(), account)).value();
+    ASSERT_EQ(3, result);
+    // only the start
+    ASSERT_EQ(1, account.resumes);
+  }
+
+  coro_st::co<void> async_nursery_child(int& i)
+  {
+    ++i;
+    co_return;
+  }
+
+  coro_st::co<void> async_nursery_tenants(
+    coro_st::nursery& n, coro_st::task_account& a, coro_st::task_account& b, int& i)
+  {
+    n.spawn_child([&a, &i]() {
+      return coro_st::async_with_account(async_nursery_child(i), a);
+    });
+    n.spawn_child([&b, &i]() {
+      return coro_st::async_with_account(async_nursery_child(i), b);
+    });
+    co_return;
+  }
+
+  TEST(with_account_nursery_children)
+  {
+    coro_st::task_account a;
+    coro_st::task_account b;
+    coro_st::task_account parent;
+    int i = 0;
+
+    coro_st::nursery n;
+    coro_st::run(coro_st::async_with_account(
+      n.async_run(async_nursery_tenants(n, a, b, i)), parent)).value();
+    ASSERT_EQ(2, i);
+    ASSERT_EQ(1, a.resumes);
+    ASSERT_EQ(1, b.resumes);
+    // the child records and frames are allocated by the parent
+    ASSERT_EQ(4, parent.allocations);
+    ASSERT_EQ(0, a.allocations);
+  }
+
+  coro_st::co<int> async_slow_load()
+  {
+    co_await coro_st::async_sleep_for(std::chrono::milliseconds(10));
+    co_await coro_st::async_yield();
+    co_return 42;
+  }
+
+  coro_st::co<std::optional<int>> async_first_caller(coro_st::singleflight<int, int>& sf)
+  {
+    auto account = std::make_unique<coro_st::task_account>();
+    auto result = co_await coro_st::async_wait_for(
+      coro_st::async_with_account(sf.async_do(1, &async_slow_load), *account),
+      std::chrono::milliseconds(1));
+    // gone while the flight goes on for the other caller
+    account.reset();
+    co_return result;
+  }
+
+  coro_st::co<int> async_second_caller(
+    coro_st::singleflight<int, int>& sf, coro_st::task_account& account)
+  {
+    co_return co_await coro_st::async_with_account(sf.async_do(1, &async_slow_load), account);
+  }
+
+  TEST(with_account_shared_flight_first_caller_cancelled)
+  {
+    coro_st::singleflight<int, int> sf;
+    coro_st::task_account account;
+
+    auto [first, second] = coro_st::run(coro_st::async_wait_all(
+      async_first_caller(sf),
+      async_second_caller(sf, account))).value();
+    ASSERT_FALSE(first.has_value());
+    ASSERT_EQ(42, second);
+    // the shared work is not charged to any caller
+    ASSERT_EQ(0, account.resumes);
+  }
+} // anonymous namespace
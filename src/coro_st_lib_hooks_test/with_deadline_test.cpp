@@ -0,0 +1,157 @@
+#include "../test_lib/test.h"
+
+#include "../coro_st_lib/with_deadline.h"
+
+#include "../coro_st_lib/coro_st.h"
+
+#include "../coro_st_lib_test/test_loop.h"
+
+#include <chrono>
+#include <vector>
+
+namespace
+{
+  static_assert(
+    coro_st::is_co_task<
+      coro_st::with_deadline_task<
+        coro_st::co<void>>>);
+  static_assert(
+    coro_st::is_co_task<
+      coro_st::with_deadline_task<
+        coro_st::co<int>>>);
+
+  TEST(with_deadline_context_inherits_deadline)
+  {
+    coro_st_test::test_loop tl;
+
+    ASSERT_TRUE(coro_st::no_deadline == tl.ctx.get_deadline());
+
+    auto deadline = tl.ctx.now() + std::chrono::seconds(1);
+    tl.ctx.set_deadline(deadline);
+
+    coro_st::context ctx2{
+      tl.ctx,
+      tl.stop_source.get_token(),
+      coro_st::make_member_completion<
+        &coro_st_test::test_loop::on_result_ready,
+        &coro_st_test::test_loop::on_stopped
+      >(&tl)
+    };
+    ASSERT_TRUE(deadline == ctx2.get_deadline());
+
+    // scheduled work with a deadline goes in the heap
+    ctx2.schedule_result_ready();
+    ASSERT_TRUE(tl.el.ready_queue_.empty());
+    ASSERT_FALSE(tl.el.ready_heap_.empty());
+    tl.run_one_ready();
+    ASSERT_TRUE(tl.result_ready);
+  }
+
+  TEST(with_deadline_keeps_earlier_parent_deadline)
+  {
+    coro_st_test::test_loop tl;
+
+    auto deadline = tl.ctx.now() + std::chrono::milliseconds(1);
+    tl.ctx.set_deadline(deadline);
+
+    auto task = coro_st::async_with_deadline(
+      coro_st::async_yield(), std::chrono::seconds(1));
+    auto awaiter = task.get_work().get_awaiter(tl.ctx);
+    awaiter.start();
+
+    ASSERT_TRUE(tl.el.ready_queue_.empty());
+    ASSERT_TRUE(deadline == tl.el.ready_heap_.min_node()->deadline);
+    tl.run_one_ready();
+    ASSERT_TRUE(tl.result_ready);
+  }
+
+  TEST(with_deadline_max_duration)
+  {
+    coro_st_test::test_loop tl;
+
+    auto task = coro_st::async_with_deadline(
+      coro_st::async_yield(), std::chrono::steady_clock::duration::max());
+    auto awaiter = task.get_work().get_awaiter(tl.ctx);
+    awaiter.start();
+
+    // saturated to no deadline
+    ASSERT_TRUE(tl.el.ready_heap_.empty());
+    ASSERT_FALSE(tl.el.ready_queue_.empty());
+    tl.run_one_ready();
+    ASSERT_TRUE(tl.result_ready);
+  }
+
+  coro_st::co<int> async_some_int()
+  {
+    co_await coro_st::async_yield();
+    co_return 42;
+  }
+
+  TEST(with_deadline_int)
+  {
+    int result = coro_st::run(coro_st::async_with_deadline(
+      async_some_int(), std::chrono::milliseconds(1)
+    )).value();
+    ASSERT_EQ(42, result);
+  }
+
+  TEST(with_deadline_stopped)
+  {
+    auto result = coro_st::run(coro_st::async_with_deadline(
+      coro_st::async_just_stopped(), std::chrono::milliseconds(1)
+    ));
+    ASSERT_FALSE(result.has_value());
+  }
+
+  TEST(with_deadline_exception)
+  {
+    auto async_lambda = []() -> coro_st::co<void> {
+      co_await coro_st::async_yield();
+      throw std::runtime_error("Ups!");
+    };
+
+    ASSERT_THROW_WHAT(
+      coro_st::run(coro_st::async_with_deadline(
+        async_lambda(), std::chrono::milliseconds(1)
+      )),
+      std::runtime_error, "Ups!");
+  }
+
+  coro_st::co<void> async_record(std::vector<int>& order, int id)
+  {
+    for (int i = 0; i < 3; ++i)
+    {
+      co_await coro_st::async_yield();
+      order.push_back(id);
+    }
+  }
+
+  TEST(with_deadline_runs_before_fifo)
+  {
+    std::vector<int> order;
+
+    coro_st::run(coro_st::async_wait_all(
+      async_record(order, 1),
+      coro_st::async_with_deadline(
+        async_record(order, 2), std::chrono::seconds(1))
+    )).value();
+
+    std::vector<int> expected{ 2, 1, 2, 1, 2, 1 };
+    ASSERT_TRUE(expected == order);
+  }
+
+  TEST(with_deadline_earliest_first)
+  {
+    std::vector<int> order;
+
+    coro_st::run(coro_st::async_wait_all(
+      coro_st::async_with_deadline(
+        async_record(order, 1), std::chrono::seconds(2)),
+      coro_st::async_with_deadline(
+        async_record(order, 2), std::chrono::seconds(1))
+    )).value();
+
+    std::vector<int> expected{ 2, 1, 2, 1, 2, 1 };
+    ASSERT_TRUE(expected == order);
+  }
+} // anonymous namespace
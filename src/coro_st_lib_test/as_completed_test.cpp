@@ -0,0 +1,219 @@
+#include "../test_lib/test.h"
+
+#include "../coro_st_lib/as_completed.h"
+
+#include "../coro_st_lib/co.h"
+#include "../coro_st_lib/coro_type_traits.h"
+#include "../coro_st_lib/just.h"
+#include "../coro_st_lib/just_stopped.h"
+#include "../coro_st_lib/run.h"
+#include "../coro_st_lib/suspend_forever.h"
+#include "../coro_st_lib/yield.h"
+
+#include "test_loop.h"
+
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace
+{
+  using just_int_fn = coro_st::just_task<int>(*)(int);
+
+  coro_st::just_task<int> just_twice(int x) noexcept
+  {
+    return coro_st::async_just(x * 2);
+  }
+
+  struct record_completed
+  {
+    std::vector<std::pair<size_t, int>>* completed;
+
+    bool operator()(size_t index, int value) const
+    {
+      completed->emplace_back(index, value);
+      return true;
+    }
+  };
+
+  static_assert(
+    coro_st::is_co_task<
+      coro_st::as_completed_task<std::vector<int>, just_int_fn, record_completed>>);
+
+  TEST(as_completed_chain_root_immediate)
+  {
+    coro_st_test::test_loop tl;
+
+    std::vector<int> in{ 1, 2, 3 };
+    std::vector<std::pair<size_t, int>> completed;
+
+    auto task = coro_st::async_as_completed(
+      in, &just_twice, record_completed{ &completed });
+
+    auto awaiter = task.get_work().get_awaiter(tl.ctx);
+
+    awaiter.start();
+
+    ASSERT_TRUE(tl.el.ready_queue_.empty());
+    ASSERT_TRUE(tl.result_ready);
+    ASSERT_FALSE(tl.stopped);
+    ASSERT_EQ(3, awaiter.await_resume());
+
+    std::vector<std::pair<size_t, int>> expected{ {0, 2}, {1, 4}, {2, 6} };
+    ASSERT_TRUE(expected == completed);
+  }
+
+  TEST(as_completed_chain_root_empty)
+  {
+    coro_st_test::test_loop tl;
+
+    std::vector<int> in;
+    std::vector<std::pair<size_t, int>> completed;
+
+    auto task = coro_st::async_as_completed(
+      in, &just_twice, record_completed{ &completed });
+
+    auto awaiter = task.get_work().get_awaiter(tl.ctx);
+
+    awaiter.start();
+
+    ASSERT_TRUE(tl.result_ready);
+    ASSERT_EQ(0, awaiter.await_resume());
+    ASSERT_TRUE(completed.empty());
+  }
+
+  coro_st::co<int> async_forever(int)
+  {
+    co_await coro_st::async_suspend_forever();
+    co_return 0;
+  }
+
+  TEST(as_completed_chain_root_cancellation)
+  {
+    coro_st_test::test_loop tl;
+
+    std::vector<int> in{ 1, 2, 3 };
+    std::vector<std::pair<size_t, int>> completed;
+
+    auto task = coro_st::async_as_completed(
+      in, &async_forever, record_completed{ &completed });
+
+    auto awaiter = task.get_work().get_awaiter(tl.ctx);
+
+    awaiter.start();
+
+    ASSERT_TRUE(tl.el.ready_queue_.empty());
+
+    tl.stop_source.request_stop();
+
+    tl.run_one_ready(3);
+    ASSERT_TRUE(tl.el.ready_queue_.empty());
+    ASSERT_FALSE(tl.result_ready);
+    ASSERT_TRUE(tl.stopped);
+    ASSERT_TRUE(completed.empty());
+  }
+
+  coro_st::co<int> async_yield_n(int n)
+  {
+    for (int i = 0; i < n; ++i)
+    {
+      co_await coro_st::async_yield();
+    }
+    co_return n;
+  }
+
+  TEST(as_completed_completion_order)
+  {
+    std::vector<int> in{ 3, 1, 2 };
+    std::vector<std::pair<size_t, int>> completed;
+
+    auto count = coro_st::run(coro_st::async_as_completed(
+      in, &async_yield_n, record_completed{ &completed })).value();
+
+    ASSERT_EQ(3, count);
+    std::vector<std::pair<size_t, int>> expected{ {1, 1}, {2, 2}, {0, 3} };
+    ASSERT_TRUE(expected == completed);
+  }
+
+  coro_st::co<int> async_yield_or_forever(int n)
+  {
+    if (n < 0)
+    {
+      co_await coro_st::async_suspend_forever();
+    }
+    co_return co_await async_yield_n(n);
+  }
+
+  TEST(as_completed_cancel_stragglers)
+  {
+    std::vector<int> in{ -1, 2, -1, 1 };
+    std::vector<std::pair<size_t, int>> completed;
+
+    auto on_completed = [&completed](size_t index, int value) {
+      completed.emplace_back(index, value);
+      // enough results
+      return completed.size() < 2;
+    };
+    auto count = coro_st::run(coro_st::async_as_completed(
+      in, &async_yield_or_forever, std::ref(on_completed))).value();
+
+    ASSERT_EQ(2, count);
+    std::vector<std::pair<size_t, int>> expected{ {3, 1}, {1, 2} };
+    ASSERT_TRUE(expected == completed);
+  }
+
+  coro_st::co<void> async_throw_on_two(int x)
+  {
+    co_await coro_st::async_yield();
+    if (x == 2)
+    {
+      throw std::runtime_error("Ups!");
+    }
+    co_await coro_st::async_suspend_forever();
+  }
+
+  TEST(as_completed_exception)
+  {
+    std::vector<int> in{ 1, 2, 3 };
+    size_t calls{ 0 };
+
+    auto on_completed = [&calls](size_t, coro_st::void_result) {
+      ++calls;
+      return true;
+    };
+    ASSERT_THROW_WHAT(
+      coro_st::run(coro_st::async_as_completed(
+        in, &async_throw_on_two, std::ref(on_completed))),
+      std::runtime_error, "Ups!");
+    ASSERT_EQ(0, calls);
+  }
+
+  TEST(as_completed_on_completed_exception)
+  {
+    std::vector<int> in{ 1, 2 };
+
+    auto on_completed = [](size_t, int) -> bool {
+      throw std::runtime_error("Ups!");
+    };
+    ASSERT_THROW_WHAT(
+      coro_st::run(coro_st::async_as_completed(
+        in, &async_yield_or_forever, std::ref(on_completed))),
+      std::runtime_error, "Ups!");
+  }
+
+  TEST(as_completed_child_stopped)
+  {
+    std::vector<int> in{ 1, 2 };
+
+    auto fn = [](int) {
+      return coro_st::async_just_stopped();
+    };
+    auto on_completed = [](size_t, coro_st::void_result) {
+      return true;
+    };
+    auto result = coro_st::run(coro_st::async_as_completed(
+      in, fn, on_completed));
+    ASSERT_FALSE(result.has_value());
+  }
+} // anonymous namespace
@@ -0,0 +1,175 @@
+#include "../test_lib/test.h"
+
+#include "../coro_st_lib/async_cache.h"
+
+#include "../coro_st_lib/co.h"
+#include "../coro_st_lib/run.h"
+#include "../coro_st_lib/sleep.h"
+#include "../coro_st_lib/wait_all.h"
+#include "../coro_st_lib/yield.h"
+
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+  coro_st::co<std::string> async_load(int* loads, int key)
+  {
+    co_await coro_st::async_yield();
+    ++*loads;
+    if (key < 0)
+    {
+      throw std::runtime_error("Ups!");
+    }
+    co_return std::to_string(key);
+  }
+
+  struct loader
+  {
+    int* loads;
+
+    coro_st::co<std::string> operator()(const int& key) const
+    {
+      return async_load(loads, key);
+    }
+  };
+
+  using string_cache = coro_st::async_cache<int, std::string>;
+
+  static_assert(coro_st::is_co_task<string_cache::async_cache_get_task<loader>>);
+
+  TEST(async_cache_hit)
+  {
+    int loads{ 0 };
+    string_cache cache{ 2, std::chrono::seconds(0) };
+
+    auto async_lambda = [&]() -> coro_st::co<std::vector<std::string>> {
+      std::vector<std::string> result;
+      result.push_back(co_await cache.async_get(1, loader{ &loads }));
+      result.push_back(co_await cache.async_get(1, loader{ &loads }));
+      co_return result;
+    };
+
+    auto result = coro_st::run(async_lambda()).value();
+
+    std::vector<std::string> expected{ "1", "1" };
+    ASSERT_TRUE(expected == result);
+    ASSERT_EQ(1, loads);
+    ASSERT_EQ(1, cache.size());
+  }
+
+  coro_st::co<void> async_get_into(
+    string_cache& cache, int* loads, int key, std::vector<std::string>& out)
+  {
+    out.push_back(co_await cache.async_get(key, loader{ loads }));
+  }
+
+  TEST(async_cache_coalesced_misses)
+  {
+    int loads{ 0 };
+    string_cache cache{ 2, std::chrono::seconds(0) };
+    std::vector<std::string> out;
+
+    coro_st::run(coro_st::async_wait_all(
+      async_get_into(cache, &loads, 1, out),
+      async_get_into(cache, &loads, 1, out),
+      async_get_into(cache, &loads, 1, out)
+    )).value();
+
+    std::vector<std::string> expected{ "1", "1", "1" };
+    ASSERT_TRUE(expected == out);
+    ASSERT_EQ(1, loads);
+  }
+
+  TEST(async_cache_lru_eviction)
+  {
+    int loads{ 0 };
+    string_cache cache{ 2, std::chrono::seconds(0) };
+    std::vector<std::string> out;
+
+    auto async_lambda = [&]() -> coro_st::co<void> {
+      co_await async_get_into(cache, &loads, 1, out);
+      co_await async_get_into(cache, &loads, 2, out);
+      // 1 becomes the most recently used
+      co_await async_get_into(cache, &loads, 1, out);
+      ASSERT_EQ(2, loads);
+      // evicts 2
+      co_await async_get_into(cache, &loads, 3, out);
+      ASSERT_EQ(3, loads);
+      co_await async_get_into(cache, &loads, 1, out);
+      ASSERT_EQ(3, loads);
+      co_await async_get_into(cache, &loads, 2, out);
+      ASSERT_EQ(4, loads);
+    };
+
+    coro_st::run(async_lambda()).value();
+
+    std::vector<std::string> expected{ "1", "2", "1", "3", "1", "2" };
+    ASSERT_TRUE(expected == out);
+    ASSERT_EQ(2, cache.size());
+  }
+
+  TEST(async_cache_ttl)
+  {
+    int loads{ 0 };
+    std::vector<std::string> out;
+
+    // the cache uses the event loop for the expiry timer:
+    // it is destroyed before the event loop
+    auto async_lambda = [&]() -> coro_st::co<void> {
+      string_cache cache{ 2, std::chrono::milliseconds(1) };
+      co_await async_get_into(cache, &loads, 1, out);
+      co_await async_get_into(cache, &loads, 1, out);
+      ASSERT_EQ(1, loads);
+      co_await coro_st::async_sleep_for(std::chrono::milliseconds(5));
+      ASSERT_EQ(0, cache.size());
+      co_await async_get_into(cache, &loads, 1, out);
+      ASSERT_EQ(2, loads);
+    };
+
+    coro_st::run(async_lambda()).value();
+
+    std::vector<std::string> expected{ "1", "1", "1" };
+    ASSERT_TRUE(expected == out);
+  }
+
+  TEST(async_cache_erase)
+  {
+    int loads{ 0 };
+    string_cache cache{ 2, std::chrono::seconds(0) };
+    std::vector<std::string> out;
+
+    auto async_lambda = [&]() -> coro_st::co<void> {
+      co_await async_get_into(cache, &loads, 1, out);
+      cache.erase(1);
+      ASSERT_EQ(0, cache.size());
+      co_await async_get_into(cache, &loads, 1, out);
+    };
+
+    coro_st::run(async_lambda()).value();
+
+    ASSERT_EQ(2, loads);
+    ASSERT_EQ(1, cache.size());
+  }
+
+  TEST(async_cache_loader_exception)
+  {
+    int loads{ 0 };
+    string_cache cache{ 2, std::chrono::seconds(0) };
+    std::vector<std::string> out;
+
+    ASSERT_THROW_WHAT(
+      coro_st::run(coro_st::async_wait_all(
+        async_get_into(cache, &loads, -1, out),
+        async_get_into(cache, &loads, -1, out)
+      )),
+      std::runtime_error, "Ups!");
+
+    // not cached
+    ASSERT_EQ(1, loads);
+    ASSERT_EQ(0, cache.size());
+    ASSERT_TRUE(out.empty());
+  }
+} // anonymous namespace
@@ -0,0 +1,145 @@
+#include "../test_lib/test.h"
+
+#include "../coro_st_lib/barrier.h"
+
+#include "../coro_st_lib/co.h"
+#include "../coro_st_lib/coro_type_traits.h"
+#include "../coro_st_lib/run.h"
+#include "../coro_st_lib/wait_all.h"
+#include "../coro_st_lib/yield.h"
+
+#include "test_loop.h"
+
+#include <vector>
+
+namespace
+{
+  static_assert(
+    coro_st::is_co_task<
+      coro_st::barrier<>::barrier_arrive_task>);
+
+  TEST(barrier_chain_root)
+  {
+    coro_st_test::test_loop tl;
+
+    coro_st::barrier<> bar{ 2 };
+    ASSERT_EQ(0, bar.phase());
+
+    auto task = bar.async_arrive_and_wait();
+
+    auto awaiter = task.get_work().get_awaiter(tl.ctx);
+
+    awaiter.start();
+
+    ASSERT_TRUE(tl.el.ready_queue_.empty());
+    ASSERT_TRUE(tl.el.timers_heap_.empty());
+
+    bar.arrive_and_drop();
+    ASSERT_EQ(1, bar.phase());
+    ASSERT_EQ(1, bar.expected());
+
+    ASSERT_FALSE(tl.el.ready_queue_.empty());
+    ASSERT_TRUE(tl.el.timers_heap_.empty());
+
+    ASSERT_FALSE(tl.result_ready);
+    ASSERT_FALSE(tl.stopped);
+    tl.run_one_ready();
+    ASSERT_TRUE(tl.result_ready);
+    ASSERT_FALSE(tl.stopped);
+  }
+
+  TEST(barrier_chain_root_last_arrival)
+  {
+    coro_st_test::test_loop tl;
+
+    int completions = 0;
+    auto completion_fn = [&completions]() noexcept {
+      ++completions;
+    };
+    coro_st::barrier bar{ 1, completion_fn };
+
+    auto task = bar.async_arrive_and_wait();
+
+    auto awaiter = task.get_work().get_awaiter(tl.ctx);
+
+    awaiter.start();
+
+    // the last arrival runs the completion function and
+    // completes immediately
+    ASSERT_TRUE(tl.el.ready_queue_.empty());
+    ASSERT_TRUE(tl.result_ready);
+    ASSERT_FALSE(tl.stopped);
+    ASSERT_EQ(1, completions);
+    ASSERT_EQ(1, bar.phase());
+  }
+
+  TEST(barrier_chain_root_cancellation)
+  {
+    coro_st_test::test_loop tl;
+
+    coro_st::barrier<> bar{ 2 };
+
+    auto task = bar.async_arrive_and_wait();
+
+    auto awaiter = task.get_work().get_awaiter(tl.ctx);
+
+    awaiter.start();
+
+    tl.stop_source.request_stop();
+
+    ASSERT_FALSE(tl.el.ready_queue_.empty());
+
+    // the arrival of the cancelled waiter is still counted
+    bar.arrive_and_drop();
+    ASSERT_EQ(1, bar.phase());
+
+    ASSERT_FALSE(tl.result_ready);
+    ASSERT_FALSE(tl.stopped);
+    tl.run_one_ready();
+    ASSERT_FALSE(tl.result_ready);
+    ASSERT_TRUE(tl.stopped);
+  }
+
+  struct barrier_usage_completion
+  {
+    std::vector<int>* log;
+
+    void operator()() const noexcept
+    {
+      log->push_back(-1);
+    }
+  };
+
+  struct barrier_usage_data
+  {
+    std::vector<int> log;
+    coro_st::barrier<barrier_usage_completion> bar{ 2, barrier_usage_completion{ &log } };
+  };
+
+  coro_st::co<void> async_barrier_worker(barrier_usage_data& data, int id, int yields)
+  {
+    for (int phase = 0; phase < 3; ++phase)
+    {
+      for (int i = 0; i < yields; ++i)
+      {
+        co_await coro_st::async_yield();
+      }
+      data.log.push_back(id);
+      co_await data.bar.async_arrive_and_wait();
+    }
+  }
+
+  TEST(barrier_usage)
+  {
+    barrier_usage_data data;
+    auto result = coro_st::run(
+      coro_st::async_wait_all(
+        async_barrier_worker(data, 1, 0),
+        async_barrier_worker(data, 2, 3)));
+    ASSERT_TRUE(result.has_value());
+    // workers never run ahead of the slow one by more than a phase
+    std::vector<int> expected{ 1, 2, -1, 1, 2, -1, 1, 2, -1 };
+    ASSERT_TRUE(expected == data.log);
+    ASSERT_EQ(3, data.bar.phase());
+  }
+} // anonymous namespace
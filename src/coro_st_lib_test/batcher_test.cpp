@@ -0,0 +1,158 @@
+#include "../test_lib/test.h"
+
+#include "../coro_st_lib/batcher.h"
+
+#include "../coro_st_lib/co.h"
+#include "../coro_st_lib/coro_type_traits.h"
+#include "../coro_st_lib/run.h"
+#include "../coro_st_lib/wait_all.h"
+#include "../coro_st_lib/yield.h"
+
+#include "test_loop.h"
+
+#include <chrono>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+  int flush_count = 0;
+
+  void twice_flush(std::span<int> items, std::span<int> results)
+  {
+    ++flush_count;
+    for (size_t i = 0; i < items.size(); ++i)
+    {
+      results[i] = items[i] * 2;
+    }
+  }
+
+  void throw_flush(std::span<int>, std::span<int>)
+  {
+    throw std::runtime_error("Ups!");
+  }
+
+  static_assert(
+    coro_st::is_co_task<
+      coro_st::batcher<int, int>::batcher_add_task>);
+
+  TEST(batcher_chain_root_size)
+  {
+    coro_st_test::test_loop tl;
+    flush_count = 0;
+
+    coro_st::batcher<int, int> b{ 2, std::chrono::hours(1), &twice_flush };
+
+    auto task1 = b.async_add(20);
+    auto awaiter1 = task1.get_work().get_awaiter(tl.ctx);
+    awaiter1.start();
+
+    // the first item arms the timer
+    ASSERT_EQ(1, b.size());
+    ASSERT_FALSE(tl.el.timers_heap_.empty());
+    ASSERT_FALSE(tl.result_ready);
+
+    coro_st_test::test_loop tl2;
+    auto task2 = b.async_add(21);
+    auto awaiter2 = task2.get_work().get_awaiter(tl2.ctx);
+    awaiter2.start();
+
+    // the last item flushes and completes immediately
+    ASSERT_EQ(1, flush_count);
+    ASSERT_EQ(0, b.size());
+    ASSERT_TRUE(tl.el.timers_heap_.empty());
+    ASSERT_TRUE(tl2.result_ready);
+    ASSERT_EQ(42, awaiter2.await_resume());
+
+    ASSERT_FALSE(tl.result_ready);
+    tl.run_one_ready();
+    ASSERT_TRUE(tl.result_ready);
+    ASSERT_EQ(40, awaiter1.await_resume());
+  }
+
+  TEST(batcher_chain_root_timer)
+  {
+    coro_st_test::test_loop tl;
+    flush_count = 0;
+
+    coro_st::batcher<int, int> b{ 10, std::chrono::hours(1), &twice_flush };
+
+    auto task = b.async_add(21);
+    auto awaiter = task.get_work().get_awaiter(tl.ctx);
+    awaiter.start();
+
+    ASSERT_TRUE(tl.el.ready_queue_.empty());
+    tl.run_one_timer();
+    ASSERT_EQ(1, flush_count);
+
+    ASSERT_FALSE(tl.result_ready);
+    tl.run_one_ready();
+    ASSERT_TRUE(tl.result_ready);
+    ASSERT_FALSE(tl.stopped);
+    ASSERT_EQ(42, awaiter.await_resume());
+  }
+
+  TEST(batcher_chain_root_cancellation)
+  {
+    coro_st_test::test_loop tl;
+
+    coro_st::batcher<int, int> b{ 10, std::chrono::hours(1), &twice_flush };
+
+    auto task = b.async_add(21);
+    auto awaiter = task.get_work().get_awaiter(tl.ctx);
+    awaiter.start();
+
+    tl.stop_source.request_stop();
+
+    // the item is removed, with it the timer
+    ASSERT_EQ(0, b.size());
+    ASSERT_TRUE(tl.el.timers_heap_.empty());
+
+    tl.run_one_ready();
+    ASSERT_FALSE(tl.result_ready);
+    ASSERT_TRUE(tl.stopped);
+  }
+
+  TEST(batcher_chain_root_exception)
+  {
+    coro_st_test::test_loop tl;
+
+    coro_st::batcher<int, int> b{ 1, std::chrono::hours(1), &throw_flush };
+
+    auto task = b.async_add(21);
+    auto awaiter = task.get_work().get_awaiter(tl.ctx);
+    awaiter.start();
+
+    ASSERT_TRUE(tl.result_ready);
+    ASSERT_NE(nullptr, awaiter.get_result_exception());
+    ASSERT_THROW_WHAT(awaiter.await_resume(), std::runtime_error, "Ups!");
+  }
+
+  coro_st::co<int> async_producer(coro_st::batcher<int, int>& b, int value)
+  {
+    co_await coro_st::async_yield();
+    co_return co_await b.async_add(value);
+  }
+
+  TEST(batcher_usage)
+  {
+    flush_count = 0;
+    coro_st::batcher<int, int> b{ 2, std::chrono::milliseconds(1), &twice_flush };
+
+    // two batches by size, the last by time
+    auto result = coro_st::run(
+      coro_st::async_wait_all(
+        async_producer(b, 1),
+        async_producer(b, 2),
+        async_producer(b, 3),
+        async_producer(b, 4),
+        async_producer(b, 5))).value();
+    ASSERT_EQ(3, flush_count);
+    ASSERT_EQ(2, std::get<0>(result));
+    ASSERT_EQ(4, std::get<1>(result));
+    ASSERT_EQ(6, std::get<2>(result));
+    ASSERT_EQ(8, std::get<3>(result));
+    ASSERT_EQ(10, std::get<4>(result));
+  }
+} // anonymous namespace
@@ -0,0 +1,213 @@
+#include "../test_lib/test.h"
+
+#include "../coro_st_lib/buffered_stream.h"
+
+#include "../coro_st_lib/coro_st.h"
+
+#include "test_loop.h"
+
+#include <array>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+  static_assert(coro_st::is_co_task<coro_st::read_until_task>);
+  static_assert(coro_st::is_co_task<coro_st::read_exact_task>);
+  static_assert(coro_st::is_co_task<coro_st::buffered_write_task>);
+  static_assert(coro_st::is_co_task<coro_st::buffered_flush_task>);
+
+  struct test_pipe
+  {
+    coro_st::fd_handle read_end;
+    coro_st::fd_handle write_end;
+
+    test_pipe()
+    {
+      int fds[2];
+      ASSERT_EQ(0, ::pipe2(fds, O_NONBLOCK | O_CLOEXEC));
+      read_end.reset(fds[0]);
+      write_end.reset(fds[1]);
+    }
+  };
+
+  TEST(buffered_reader_read_until_buffered)
+  {
+    coro_st_test::test_loop tl;
+    test_pipe p;
+    coro_st::buffered_reader reader{ p.read_end };
+
+    ASSERT_EQ(8, ::write(p.write_end.get(), "ab\ncd\nef", 8));
+    {
+      auto task = reader.async_read_until('\n');
+      auto awaiter = task.get_work().get_awaiter(tl.ctx);
+      awaiter.start();
+      ASSERT_TRUE(tl.result_ready);
+      ASSERT_EQ("ab\n", awaiter.await_resume());
+    }
+    // from the buffer, no read
+    ASSERT_EQ("cd\nef", reader.buffered());
+    tl.result_ready = false;
+    {
+      auto task = reader.async_read_until('\n');
+      auto awaiter = task.get_work().get_awaiter(tl.ctx);
+      awaiter.start();
+      ASSERT_TRUE(tl.result_ready);
+      ASSERT_EQ("cd\n", awaiter.await_resume());
+    }
+    tl.result_ready = false;
+    {
+      auto task = reader.async_read_until('\n');
+      auto awaiter = task.get_work().get_awaiter(tl.ctx);
+      awaiter.start();
+      ASSERT_FALSE(tl.result_ready);
+      ASSERT_EQ(1, tl.el.poller_.size());
+
+      ASSERT_EQ(3, ::write(p.write_end.get(), "g\nh", 3));
+      tl.run_io();
+      ASSERT_TRUE(tl.result_ready);
+      ASSERT_TRUE(tl.el.poller_.empty());
+      ASSERT_EQ("efg\n", awaiter.await_resume());
+    }
+    ASSERT_EQ("h", reader.buffered());
+  }
+
+  TEST(buffered_reader_read_until_end_of_file)
+  {
+    test_pipe p;
+    coro_st::buffered_reader reader{ p.read_end };
+
+    ASSERT_EQ(4, ::write(p.write_end.get(), "a\nbc", 4));
+    p.write_end.reset();
+
+    ASSERT_EQ("a\n", reader.try_read_until('\n').value());
+    ASSERT_EQ("bc", reader.try_read_until('\n').value());
+    ASSERT_EQ("", reader.try_read_until('\n').value());
+  }
+
+  TEST(buffered_reader_read_until_full)
+  {
+    test_pipe p;
+    coro_st::buffered_reader reader{ p.read_end, 4 };
+
+    ASSERT_EQ(5, ::write(p.write_end.get(), "abcd\n", 5));
+    ASSERT_THROW(static_cast<void>(reader.try_read_until('\n')), std::length_error);
+  }
+
+  TEST(buffered_reader_read_exact)
+  {
+    test_pipe p;
+    coro_st::buffered_reader reader{ p.read_end, 8 };
+
+    ASSERT_EQ(6, ::write(p.write_end.get(), "abcdef", 6));
+    ASSERT_EQ("abcd", reader.try_read_exact(4).value());
+    // would block
+    ASSERT_FALSE(reader.try_read_exact(4).has_value());
+    // moves "ef" to the start to make room
+    ASSERT_EQ(6, ::write(p.write_end.get(), "ghijkl", 6));
+    ASSERT_EQ("efghijkl", reader.try_read_exact(8).value());
+    ASSERT_THROW(static_cast<void>(reader.try_read_exact(9)), std::length_error);
+
+    ASSERT_EQ(1, ::write(p.write_end.get(), "m", 1));
+    p.write_end.reset();
+    ASSERT_EQ("m", reader.try_read_exact(2).value());
+  }
+
+  TEST(buffered_reader_cancel)
+  {
+    coro_st_test::test_loop tl;
+    test_pipe p;
+    coro_st::buffered_reader reader{ p.read_end };
+
+    auto task = reader.async_read_exact(4);
+    auto awaiter = task.get_work().get_awaiter(tl.ctx);
+
+    awaiter.start();
+    ASSERT_EQ(1, tl.el.poller_.size());
+
+    tl.stop_source.request_stop();
+    ASSERT_TRUE(tl.el.poller_.empty());
+    tl.run_one_ready();
+    ASSERT_TRUE(tl.stopped);
+  }
+
+  TEST(buffered_writer_coalesces)
+  {
+    test_pipe p;
+    coro_st::buffered_writer writer{ p.write_end, 8 };
+
+    std::span<const char> data = std::string_view{ "abc" };
+    ASSERT_TRUE(writer.try_write(data));
+    data = std::string_view{ "def" };
+    ASSERT_TRUE(writer.try_write(data));
+    // nothing written yet
+    std::array<char, 32> buffer;
+    ASSERT_EQ(-1, ::read(p.read_end.get(), buffer.data(), buffer.size()));
+    ASSERT_EQ("abcdef", writer.buffered());
+
+    // does not fit, written together with the buffered data
+    data = std::string_view{ "0123456789" };
+    ASSERT_TRUE(writer.try_write(data));
+    ASSERT_TRUE(writer.buffered().empty());
+    ASSERT_EQ(16, ::read(p.read_end.get(), buffer.data(), buffer.size()));
+    ASSERT_EQ("abcdef0123456789", std::string_view(buffer.data(), 16));
+
+    data = std::string_view{ "xy" };
+    ASSERT_TRUE(writer.try_write(data));
+    ASSERT_TRUE(writer.try_flush());
+    ASSERT_EQ(2, ::read(p.read_end.get(), buffer.data(), buffer.size()));
+    ASSERT_EQ("xy", std::string_view(buffer.data(), 2));
+  }
+
+  coro_st::co<void> async_write_lines(coro_st::buffered_writer& writer, size_t count)
+  {
+    for (size_t i = 0; i < count; ++i)
+    {
+      std::string line = std::to_string(i) + "\n";
+      co_await writer.async_write(line);
+    }
+    co_await writer.async_flush();
+  }
+
+  coro_st::co<size_t> async_read_lines(coro_st::buffered_reader& reader)
+  {
+    size_t count = 0;
+    while (true)
+    {
+      std::string_view line = co_await reader.async_read_until('\n');
+      if (line.empty())
+      {
+        co_return count;
+      }
+      ASSERT_EQ(std::to_string(count) + "\n", line);
+      ++count;
+    }
+  }
+
+  coro_st::co<size_t> async_write_and_read_lines(test_pipe& p, size_t count)
+  {
+    coro_st::buffered_writer writer{ p.write_end, 1024 };
+    coro_st::buffered_reader reader{ p.read_end, 1000 };
+    auto result = co_await coro_st::async_wait_all(
+      std::invoke([](coro_st::buffered_writer& writer, test_pipe& p, size_t count)
+        -> coro_st::co<void> {
+        co_await async_write_lines(writer, count);
+        p.write_end.reset();
+      }, writer, p, count),
+      async_read_lines(reader));
+    co_return std::get<1>(result);
+  }
+
+  TEST(buffered_stream_lines_run)
+  {
+    // more than the pipe buffer, the writer has to wait for the reader
+    test_pipe p;
+    size_t count = coro_st::run(async_write_and_read_lines(p, 100'000)).value();
+    ASSERT_EQ(100'000, count);
+  }
+} // anonymous namespace
@@ -9,9 +9,11 @@ namespace
     coro_st::stop_source stop_source;
 
     coro_st::ready_queue q;
+    coro_st::ready_heap rh;
     coro_st::timer_heap h;
+    coro_st::loop_clock c;
 
-    coro_st::event_loop_context event_loop_context{ q, h };
+    coro_st::event_loop_context event_loop_context{ q, rh, h, c };
 
     struct completion_flags
     {
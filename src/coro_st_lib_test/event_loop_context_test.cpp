@@ -7,9 +7,11 @@ namespace
   TEST(event_loop_context_ready_node)
   {
     coro_st::ready_queue q;
+    coro_st::ready_heap rh;
     coro_st::timer_heap h;
+    coro_st::loop_clock c;
 
-    coro_st::event_loop_context event_loop_context{ q, h };
+    coro_st::event_loop_context event_loop_context{ q, rh, h, c };
 
     bool called{ false };
 
@@ -32,12 +34,33 @@ namespace
     ASSERT_TRUE(q.empty());
   }
 
+  TEST(event_loop_context_deadline_ready_node_without_deadline_scheduling)
+  {
+    coro_st::ready_queue q;
+    coro_st::ready_heap rh;
+    coro_st::timer_heap h;
+    coro_st::loop_clock c;
+
+    coro_st::event_loop_context event_loop_context{ q, rh, h, c };
+
+    // the default loop hooks policy: the deadline is ignored
+    coro_st::deadline_ready_node node;
+    node.cb = coro_st::callback(&node, +[](void*) noexcept {});
+    node.deadline = std::chrono::steady_clock::now();
+    event_loop_context.push_ready_node(node);
+
+    ASSERT_TRUE(rh.empty());
+    ASSERT_EQ(&node, q.pop());
+  }
+
   TEST(event_loop_context_timer_node)
   {
     coro_st::ready_queue q;
+    coro_st::ready_heap rh;
     coro_st::timer_heap h;
+    coro_st::loop_clock c;
 
-    coro_st::event_loop_context event_loop_context{ q, h };
+    coro_st::event_loop_context event_loop_context{ q, rh, h, c };
 
     bool called{ false };
 
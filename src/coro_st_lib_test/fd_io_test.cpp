@@ -0,0 +1,329 @@
+#include "../test_lib/test.h"
+
+#include "../coro_st_lib/fd_io.h"
+
+#include "../coro_st_lib/coro_st.h"
+
+#include "test_loop.h"
+
+#include <array>
+#include <chrono>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace
+{
+  static_assert(coro_st::is_co_task<coro_st::read_some_task>);
+  static_assert(coro_st::is_co_task<coro_st::write_some_task>);
+
+  struct test_pipe
+  {
+    coro_st::fd_handle read_end;
+    coro_st::fd_handle write_end;
+
+    test_pipe()
+    {
+      int fds[2];
+      ASSERT_EQ(0, ::pipe2(fds, O_NONBLOCK | O_CLOEXEC));
+      read_end.reset(fds[0]);
+      write_end.reset(fds[1]);
+    }
+  };
+
+  struct test_socketpair
+  {
+    coro_st::fd_handle a;
+    coro_st::fd_handle b;
+
+    test_socketpair()
+    {
+      int fds[2];
+      ASSERT_EQ(0, ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds));
+      a.reset(fds[0]);
+      b.reset(fds[1]);
+    }
+
+    // until a write on a would block
+    void fill_a()
+    {
+      std::array<char, 4096> buffer{};
+      while (::write(a.get(), buffer.data(), buffer.size()) > 0)
+      {
+      }
+    }
+
+    void drain_b()
+    {
+      std::array<char, 4096> buffer;
+      while (::read(b.get(), buffer.data(), buffer.size()) > 0)
+      {
+      }
+    }
+  };
+
+  TEST(fd_io_read_some_chain_root)
+  {
+    coro_st_test::test_loop tl;
+    test_pipe p;
+
+    std::array<char, 16> buffer;
+    auto task = coro_st::async_read_some(p.read_end.get(), buffer);
+    auto awaiter = task.get_work().get_awaiter(tl.ctx);
+
+    awaiter.start();
+    ASSERT_FALSE(tl.result_ready);
+    ASSERT_EQ(1, tl.el.poller_.size());
+
+    ASSERT_EQ(3, ::write(p.write_end.get(), "abc", 3));
+    tl.run_io();
+    ASSERT_TRUE(tl.result_ready);
+    ASSERT_TRUE(tl.el.poller_.empty());
+    ASSERT_EQ(3, awaiter.await_resume());
+    ASSERT_EQ("abc", std::string_view(buffer.data(), 3));
+  }
+
+  TEST(fd_io_read_some_immediate)
+  {
+    coro_st_test::test_loop tl;
+    test_pipe p;
+
+    ASSERT_EQ(3, ::write(p.write_end.get(), "abc", 3));
+    p.write_end.reset();
+
+    std::array<char, 2> buffer;
+    {
+      auto task = coro_st::async_read_some(p.read_end.get(), buffer);
+      auto awaiter = task.get_work().get_awaiter(tl.ctx);
+      awaiter.start();
+      ASSERT_TRUE(tl.result_ready);
+      ASSERT_EQ(2, awaiter.await_resume());
+    }
+    tl.result_ready = false;
+    {
+      auto task = coro_st::async_read_some(p.read_end.get(), buffer);
+      auto awaiter = task.get_work().get_awaiter(tl.ctx);
+      awaiter.start();
+      ASSERT_TRUE(tl.result_ready);
+      ASSERT_EQ(1, awaiter.await_resume());
+    }
+    tl.result_ready = false;
+    {
+      auto task = coro_st::async_read_some(p.read_end.get(), buffer);
+      auto awaiter = task.get_work().get_awaiter(tl.ctx);
+      awaiter.start();
+      ASSERT_TRUE(tl.result_ready);
+      // end of file
+      ASSERT_EQ(0, awaiter.await_resume());
+    }
+    ASSERT_TRUE(tl.el.poller_.empty());
+  }
+
+  TEST(fd_io_read_some_cancel)
+  {
+    coro_st_test::test_loop tl;
+    test_pipe p;
+
+    std::array<char, 16> buffer;
+    auto task = coro_st::async_read_some(p.read_end.get(), buffer);
+    auto awaiter = task.get_work().get_awaiter(tl.ctx);
+
+    awaiter.start();
+    ASSERT_EQ(1, tl.el.poller_.size());
+
+    tl.stop_source.request_stop();
+    ASSERT_TRUE(tl.el.poller_.empty());
+    tl.run_one_ready();
+    ASSERT_TRUE(tl.stopped);
+  }
+
+  TEST(fd_io_read_some_error)
+  {
+    coro_st_test::test_loop tl;
+    test_pipe p;
+
+    // can't read from the write end
+    std::array<char, 16> buffer;
+    auto task = coro_st::async_read_some(p.write_end.get(), buffer);
+    auto awaiter = task.get_work().get_awaiter(tl.ctx);
+
+    awaiter.start();
+    ASSERT_TRUE(tl.result_ready);
+    ASSERT_NE(nullptr, awaiter.get_result_exception());
+    ASSERT_THROW(static_cast<void>(awaiter.await_resume()), std::system_error);
+  }
+
+  TEST(fd_io_read_and_write_same_fd)
+  {
+    coro_st_test::test_loop tl;
+    test_socketpair sp;
+    sp.fill_a();
+
+    std::array<char, 16> buffer;
+    auto read_task = coro_st::async_read_some(sp.a.get(), buffer);
+    auto read_awaiter = read_task.get_work().get_awaiter(tl.ctx);
+    std::string_view data{ "xyz" };
+    auto write_task = coro_st::async_write_some(sp.a.get(), data);
+    auto write_awaiter = write_task.get_work().get_awaiter(tl.ctx);
+
+    read_awaiter.start();
+    write_awaiter.start();
+    ASSERT_FALSE(tl.result_ready);
+    // a reader and a writer for the same fd
+    ASSERT_EQ(2, tl.el.poller_.size());
+
+    ASSERT_EQ(3, ::write(sp.b.get(), "abc", 3));
+    tl.run_io();
+    ASSERT_TRUE(tl.result_ready);
+    ASSERT_EQ(1, tl.el.poller_.size());
+    ASSERT_EQ(3, read_awaiter.await_resume());
+    ASSERT_EQ("abc", std::string_view(buffer.data(), 3));
+
+    tl.result_ready = false;
+    sp.drain_b();
+    tl.run_io();
+    ASSERT_TRUE(tl.result_ready);
+    ASSERT_TRUE(tl.el.poller_.empty());
+    ASSERT_TRUE(write_awaiter.await_resume() > 0);
+  }
+
+  coro_st::co<size_t> async_peer(int fd, size_t count)
+  {
+    co_await coro_st::async_write_all(fd, std::string_view{ "abc" });
+    std::array<char, 4096> buffer;
+    size_t total = 0;
+    while (total < count)
+    {
+      total += co_await coro_st::async_read_some(fd, buffer);
+    }
+    co_return total;
+  }
+
+  coro_st::co<size_t> async_read_while_writing(int fd, int peer_fd)
+  {
+    std::array<char, 16> buffer;
+    // more than the socket buffer, the write waits while the read waits
+    std::string data(1024 * 1024, 'x');
+    auto [read_count, write_result, peer_count] = co_await coro_st::async_wait_all(
+      coro_st::async_read_some(fd, buffer),
+      coro_st::async_write_all(fd, data),
+      async_peer(peer_fd, data.size()));
+    static_cast<void>(write_result);
+    ASSERT_EQ(data.size(), peer_count);
+    co_return read_count;
+  }
+
+  TEST(fd_io_read_and_write_same_fd_run)
+  {
+    test_socketpair sp;
+    auto result = coro_st::run(
+      async_read_while_writing(sp.a.get(), sp.b.get())).value();
+    ASSERT_EQ(3, result);
+  }
+
+  coro_st::co<std::string> async_write_and_read(int read_fd, int write_fd, std::string data)
+  {
+    // more than the pipe buffer, the writer has to wait for the reader
+    std::string result;
+    co_await coro_st::async_wait_all(
+      std::invoke([](int fd, std::string& data) -> coro_st::co<void> {
+        co_await coro_st::async_write_all(fd, data);
+        ::close(fd);
+      }, write_fd, data),
+      std::invoke([](int fd, std::string& result) -> coro_st::co<void> {
+        std::array<char, 4096> buffer;
+        while (true)
+        {
+          size_t count = co_await coro_st::async_read_some(fd, buffer);
+          if (0 == count)
+          {
+            co_return;
+          }
+          result.append(buffer.data(), count);
+        }
+      }, read_fd, result)
+    );
+    co_return result;
+  }
+
+  TEST(fd_io_write_all_run)
+  {
+    test_pipe p;
+    std::string data(1024 * 1024, 'x');
+    auto result = coro_st::run(
+      async_write_and_read(p.read_end.get(), p.write_end.release(), data)).value();
+    ASSERT_EQ(data.size(), result.size());
+  }
+
+  coro_st::co<void> async_short_sleeps(int count)
+  {
+    for (int i = 0; i < count; ++i)
+    {
+      co_await coro_st::async_sleep_for(std::chrono::microseconds(100));
+    }
+  }
+
+  TEST(fd_io_sub_millisecond_sleep_while_waiting)
+  {
+    test_pipe p;
+    std::array<char, 16> buffer;
+    constexpr int count = 20;
+
+    // the sleeps go through epoll while the read waits, rounded up to a
+    // millisecond each they would take at least count milliseconds
+    auto start = std::chrono::steady_clock::now();
+    auto result = coro_st::run(coro_st::async_wait_any(
+      coro_st::async_read_some(p.read_end.get(), buffer),
+      async_short_sleeps(count))).value();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    ASSERT_EQ(1, result.index);
+    ASSERT_TRUE(elapsed < std::chrono::milliseconds(count));
+  }
+
+  // The fd of the epoll instance, via /proc
+  int find_epoll_fd()
+  {
+    for (int fd = 0; fd < 1024; ++fd)
+    {
+      std::string path = "/proc/self/fd/" + std::to_string(fd);
+      std::array<char, PATH_MAX> target{};
+      ssize_t size = ::readlink(path.c_str(), target.data(), target.size() - 1);
+      if ((size > 0) && (std::string_view{ target.data(), static_cast<size_t>(size) } == "anon_inode:[eventpoll]"))
+      {
+        return fd;
+      }
+    }
+    return -1;
+  }
+
+  coro_st::co<void> async_break_poller(int& broken_fd)
+  {
+    // the read registered the fd, the epoll instance exists
+    co_await coro_st::async_yield();
+    broken_fd = find_epoll_fd();
+    coro_st::fd_handle not_epoll{ ::open("/dev/null", O_RDONLY | O_CLOEXEC) };
+    ::dup2(not_epoll.get(), broken_fd);
+  }
+
+  TEST(fd_io_poller_wait_error)
+  {
+    test_pipe p;
+    std::array<char, 16> buffer;
+    int broken_fd = -1;
+
+    // the read fails with the error instead of the loop terminating
+    ASSERT_THROW(
+      coro_st::run(coro_st::async_wait_all(
+        coro_st::async_read_some(p.read_end.get(), buffer),
+        async_break_poller(broken_fd))),
+      std::system_error);
+    ASSERT_NE(-1, broken_fd);
+  }
+} // anonymous namespace
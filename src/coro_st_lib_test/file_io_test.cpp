@@ -0,0 +1,160 @@
+#include "../test_lib/test.h"
+
+#include "../coro_st_lib/file_io.h"
+
+#include "../coro_st_lib/coro_st.h"
+
+#include "test_loop.h"
+
+#include <array>
+#include <cstdlib>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+  static_assert(coro_st::is_co_task<coro_st::file_read_task>);
+  static_assert(coro_st::is_co_task<coro_st::file_write_task>);
+
+  // Deleted when closed
+  coro_st::fd_handle make_temp_file()
+  {
+    char name[] = "/tmp/coro_st_file_io_test_XXXXXX";
+    coro_st::fd_handle fd{ ::mkstemp(name) };
+    ASSERT_TRUE(fd.is_valid());
+    ASSERT_EQ(0, ::unlink(name));
+    return fd;
+  }
+
+  coro_st::co<std::string> async_write_then_read(coro_st::fd_arg fd)
+  {
+    std::string_view hello = "hello";
+    std::string_view world = "world";
+    size_t count = co_await coro_st::async_file_write(fd, 6, world);
+    ASSERT_EQ(5, count);
+    count = co_await coro_st::async_file_write(fd, 0, hello);
+    ASSERT_EQ(5, count);
+    count = co_await coro_st::async_file_write(fd, 5, std::string_view{ " " });
+    ASSERT_EQ(1, count);
+
+    std::array<char, 32> buffer;
+    // short read at end of file
+    count = co_await coro_st::async_file_read(fd, 0, buffer);
+    co_return std::string(buffer.data(), count);
+  }
+
+  TEST(file_io_write_then_read)
+  {
+    coro_st::file_io_pool pool{ 2 };
+    auto fd = make_temp_file();
+    auto result = coro_st::run(
+      async_write_then_read(fd),
+      coro_st::run_options{ .file_io = &pool }).value();
+    ASSERT_EQ("hello world", result);
+    ASSERT_EQ(0, pool.in_flight());
+  }
+
+  coro_st::co<std::string> async_read_parts(coro_st::fd_arg fd)
+  {
+    std::array<char, 3> a;
+    std::array<char, 3> b;
+    std::array<char, 3> c;
+    auto result = co_await coro_st::async_wait_all(
+      coro_st::async_file_read(fd, 6, c),
+      coro_st::async_file_read(fd, 0, a),
+      coro_st::async_file_read(fd, 3, b));
+    ASSERT_EQ(3, std::get<0>(result));
+    ASSERT_EQ(3, std::get<1>(result));
+    ASSERT_EQ(3, std::get<2>(result));
+    co_return std::string(a.data(), 3) + std::string(b.data(), 3) + std::string(c.data(), 3);
+  }
+
+  TEST(file_io_concurrent_reads)
+  {
+    coro_st::file_io_pool pool{ 2 };
+    auto fd = make_temp_file();
+    ASSERT_EQ(9, ::write(fd.get(), "abcdefghi", 9));
+    auto result = coro_st::run(
+      async_read_parts(fd),
+      coro_st::run_options{ .file_io = &pool }).value();
+    ASSERT_EQ("abcdefghi", result);
+  }
+
+  TEST(file_io_error)
+  {
+    coro_st::file_io_pool pool{ 1 };
+    auto fd = make_temp_file();
+    coro_st::fd_handle read_only{ ::open("/dev/null", O_RDONLY | O_CLOEXEC) };
+    ASSERT_TRUE(read_only.is_valid());
+    ASSERT_THROW(
+      static_cast<void>(coro_st::run(
+        coro_st::async_file_write(read_only, 0, std::string_view{ "abc" }),
+        coro_st::run_options{ .file_io = &pool })),
+      std::system_error);
+  }
+
+  TEST(file_io_no_pool)
+  {
+    auto fd = make_temp_file();
+    std::array<char, 3> buffer;
+    ASSERT_THROW(
+      static_cast<void>(coro_st::run(coro_st::async_file_read(fd, 0, buffer))),
+      std::logic_error);
+  }
+
+  TEST(file_io_chain_root_stopped_before_start)
+  {
+    coro_st::file_io_pool pool{ 1 };
+    coro_st_test::test_loop tl;
+    tl.el_ctx.set_file_io_pool(&pool);
+    auto fd = make_temp_file();
+
+    std::array<char, 3> buffer;
+    auto task = coro_st::async_file_read(fd, 0, buffer);
+    auto awaiter = task.get_work().get_awaiter(tl.ctx);
+
+    tl.stop_source.request_stop();
+    awaiter.start();
+    ASSERT_TRUE(tl.stopped);
+    ASSERT_EQ(0, pool.in_flight());
+  }
+
+  TEST(file_io_chain_root_cancel)
+  {
+    coro_st::file_io_pool pool{ 1 };
+    coro_st_test::test_loop tl;
+    tl.el_ctx.set_file_io_pool(&pool);
+    auto fd = make_temp_file();
+
+    std::array<char, 3> buffer;
+    auto task = coro_st::async_file_read(fd, 0, buffer);
+    auto awaiter = task.get_work().get_awaiter(tl.ctx);
+
+    awaiter.start();
+    ASSERT_EQ(1, pool.in_flight());
+    ASSERT_EQ(1, tl.el.poller_.size());
+
+    tl.stop_source.request_stop();
+    // either still queued, or it completes as stopped when done
+    while (!tl.stopped)
+    {
+      if (!tl.el.ready_queue_.empty())
+      {
+        tl.run_one_ready();
+      }
+      else
+      {
+        tl.run_io(std::chrono::milliseconds(10));
+      }
+    }
+    ASSERT_FALSE(tl.result_ready);
+    ASSERT_EQ(0, pool.in_flight());
+    ASSERT_TRUE(tl.el.poller_.empty());
+  }
+} // anonymous namespace
@@ -0,0 +1,130 @@
+#include "../test_lib/test.h"
+
+#include "../coro_st_lib/latch.h"
+
+#include "../coro_st_lib/co.h"
+#include "../coro_st_lib/coro_type_traits.h"
+#include "../coro_st_lib/run.h"
+#include "../coro_st_lib/wait_all.h"
+#include "../coro_st_lib/yield.h"
+
+#include "test_loop.h"
+
+namespace
+{
+  static_assert(
+    coro_st::is_co_task<
+      coro_st::latch::latch_wait_task>);
+
+  TEST(latch_chain_root)
+  {
+    coro_st_test::test_loop tl;
+
+    coro_st::latch ltch{ 2 };
+    ASSERT_FALSE(ltch.try_wait());
+
+    auto task = ltch.async_wait();
+
+    auto awaiter = task.get_work().get_awaiter(tl.ctx);
+
+    awaiter.start();
+
+    ASSERT_TRUE(tl.el.ready_queue_.empty());
+    ASSERT_TRUE(tl.el.timers_heap_.empty());
+
+    ltch.count_down();
+    ASSERT_FALSE(ltch.try_wait());
+    ASSERT_TRUE(tl.el.ready_queue_.empty());
+
+    ltch.count_down();
+    ASSERT_TRUE(ltch.try_wait());
+
+    ASSERT_FALSE(tl.el.ready_queue_.empty());
+    ASSERT_TRUE(tl.el.timers_heap_.empty());
+
+    ASSERT_FALSE(tl.result_ready);
+    ASSERT_FALSE(tl.stopped);
+    tl.run_one_ready();
+    ASSERT_TRUE(tl.result_ready);
+    ASSERT_FALSE(tl.stopped);
+  }
+
+  TEST(latch_chain_root_last_arrival)
+  {
+    coro_st_test::test_loop tl;
+
+    coro_st::latch ltch{ 1 };
+
+    auto task = ltch.async_arrive_and_wait();
+
+    auto awaiter = task.get_work().get_awaiter(tl.ctx);
+
+    awaiter.start();
+
+    // the last arrival completes immediately
+    ASSERT_TRUE(tl.el.ready_queue_.empty());
+    ASSERT_TRUE(tl.result_ready);
+    ASSERT_FALSE(tl.stopped);
+    ASSERT_TRUE(ltch.try_wait());
+  }
+
+  TEST(latch_chain_root_cancellation)
+  {
+    coro_st_test::test_loop tl;
+
+    coro_st::latch ltch{ 2 };
+
+    auto task = ltch.async_arrive_and_wait();
+
+    auto awaiter = task.get_work().get_awaiter(tl.ctx);
+
+    awaiter.start();
+
+    tl.stop_source.request_stop();
+
+    ASSERT_FALSE(tl.el.ready_queue_.empty());
+
+    ltch.count_down();
+    ASSERT_TRUE(ltch.try_wait());
+
+    ASSERT_FALSE(tl.result_ready);
+    ASSERT_FALSE(tl.stopped);
+    tl.run_one_ready();
+    ASSERT_FALSE(tl.result_ready);
+    ASSERT_TRUE(tl.stopped);
+  }
+
+  struct latch_usage_data
+  {
+    coro_st::latch ltch{ 3 };
+    int started{ 0 };
+    int passed{ 0 };
+  };
+
+  coro_st::co<void> async_latch_worker(latch_usage_data& data, int yields)
+  {
+    for (int i = 0; i < yields; ++i)
+    {
+      co_await coro_st::async_yield();
+    }
+    ++data.started;
+    co_await data.ltch.async_arrive_and_wait();
+    // all workers arrived before any passes
+    if (data.started == 3)
+    {
+      ++data.passed;
+    }
+  }
+
+  TEST(latch_usage)
+  {
+    latch_usage_data data;
+    auto result = coro_st::run(
+      coro_st::async_wait_all(
+        async_latch_worker(data, 2),
+        async_latch_worker(data, 0),
+        async_latch_worker(data, 1)));
+    ASSERT_TRUE(result.has_value());
+    ASSERT_EQ(3, data.passed);
+  }
+} // anonymous namespace
@@ -0,0 +1,86 @@
+#include "../test_lib/test.h"
+
+#include "../coro_st_lib/loop_clock.h"
+
+#include "../coro_st_lib/event_loop.h"
+
+#include <chrono>
+
+namespace
+{
+  std::chrono::steady_clock::time_point fake_time{};
+
+  std::chrono::steady_clock::time_point fake_now() noexcept
+  {
+    return fake_time;
+  }
+
+  TEST(loop_clock_cached)
+  {
+    fake_time = std::chrono::steady_clock::time_point{ std::chrono::seconds(1) };
+
+    coro_st::loop_clock c{ &fake_now };
+    ASSERT_TRUE(fake_time == c.now());
+
+    auto old_time = fake_time;
+    fake_time += std::chrono::seconds(1);
+
+    // the time does not change until refreshed
+    ASSERT_TRUE(old_time == c.now());
+    ASSERT_TRUE(fake_time == c.refresh());
+    ASSERT_TRUE(fake_time == c.now());
+  }
+
+  TEST(loop_clock_event_loop)
+  {
+    fake_time = std::chrono::steady_clock::time_point{ std::chrono::seconds(1) };
+
+    coro_st::event_loop el{ &fake_now };
+
+    fake_time += std::chrono::seconds(1);
+
+    // refreshed once at the start of the iteration
+    ASSERT_FALSE(el.do_current_pending_work().has_value());
+    ASSERT_TRUE(fake_time == el.clock_.now());
+  }
+
+  TEST(loop_clock_virtual)
+  {
+    coro_st::loop_clock c{ nullptr };
+    ASSERT_TRUE(c.is_virtual());
+    ASSERT_TRUE(std::chrono::steady_clock::time_point{} == c.now());
+
+    auto t = std::chrono::steady_clock::time_point{ std::chrono::hours(1) };
+    c.advance_to(t);
+    ASSERT_TRUE(t == c.refresh());
+    // does not go back
+    c.advance_to(std::chrono::steady_clock::time_point{});
+    ASSERT_TRUE(t == c.now());
+  }
+
+  void set_true(bool& x) noexcept
+  {
+    x = true;
+  }
+
+  TEST(loop_clock_event_loop_virtual)
+  {
+    coro_st::event_loop el{ nullptr };
+
+    bool fired = false;
+    coro_st::timer_node node{ std::chrono::steady_clock::time_point{ std::chrono::hours(1) } };
+    node.cb = coro_st::make_function_callback<&set_true>(fired);
+    el.timers_heap_.insert(&node);
+
+    auto sleep_time = el.do_current_pending_work();
+    ASSERT_TRUE(sleep_time.has_value());
+    ASSERT_TRUE(std::chrono::hours(1) == *sleep_time);
+    ASSERT_FALSE(fired);
+
+    // jumps to the timer instead of sleeping
+    el.idle_wait(*sleep_time);
+    ASSERT_FALSE(el.do_current_pending_work().has_value());
+    ASSERT_TRUE(fired);
+    ASSERT_TRUE(node.deadline == el.clock_.now());
+  }
+} // anonymous namespace
@@ -0,0 +1,53 @@
+#include "../test_lib/test.h"
+
+#include "../coro_st_lib/loop_hooks.h"
+
+#include "../coro_st_lib/coro_st.h"
+
+#include "test_loop.h"
+
+#include <coroutine>
+#include <type_traits>
+
+namespace
+{
+  static_assert(coro_st::is_loop_hooks<coro_st::no_loop_hooks>);
+  static_assert(std::is_empty_v<coro_st::no_loop_hooks>);
+  static_assert(std::is_same_v<coro_st::no_loop_hooks, coro_st::loop_hooks>);
+
+  struct custom_hooks
+  {
+    static void on_push_ready(coro_st::ready_node&) noexcept {}
+    static void on_timer_insert(coro_st::timer_node&) noexcept {}
+    static void on_timer_remove(coro_st::timer_node&) noexcept {}
+    static void on_timer_fire(coro_st::timer_node&) noexcept {}
+    static void on_coroutine_resume(std::coroutine_handle<>) noexcept {}
+    static void on_completion(coro_st::context&, bool) noexcept {}
+  };
+  static_assert(coro_st::is_loop_hooks<custom_hooks>);
+
+  // hooks are invoked on the hot path, they have to be noexcept
+  struct throwing_hooks : custom_hooks
+  {
+    static void on_push_ready(coro_st::ready_node&) {}
+  };
+  static_assert(!coro_st::is_loop_hooks<throwing_hooks>);
+
+  struct missing_hooks
+  {
+    static void on_push_ready(coro_st::ready_node&) noexcept {}
+  };
+  static_assert(!coro_st::is_loop_hooks<missing_hooks>);
+
+  TEST(loop_hooks_default_timer)
+  {
+    coro_st_test::test_loop tl;
+
+    coro_st::timer_node node{ tl.el_ctx.now() };
+    node.cb = coro_st::make_member_callback<&coro_st_test::test_loop::on_result_ready>(&tl);
+    tl.el_ctx.insert_timer_node(node);
+
+    tl.run_one_timer();
+    ASSERT_TRUE(tl.result_ready);
+  }
+} // anonymous namespace
@@ -7,10 +7,15 @@
 #include "../coro_st_lib/just_stopped.h"
 #include "../coro_st_lib/run.h"
 #include "../coro_st_lib/suspend_forever.h"
+#include "../coro_st_lib/wait_for.h"
 #include "../coro_st_lib/yield.h"
 
 #include "test_loop.h"
 
+#include <algorithm>
+#include <chrono>
+#include <functional>
+
 namespace
 {
   static_assert(
@@ -204,6 +209,72 @@ namespace
     ASSERT_FALSE(result.has_value());
   }
 
+  struct nursery_admission_data
+  {
+    int live{ 0 };
+    int max_live{ 0 };
+    int completed{ 0 };
+  };
+
+  coro_st::co<void> async_admission_child(nursery_admission_data& data, int yields)
+  {
+    ++data.live;
+    data.max_live = std::max(data.max_live, data.live);
+    for (int i = 0; i < yields; ++i)
+    {
+      co_await coro_st::async_yield();
+    }
+    --data.live;
+    ++data.completed;
+  }
+
+  coro_st::co<void> async_admission_initial(coro_st::nursery& n, nursery_admission_data& data)
+  {
+    for (int i = 0; i < 5; ++i)
+    {
+      // suspends while two children are live
+      co_await n.async_spawn_child(async_admission_child, std::ref(data), 3 - (i % 3));
+      ASSERT_TRUE(data.live <= 2);
+    }
+  }
+
+  TEST(nursery_async_spawn_child)
+  {
+    nursery_admission_data data;
+    coro_st::nursery n{ 2 };
+    auto result = coro_st::run(
+      n.async_run(
+        async_admission_initial(n, data)
+      ));
+    ASSERT_TRUE(result.has_value());
+    ASSERT_EQ(2, data.max_live);
+    ASSERT_EQ(5, data.completed);
+  }
+
+  coro_st::co<void> async_admission_cancel_initial(coro_st::nursery& n, nursery_admission_data& data)
+  {
+    co_await n.async_spawn_child(async_admission_child, std::ref(data), 10);
+    // at capacity: times out waiting and the second child never starts
+    auto result = co_await coro_st::async_wait_for(
+      n.async_spawn_child(async_admission_child, std::ref(data), 0),
+      std::chrono::milliseconds(0));
+    ASSERT_FALSE(result.has_value());
+    ASSERT_EQ(1, data.live);
+  }
+
+  TEST(nursery_async_spawn_child_cancellation)
+  {
+    nursery_admission_data data;
+    coro_st::nursery n{ 1 };
+    auto result = coro_st::run(
+      n.async_run(
+        async_admission_cancel_initial(n, data)
+      ));
+    ASSERT_TRUE(result.has_value());
+    ASSERT_EQ(1, data.max_live);
+    ASSERT_EQ(1, data.completed);
+  }
+
   // coro_st::co<void> async_nursery_does_not_compile()
   // {
   //   coro_st::nursery n;
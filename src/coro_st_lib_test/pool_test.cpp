@@ -0,0 +1,200 @@
+#include "../test_lib/test.h"
+
+#include "../coro_st_lib/pool.h"
+
+#include "../coro_st_lib/co.h"
+#include "../coro_st_lib/run.h"
+#include "../coro_st_lib/sleep.h"
+#include "../coro_st_lib/suspend_forever.h"
+#include "../coro_st_lib/wait_all.h"
+#include "../coro_st_lib/yield.h"
+
+#include "test_loop.h"
+
+#include <chrono>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+  coro_st::co<int> async_create(int* created)
+  {
+    co_await coro_st::async_yield();
+    ++*created;
+    if (*created < 0)
+    {
+      throw std::runtime_error("Ups!");
+    }
+    co_return *created;
+  }
+
+  struct int_factory
+  {
+    int* created;
+
+    coro_st::co<int> operator()() const
+    {
+      return async_create(created);
+    }
+  };
+
+  using int_pool = coro_st::pool<int, int_factory>;
+
+  static_assert(coro_st::is_co_task<int_pool::pool_acquire_task>);
+
+  TEST(pool_reuse)
+  {
+    int created{ 0 };
+    int_pool p{ 2, std::chrono::seconds(0), int_factory{ &created } };
+
+    auto async_lambda = [&p]() -> coro_st::co<std::vector<int>> {
+      std::vector<int> result;
+      {
+        auto l = co_await p.async_acquire();
+        result.push_back(*l);
+      }
+      {
+        auto l = co_await p.async_acquire();
+        result.push_back(*l);
+      }
+      co_return result;
+    };
+
+    auto result = coro_st::run(async_lambda()).value();
+
+    std::vector<int> expected{ 1, 1 };
+    ASSERT_TRUE(expected == result);
+    ASSERT_EQ(1, created);
+    ASSERT_EQ(1, p.size());
+    ASSERT_EQ(1, p.idle_size());
+  }
+
+  coro_st::co<void> async_use(int_pool& p, std::vector<int>& used, int yields)
+  {
+    auto l = co_await p.async_acquire();
+    used.push_back(*l);
+    for (int i = 0; i < yields; ++i)
+    {
+      co_await coro_st::async_yield();
+    }
+  }
+
+  TEST(pool_max_size_waits)
+  {
+    int created{ 0 };
+    int_pool p{ 2, std::chrono::seconds(0), int_factory{ &created } };
+    std::vector<int> used;
+
+    coro_st::run(coro_st::async_wait_all(
+      async_use(p, used, 3),
+      async_use(p, used, 1),
+      async_use(p, used, 0)
+    )).value();
+
+    // the third waits and gets the resource released first
+    std::vector<int> expected{ 1, 2, 2 };
+    ASSERT_TRUE(expected == used);
+    ASSERT_EQ(2, created);
+    ASSERT_EQ(2, p.size());
+    ASSERT_EQ(2, p.idle_size());
+  }
+
+  TEST(pool_invalidate)
+  {
+    int created{ 0 };
+    int_pool p{ 1, std::chrono::seconds(0), int_factory{ &created } };
+    std::vector<int> used;
+
+    auto async_invalidate = [&p, &used]() -> coro_st::co<void> {
+      auto l = co_await p.async_acquire();
+      used.push_back(*l);
+      co_await coro_st::async_yield();
+      l.invalidate();
+    };
+
+    coro_st::run(coro_st::async_wait_all(
+      async_invalidate(),
+      async_use(p, used, 0)
+    )).value();
+
+    // the waiter creates a new resource to replace the broken one
+    std::vector<int> expected{ 1, 2 };
+    ASSERT_TRUE(expected == used);
+    ASSERT_EQ(2, created);
+    ASSERT_EQ(1, p.size());
+  }
+
+  TEST(pool_idle_timeout)
+  {
+    int created{ 0 };
+    std::vector<int> used;
+
+    // the pool uses the event loop for the idle timer:
+    // it is destroyed before the event loop
+    auto async_lambda = [&created, &used]() -> coro_st::co<size_t> {
+      int_pool p{ 2, std::chrono::milliseconds(1), int_factory{ &created } };
+      co_await async_use(p, used, 0);
+      ASSERT_EQ(1, p.idle_size());
+      co_await coro_st::async_sleep_for(std::chrono::milliseconds(5));
+      ASSERT_EQ(0, p.idle_size());
+      ASSERT_EQ(0, p.size());
+      co_await async_use(p, used, 0);
+      co_return p.size();
+    };
+
+    auto size = coro_st::run(async_lambda()).value();
+
+    std::vector<int> expected{ 1, 2 };
+    ASSERT_TRUE(expected == used);
+    ASSERT_EQ(1, size);
+  }
+
+  TEST(pool_factory_exception)
+  {
+    int created{ -10 };
+    int_pool p{ 1, std::chrono::seconds(0), int_factory{ &created } };
+    std::vector<int> used;
+
+    ASSERT_THROW_WHAT(
+      coro_st::run(async_use(p, used, 0)),
+      std::runtime_error, "Ups!");
+    ASSERT_EQ(0, p.size());
+  }
+
+  TEST(pool_chain_root_cancel_waiter)
+  {
+    coro_st_test::test_loop tl;
+    int created{ 0 };
+    int_pool p{ 1, std::chrono::seconds(0), int_factory{ &created } };
+
+    std::vector<int> used;
+    auto holder = async_use(p, used, 1);
+    coro_st::context ctx2{
+      tl.ctx,
+      tl.stop_source.get_token(),
+      coro_st::make_member_completion<
+        &coro_st_test::test_loop::on_result_ready,
+        &coro_st_test::test_loop::on_stopped
+      >(&tl)
+    };
+    auto holder_awaiter = holder.get_work().get_awaiter(ctx2);
+    holder_awaiter.start();
+    // the factory yields
+    tl.run_one_ready();
+    ASSERT_EQ(1, created);
+
+    auto task = p.async_acquire();
+    auto awaiter = task.get_work().get_awaiter(tl.ctx);
+    awaiter.start();
+    ASSERT_FALSE(tl.stopped);
+
+    tl.stop_source.request_stop();
+    // the waiter and the holder
+    tl.run_one_ready(2);
+    ASSERT_TRUE(tl.stopped);
+    ASSERT_TRUE(tl.el.ready_queue_.empty());
+    // the lease is released when the holder frame is destroyed
+    ASSERT_EQ(1, p.size());
+    ASSERT_EQ(0, p.idle_size());
+  }
+} // anonymous namespace
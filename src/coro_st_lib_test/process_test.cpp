@@ -0,0 +1,126 @@
+#include "../test_lib/test.h"
+
+#include "../coro_st_lib/process.h"
+
+#include "../coro_st_lib/coro_st.h"
+
+#include <array>
+#include <chrono>
+#include <span>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <signal.h>
+
+namespace
+{
+  static_assert(coro_st::is_co_task<coro_st::wait_process_task>);
+
+  coro_st::co<std::string> async_read_stdout_to_end(coro_st::process& p)
+  {
+    std::string result;
+    std::array<char, 4> buffer;
+    while (true)
+    {
+      size_t count = co_await p.async_read_stdout(buffer);
+      if (0 == count)
+      {
+        co_return result;
+      }
+      result.append(buffer.data(), count);
+    }
+  }
+
+  coro_st::co<std::string> async_run_echo()
+  {
+    std::vector<std::string> args{ "echo", "hello", "world" };
+    auto p = coro_st::spawn_process(args);
+    std::string output = co_await async_read_stdout_to_end(p);
+    auto exit_status = co_await p.async_wait();
+    ASSERT_TRUE(exit_status.exited());
+    ASSERT_EQ(0, exit_status.exit_code());
+    co_return output;
+  }
+
+  TEST(process_echo)
+  {
+    auto result = coro_st::run(async_run_echo()).value();
+    ASSERT_EQ("hello world\n", result);
+  }
+
+  coro_st::co<std::string> async_run_cat(std::string input)
+  {
+    std::vector<std::string> args{ "cat" };
+    auto p = coro_st::spawn_process(args, { .pipe_stdin = true, .pipe_stdout = true });
+    co_await coro_st::async_write_all(p.stdin_fd(), input);
+    p.close_stdin();
+    std::string output = co_await async_read_stdout_to_end(p);
+    auto exit_status = co_await p.async_wait();
+    ASSERT_TRUE(exit_status.exited());
+    co_return output;
+  }
+
+  TEST(process_cat)
+  {
+    auto result = coro_st::run(async_run_cat("some input")).value();
+    ASSERT_EQ("some input", result);
+  }
+
+  coro_st::co<coro_st::process_exit_status> async_run_exit_code()
+  {
+    std::vector<std::string> args{ "sh", "-c", "echo oops >&2; exit 3" };
+    auto p = coro_st::spawn_process(args, { .pipe_stdout = false, .pipe_stderr = true });
+    ASSERT_EQ(-1, p.stdout_fd());
+    std::array<char, 16> buffer;
+    size_t count = co_await p.async_read_stderr(buffer);
+    ASSERT_EQ("oops\n", std::string(buffer.data(), count));
+    co_return co_await p.async_wait();
+  }
+
+  TEST(process_exit_code)
+  {
+    auto result = coro_st::run(async_run_exit_code()).value();
+    ASSERT_TRUE(result.exited());
+    ASSERT_EQ(3, result.exit_code());
+  }
+
+  coro_st::co<coro_st::process_exit_status> async_run_kill()
+  {
+    std::vector<std::string> args{ "sleep", "10" };
+    auto p = coro_st::spawn_process(args, { .pipe_stdout = false });
+    co_await coro_st::async_sleep_for(std::chrono::milliseconds(1));
+    p.kill(SIGTERM);
+    co_return co_await p.async_wait();
+  }
+
+  TEST(process_kill)
+  {
+    auto result = coro_st::run(async_run_kill()).value();
+    ASSERT_FALSE(result.exited());
+    ASSERT_TRUE(result.signaled());
+    ASSERT_EQ(SIGTERM, result.term_signal());
+  }
+
+  coro_st::co<void> async_wait_process(coro_st::process& p)
+  {
+    co_await p.async_wait();
+  }
+
+  TEST(process_cancel_wait)
+  {
+    std::vector<std::string> args{ "sleep", "10" };
+    auto p = coro_st::spawn_process(args, { .pipe_stdout = false });
+    auto result = coro_st::run(coro_st::async_wait_for(
+      async_wait_process(p),
+      std::chrono::milliseconds(1))).value();
+    ASSERT_FALSE(result.has_value());
+    // the destructor kills and reaps it
+  }
+
+  TEST(process_spawn_failure)
+  {
+    std::vector<std::string> args{ "/nonexistent/coro_st_test" };
+    ASSERT_THROW(static_cast<void>(coro_st::spawn_process(args)), std::system_error);
+  }
+} // anonymous namespace
@@ -0,0 +1,156 @@
+#include "../test_lib/test.h"
+
+#include "../coro_st_lib/rate_limiter.h"
+
+#include "../coro_st_lib/co.h"
+#include "../coro_st_lib/coro_type_traits.h"
+#include "../coro_st_lib/run.h"
+#include "../coro_st_lib/wait_all.h"
+
+#include "test_loop.h"
+
+#include <chrono>
+#include <vector>
+
+namespace
+{
+  static_assert(
+    coro_st::is_co_task<
+      coro_st::rate_limiter::rate_limiter_acquire_task>);
+
+  TEST(rate_limiter_chain_root_burst_then_timer)
+  {
+    coro_st_test::test_loop tl;
+    coro_st::rate_limiter rl{ 2, std::chrono::hours(1) };
+
+    // the burst completes immediately
+    for (int i = 0; i < 2; ++i)
+    {
+      auto task = rl.async_acquire();
+      auto awaiter = task.get_work().get_awaiter(tl.ctx);
+      awaiter.start();
+      ASSERT_TRUE(tl.result_ready);
+      tl.result_ready = false;
+    }
+    ASSERT_EQ(0, rl.tokens());
+    ASSERT_TRUE(tl.el.timers_heap_.empty());
+
+    auto task = rl.async_acquire();
+    auto awaiter = task.get_work().get_awaiter(tl.ctx);
+    awaiter.start();
+    ASSERT_FALSE(tl.result_ready);
+    ASSERT_FALSE(tl.el.timers_heap_.empty());
+
+    tl.run_one_timer();
+    ASSERT_TRUE(tl.el.timers_heap_.empty());
+    ASSERT_FALSE(tl.result_ready);
+    tl.run_one_ready();
+    ASSERT_TRUE(tl.result_ready);
+    ASSERT_EQ(0, rl.tokens());
+  }
+
+  TEST(rate_limiter_chain_root_fifo_single_timer)
+  {
+    coro_st_test::test_loop tl1;
+    coro_st_test::test_loop tl2;
+    coro_st_test::test_loop tl3;
+    coro_st::rate_limiter rl{ 2, std::chrono::hours(1) };
+
+    auto task1 = rl.async_acquire(2);
+    auto awaiter1 = task1.get_work().get_awaiter(tl1.ctx);
+    awaiter1.start();
+    ASSERT_TRUE(tl1.result_ready);
+
+    auto task2 = rl.async_acquire(2);
+    auto awaiter2 = task2.get_work().get_awaiter(tl2.ctx);
+    awaiter2.start();
+    ASSERT_FALSE(tl2.result_ready);
+
+    // needs less, but does not overtake
+    auto task3 = rl.async_acquire(1);
+    auto awaiter3 = task3.get_work().get_awaiter(tl3.ctx);
+    awaiter3.start();
+    ASSERT_FALSE(tl3.result_ready);
+
+    // one timer, armed by the first waiter
+    ASSERT_FALSE(tl2.el.timers_heap_.empty());
+    ASSERT_TRUE(tl3.el.timers_heap_.empty());
+
+    // first timer for two tokens
+    tl2.run_one_timer();
+    tl2.run_one_ready();
+    ASSERT_TRUE(tl2.result_ready);
+    ASSERT_FALSE(tl3.result_ready);
+
+    // then the timer for one more token, on the loop of the next waiter
+    ASSERT_TRUE(tl2.el.timers_heap_.empty());
+    ASSERT_FALSE(tl3.el.timers_heap_.empty());
+    tl3.run_one_timer();
+    tl3.run_one_ready();
+    ASSERT_TRUE(tl3.result_ready);
+  }
+
+  TEST(rate_limiter_chain_root_cancel_first)
+  {
+    coro_st_test::test_loop tl1;
+    coro_st_test::test_loop tl2;
+    coro_st::rate_limiter rl{ 2, std::chrono::hours(1) };
+
+    // the loop time is the same for both, take one token
+    {
+      auto task = rl.async_acquire(1);
+      auto awaiter = task.get_work().get_awaiter(tl1.ctx);
+      awaiter.start();
+      ASSERT_TRUE(tl1.result_ready);
+      tl1.result_ready = false;
+    }
+
+    auto task1 = rl.async_acquire(2);
+    auto awaiter1 = task1.get_work().get_awaiter(tl1.ctx);
+    awaiter1.start();
+    ASSERT_FALSE(tl1.result_ready);
+
+    auto task2 = rl.async_acquire(1);
+    auto awaiter2 = task2.get_work().get_awaiter(tl2.ctx);
+    awaiter2.start();
+    ASSERT_FALSE(tl2.result_ready);
+
+    // the one left is enough for the next waiter
+    tl1.stop_source.request_stop();
+    ASSERT_TRUE(tl1.el.timers_heap_.empty());
+    tl1.run_one_ready();
+    ASSERT_TRUE(tl1.stopped);
+
+    tl2.run_one_ready();
+    ASSERT_TRUE(tl2.result_ready);
+    ASSERT_TRUE(tl2.el.timers_heap_.empty());
+    ASSERT_EQ(0, rl.tokens());
+  }
+
+  coro_st::co<void> async_acquire_many(coro_st::rate_limiter& rl, int count)
+  {
+    for (int i = 0; i < count; ++i)
+    {
+      co_await rl.async_acquire();
+    }
+  }
+
+  coro_st::co<void> async_two_callers(coro_st::rate_limiter& rl)
+  {
+    co_await coro_st::async_wait_all(
+      async_acquire_many(rl, 3),
+      async_acquire_many(rl, 3));
+  }
+
+  TEST(rate_limiter_run)
+  {
+    coro_st::rate_limiter rl{ 2, std::chrono::milliseconds(10) };
+
+    auto start = std::chrono::steady_clock::now();
+    coro_st::run(async_two_callers(rl)).value();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    // 2 immediately, then 4 more, one every 10ms
+    ASSERT_TRUE(elapsed >= std::chrono::milliseconds(40));
+  }
+} // anonymous namespace
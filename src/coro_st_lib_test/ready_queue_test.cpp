@@ -2,6 +2,8 @@
 
 #include "../coro_st_lib/ready_queue.h"
 
+#include <chrono>
+
 namespace
 {
   TEST(ready_queue_trivial)
@@ -31,4 +33,27 @@ namespace
 
     ASSERT_TRUE(called);
   }
+
+  TEST(ready_heap_trivial)
+  {
+    coro_st::ready_heap h;
+
+    ASSERT_TRUE(h.empty());
+
+    auto now = std::chrono::steady_clock::now();
+
+    coro_st::deadline_ready_node n0;
+    n0.deadline = now + std::chrono::seconds(2);
+    h.insert(&n0);
+
+    coro_st::deadline_ready_node n1;
+    n1.deadline = now + std::chrono::seconds(1);
+    h.insert(&n1);
+
+    ASSERT_EQ(&n1, h.min_node());
+    h.pop_min();
+    ASSERT_EQ(&n0, h.min_node());
+    h.pop_min();
+    ASSERT_TRUE(h.empty());
+  }
 } // anonymous namespace
\ No newline at end of file
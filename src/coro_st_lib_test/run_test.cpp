@@ -4,6 +4,10 @@
 
 #include "../coro_st_lib/co.h"
 #include "../coro_st_lib/just_stopped.h"
+#include "../coro_st_lib/sleep.h"
+#include "../coro_st_lib/wait_for.h"
+
+#include <chrono>
 
 namespace
 {
@@ -109,4 +113,60 @@ namespace
 
     ASSERT_FALSE(result.has_value());
   }
+
+  TEST(run_spin)
+  {
+    auto async_lambda = []() -> coro_st::co<int> {
+      co_await coro_st::async_sleep_for(std::chrono::milliseconds(1));
+      co_await coro_st::async_sleep_for(std::chrono::microseconds(10));
+      co_return 42;
+    };
+
+    coro_st::run_options options{
+      .idle = coro_st::idle_strategy::spin,
+      .spin_idle_limit = std::chrono::microseconds(100),
+    };
+    auto start = std::chrono::steady_clock::now();
+    int result = coro_st::run(async_lambda(), options).value();
+
+    ASSERT_EQ(42, result);
+    ASSERT_TRUE(std::chrono::steady_clock::now() - start >= std::chrono::microseconds(1010));
+  }
+
+  coro_st::co<int> async_virtual_time_timeouts()
+  {
+    // sleeps in sequence
+    for (int i = 0; i < 10'000; ++i)
+    {
+      co_await coro_st::async_sleep_for(std::chrono::hours(1));
+    }
+    // and the earliest deadline wins
+    auto result = co_await coro_st::async_wait_for(
+      coro_st::async_sleep_for(std::chrono::hours(2)),
+      std::chrono::hours(1));
+    co_return result.has_value() ? 0 : 42;
+  }
+
+  TEST(run_virtual_time)
+  {
+    coro_st::run_options options{ .virtual_time = true };
+    auto start = std::chrono::steady_clock::now();
+    int result = coro_st::run(async_virtual_time_timeouts(), options).value();
+
+    ASSERT_EQ(42, result);
+    // more than a year of simulated time
+    ASSERT_TRUE(std::chrono::steady_clock::now() - start < std::chrono::seconds(10));
+  }
+
+  TEST(run_virtual_time_spin)
+  {
+    // the spin strategy does not apply, there is nothing to wait for
+    coro_st::run_options options{
+      .virtual_time = true,
+      .idle = coro_st::idle_strategy::spin,
+    };
+    int result = coro_st::run(async_virtual_time_timeouts(), options).value();
+
+    ASSERT_EQ(42, result);
+  }
 } // anonymous namespace
\ No newline at end of file
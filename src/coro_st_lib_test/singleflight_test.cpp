@@ -0,0 +1,176 @@
+#include "../test_lib/test.h"
+
+#include "../coro_st_lib/singleflight.h"
+
+#include "../coro_st_lib/co.h"
+#include "../coro_st_lib/coro_type_traits.h"
+#include "../coro_st_lib/run.h"
+#include "../coro_st_lib/wait_all.h"
+#include "../coro_st_lib/wait_for.h"
+#include "../coro_st_lib/yield.h"
+
+#include "test_loop.h"
+
+#include <chrono>
+#include <functional>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+  struct fetch_data
+  {
+    int calls{ 0 };
+    bool stopped{ false };
+  };
+
+  coro_st::co<std::string> async_fetch(fetch_data& data, int key)
+  {
+    ++data.calls;
+    data.stopped = true;
+    co_await coro_st::async_yield();
+    co_await coro_st::async_yield();
+    data.stopped = false;
+    co_return std::to_string(key);
+  }
+
+  struct fetch_fn
+  {
+    fetch_data* data;
+    int key;
+
+    coro_st::co<std::string> operator()() const
+    {
+      return async_fetch(*data, key);
+    }
+  };
+
+  static_assert(
+    coro_st::is_co_task<
+      coro_st::singleflight<int, std::string>::singleflight_do_task<fetch_fn>>);
+
+  TEST(singleflight_chain_root)
+  {
+    coro_st_test::test_loop tl;
+    fetch_data data;
+
+    coro_st::singleflight<int, std::string> sf;
+
+    auto task1 = sf.async_do(42, fetch_fn{ &data, 42 });
+    auto task2 = sf.async_do(42, fetch_fn{ &data, 42 });
+
+    // each waiter needs its own context
+    coro_st::context ctx2{
+      tl.ctx,
+      tl.stop_source.get_token(),
+      coro_st::make_member_completion<
+        &coro_st_test::test_loop::on_result_ready,
+        &coro_st_test::test_loop::on_stopped
+      >(&tl)
+    };
+
+    auto awaiter1 = task1.get_work().get_awaiter(tl.ctx);
+    auto awaiter2 = task2.get_work().get_awaiter(ctx2);
+    ASSERT_EQ(1, sf.size());
+
+    awaiter1.start();
+    awaiter2.start();
+    ASSERT_EQ(1, data.calls);
+
+    // two yields and the completion of the work, then the two waiters
+    tl.run_one_ready(3);
+    ASSERT_EQ(0, sf.size());
+    ASSERT_FALSE(tl.result_ready);
+    tl.run_one_ready(2);
+    ASSERT_TRUE(tl.result_ready);
+    ASSERT_FALSE(tl.stopped);
+    ASSERT_TRUE(tl.el.ready_queue_.empty());
+
+    ASSERT_EQ("42", awaiter1.await_resume());
+    ASSERT_EQ("42", awaiter2.await_resume());
+  }
+
+  TEST(singleflight_chain_root_cancellation)
+  {
+    coro_st_test::test_loop tl;
+    fetch_data data;
+
+    coro_st::singleflight<int, std::string> sf;
+
+    auto task = sf.async_do(42, fetch_fn{ &data, 42 });
+    auto awaiter = task.get_work().get_awaiter(tl.ctx);
+    awaiter.start();
+
+    // the last waiter leaves: the work is stopped and
+    // later callers would start new work
+    tl.stop_source.request_stop();
+    ASSERT_EQ(0, sf.size());
+
+    // the work stops at the yield, then the waiter completes
+    tl.run_one_ready(2);
+    ASSERT_TRUE(tl.el.ready_queue_.empty());
+    ASSERT_FALSE(tl.result_ready);
+    ASSERT_TRUE(tl.stopped);
+    ASSERT_TRUE(data.stopped);
+  }
+
+  coro_st::co<std::string> async_impatient(
+    coro_st::singleflight<int, std::string>& sf, fetch_data& data)
+  {
+    auto result = co_await coro_st::async_wait_for(
+      sf.async_do(1, fetch_fn{ &data, 1 }),
+      std::chrono::seconds(0));
+    co_return result.value_or("timeout");
+  }
+
+  coro_st::co<std::string> async_patient(
+    coro_st::singleflight<int, std::string>& sf, fetch_data& data)
+  {
+    co_return co_await sf.async_do(1, fetch_fn{ &data, 1 });
+  }
+
+  TEST(singleflight_usage)
+  {
+    fetch_data data;
+    coro_st::singleflight<int, std::string> sf;
+
+    // one waiter leaving does not cancel the shared work
+    auto result = coro_st::run(
+      coro_st::async_wait_all(
+        async_impatient(sf, data),
+        async_patient(sf, data))).value();
+    ASSERT_EQ("timeout", std::get<0>(result));
+    ASSERT_EQ("1", std::get<1>(result));
+    ASSERT_EQ(1, data.calls);
+    ASSERT_FALSE(data.stopped);
+
+    // a new call after completion starts new work
+    ASSERT_EQ("1", coro_st::run(async_patient(sf, data)).value());
+    ASSERT_EQ(2, data.calls);
+  }
+
+  coro_st::co<int> async_throw()
+  {
+    co_await coro_st::async_yield();
+    throw std::runtime_error("Ups!");
+  }
+
+  coro_st::co<int> async_do_throw(coro_st::singleflight<std::string, int>& sf)
+  {
+    co_return co_await sf.async_do("key", &async_throw);
+  }
+
+  TEST(singleflight_exception)
+  {
+    coro_st::singleflight<std::string, int> sf;
+
+    // all the waiters get the exception
+    ASSERT_THROW_WHAT(
+      coro_st::run(
+        coro_st::async_wait_all(
+          async_do_throw(sf),
+          async_do_throw(sf))),
+      std::runtime_error, "Ups!");
+    ASSERT_EQ(0, sf.size());
+  }
+} // anonymous namespace
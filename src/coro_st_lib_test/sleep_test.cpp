@@ -74,6 +74,67 @@ namespace
     ASSERT_TRUE(tl.stopped);
   }
 
+  TEST(sleep_chain_root_loop_time)
+  {
+    coro_st_test::test_loop tl;
+
+    auto task = coro_st::async_sleep_for(std::chrono::seconds(1));
+
+    auto awaiter = task.get_work().get_awaiter(tl.ctx);
+
+    // the deadline uses the time cached by the event loop
+    ASSERT_TRUE(tl.ctx.now() == tl.el.clock_.now());
+    awaiter.start();
+    ASSERT_TRUE(tl.el.clock_.now() + std::chrono::seconds(1) ==
+      tl.el.timers_heap_.min_node()->deadline);
+
+    tl.stop_source.request_stop();
+    tl.run_one_ready();
+    ASSERT_TRUE(tl.stopped);
+  }
+
+  TEST(sleep_chain_root_slack)
+  {
+    coro_st_test::test_loop tl;
+
+    auto task1 = coro_st::async_sleep_for(std::chrono::seconds(1), std::chrono::hours(1));
+    auto task2 = coro_st::async_sleep_for(std::chrono::seconds(2), std::chrono::hours(1));
+
+    coro_st::context ctx2{
+      tl.ctx,
+      tl.stop_source.get_token(),
+      coro_st::make_member_completion<
+        &coro_st_test::test_loop::on_result_ready,
+        &coro_st_test::test_loop::on_stopped
+      >(&tl)
+    };
+
+    auto awaiter1 = task1.get_work().get_awaiter(tl.ctx);
+    auto awaiter2 = task2.get_work().get_awaiter(ctx2);
+
+    awaiter1.start();
+    auto deadline1 = tl.el.timers_heap_.min_node()->deadline;
+    awaiter2.start();
+    auto* node = tl.el.timers_heap_.min_node();
+    tl.el.timers_heap_.pop_min();
+    auto deadline2 = tl.el.timers_heap_.min_node()->deadline;
+    tl.el.timers_heap_.insert(node);
+
+    // unless the hour bucket boundary is in the next two seconds
+    // both deadlines are coalesced
+    ASSERT_TRUE(
+      (deadline1 == deadline2) ||
+      (deadline2 - deadline1 == std::chrono::hours(1)));
+    ASSERT_TRUE(
+      std::chrono::steady_clock::duration::zero() ==
+      deadline1.time_since_epoch() % std::chrono::hours(1));
+
+    tl.stop_source.request_stop();
+    ASSERT_TRUE(tl.el.timers_heap_.empty());
+    tl.run_one_ready(2);
+    ASSERT_TRUE(tl.stopped);
+  }
+
   TEST(sleep_inside_co)
   {
     coro_st_test::test_loop tl;
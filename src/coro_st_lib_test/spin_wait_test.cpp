@@ -0,0 +1,22 @@
+#include "../test_lib/test.h"
+
+#include "../coro_st_lib/spin_wait.h"
+
+namespace
+{
+  TEST(spin_wait_backoff)
+  {
+    coro_st::spin_backoff backoff{ 4 };
+    ASSERT_EQ(1, backoff.count());
+
+    backoff.pause();
+    ASSERT_EQ(2, backoff.count());
+    backoff.pause();
+    ASSERT_EQ(4, backoff.count());
+    backoff.pause();
+    ASSERT_EQ(4, backoff.count());
+
+    backoff.reset();
+    ASSERT_EQ(1, backoff.count());
+  }
+} // anonymous namespace
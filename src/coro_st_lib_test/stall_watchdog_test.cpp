@@ -0,0 +1,115 @@
+#include "../test_lib/test.h"
+
+#include "../coro_st_lib/stall_watchdog.h"
+
+#include "../coro_st_lib/co.h"
+#include "../coro_st_lib/run.h"
+#include "../coro_st_lib/yield.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+  void noop_fn(void*) noexcept
+  {
+  }
+
+  TEST(stall_watchdog_heartbeat)
+  {
+    coro_st::loop_heartbeat hb;
+    int x{ 0 };
+
+    auto s0 = hb.read();
+    ASSERT_FALSE(s0.is_running());
+
+    hb.begin(coro_st::callback{ &x, &noop_fn });
+    auto s1 = hb.read();
+    ASSERT_TRUE(s1.is_running());
+    ASSERT_TRUE(&noop_fn == s1.fn);
+    ASSERT_EQ(&x, s1.x);
+
+    hb.end();
+    auto s2 = hb.read();
+    ASSERT_FALSE(s2.is_running());
+    ASSERT_NE(s0.sequence, s2.sequence);
+  }
+
+  // Deterministic: the blocking callback waits for the watchdog to report
+  // it instead of sleeping for a guessed time
+  struct collected_reports
+  {
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::vector<coro_st::stall_report> reports;
+
+    // Generous, only reached if the watchdog fails to report
+    static constexpr auto timeout = std::chrono::seconds(10);
+
+    bool wait_for_last(bool finished)
+    {
+      std::unique_lock lock{ mtx };
+      return cv.wait_for(lock, timeout, [this, finished]() {
+        return !reports.empty() && (finished == reports.back().finished);
+      });
+    }
+  };
+
+  struct collect_reports
+  {
+    collected_reports* collected;
+
+    void operator()(const coro_st::stall_report& report) const noexcept
+    {
+      {
+        std::lock_guard lock{ collected->mtx };
+        collected->reports.push_back(report);
+      }
+      collected->cv.notify_all();
+    }
+  };
+
+  TEST(stall_watchdog_detects_blocking_callback)
+  {
+    collected_reports collected;
+
+    coro_st::loop_heartbeat hb;
+
+    auto async_blocking = [&collected]() -> coro_st::co<bool> {
+      co_await coro_st::async_yield();
+      // synchronous work blocking the loop until it is detected
+      co_return collected.wait_for_last(false);
+    };
+
+    {
+      coro_st::stall_watchdog watchdog{
+        hb,
+        std::chrono::milliseconds(10),
+        std::chrono::milliseconds(1),
+        collect_reports{ &collected } };
+
+      bool detected = coro_st::run(
+        async_blocking(), coro_st::run_options{ .heartbeat = &hb }).value();
+      ASSERT_TRUE(detected);
+
+      // the watchdog sees the callback returned
+      ASSERT_TRUE(collected.wait_for_last(true));
+    }
+
+    // at least the unfinished report followed by the finished one
+    // (an earlier callback might have been slow enough to be reported too)
+    auto& reports = collected.reports;
+    ASSERT_TRUE(reports.size() >= 2);
+    const auto& detected = reports[reports.size() - 2];
+    const auto& finished = reports.back();
+    ASSERT_FALSE(detected.finished);
+    ASSERT_TRUE(detected.duration >= std::chrono::milliseconds(10));
+    ASSERT_TRUE(finished.finished);
+    ASSERT_TRUE(finished.duration >= detected.duration);
+    ASSERT_TRUE(detected.fn == finished.fn);
+    ASSERT_EQ(detected.x, finished.x);
+    ASSERT_NE(nullptr, detected.x);
+  }
+} // anonymous namespace
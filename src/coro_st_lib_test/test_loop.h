@@ -6,6 +6,8 @@
 #include "../coro_st_lib/stop_util.h"
 #include "../test_lib/test.h"
 
+#include <chrono>
+
 namespace coro_st_test
 {
   struct test_loop
@@ -16,7 +18,7 @@ namespace coro_st_test
 
     coro_st::event_loop el{};
 
-    coro_st::event_loop_context el_ctx{ el.ready_queue_, el.timers_heap_ };
+    coro_st::event_loop_context el_ctx{ el.ready_queue_, el.ready_heap_, el.timers_heap_, el.clock_ };
     coro_st::context ctx{
       el_ctx,
       stop_source.get_token(),
@@ -26,7 +28,12 @@ namespace coro_st_test
       >(this)
     };
 
-    test_loop() noexcept = default;
+    test_loop() noexcept
+    {
+#if defined(__linux__)
+      el_ctx.set_io_poller(&el.poller_);
+#endif
+    }
 
     test_loop(const test_loop&) = delete;
     test_loop& operator=(const test_loop&) = delete;
@@ -44,7 +51,16 @@ namespace coro_st_test
     {
       for (int i = 0; i < count; ++i)
       {
-        auto* ready_node = el.ready_queue_.pop();
+        // same order as the event loop: earliest deadline first
+        coro_st::ready_node* ready_node = el.ready_heap_.min_node();
+        if (ready_node != nullptr)
+        {
+          el.ready_heap_.pop_min();
+        }
+        else
+        {
+          ready_node = el.ready_queue_.pop();
+        }
         ASSERT_NE(nullptr, ready_node);
 
         coro_st::callback cb = ready_node->cb;
@@ -64,6 +80,21 @@ namespace coro_st_test
       cb.invoke();
     }
 
+#if defined(__linux__)
+    // Waits for registered fds to be ready and runs their callbacks
+    void run_io(
+      std::chrono::steady_clock::duration timeout = std::chrono::steady_clock::duration::zero()) noexcept
+    {
+      el.poller_.wait(timeout);
+      while (coro_st::io_node* node = el.poller_.pop_ready())
+      {
+        coro_st::callback cb = node->cb;
+        ASSERT_TRUE(cb.is_callable());
+        cb.invoke();
+      }
+    }
+#endif
+
     void on_result_ready() noexcept
     {
       result_ready = true;
@@ -0,0 +1,36 @@
+#include "../test_lib/test.h"
+
+#include "../coro_st_lib/thread_signals.h"
+
+#include <thread>
+
+#include <pthread.h>
+#include <signal.h>
+
+namespace
+{
+  bool is_blocked(int signal_number)
+  {
+    sigset_t crt;
+    ::pthread_sigmask(SIG_SETMASK, nullptr, &crt);
+    return 1 == sigismember(&crt, signal_number);
+  }
+
+  TEST(thread_signals_all_signals_blocked)
+  {
+    ASSERT_FALSE(is_blocked(SIGTERM));
+
+    bool blocked_in_thread{ false };
+    {
+      coro_st::impl::all_signals_blocked blocked;
+      ASSERT_TRUE(is_blocked(SIGTERM));
+      std::jthread t([&blocked_in_thread]() {
+        blocked_in_thread = is_blocked(SIGTERM) && is_blocked(SIGINT);
+      });
+    }
+    // the thread inherited the mask
+    ASSERT_TRUE(blocked_in_thread);
+    // restored for the calling thread
+    ASSERT_FALSE(is_blocked(SIGTERM));
+  }
+} // anonymous namespace
@@ -34,4 +34,18 @@ namespace
 
     ASSERT_TRUE(called);
   }
+
+  TEST(timer_heap_coalesce_deadline)
+  {
+    using namespace std::chrono_literals;
+
+    std::chrono::steady_clock::time_point t{ 1005ms };
+
+    ASSERT_TRUE(t == coro_st::coalesce_deadline(t, 0ms));
+    ASSERT_TRUE(std::chrono::steady_clock::time_point{ 1010ms } ==
+      coro_st::coalesce_deadline(t, 10ms));
+    ASSERT_TRUE(std::chrono::steady_clock::time_point{ 1010ms } ==
+      coro_st::coalesce_deadline(std::chrono::steady_clock::time_point{ 1001ms }, 10ms));
+    ASSERT_TRUE(t == coro_st::coalesce_deadline(t, 5ms));
+  }
 } // anonymous namespace
\ No newline at end of file
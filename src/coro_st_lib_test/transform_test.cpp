@@ -0,0 +1,194 @@
+#include "../test_lib/test.h"
+
+#include "../coro_st_lib/transform.h"
+
+#include "../coro_st_lib/co.h"
+#include "../coro_st_lib/coro_type_traits.h"
+#include "../coro_st_lib/just.h"
+#include "../coro_st_lib/run.h"
+#include "../coro_st_lib/suspend_forever.h"
+#include "../coro_st_lib/yield.h"
+
+#include "test_loop.h"
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+  using just_int_fn = coro_st::just_task<int>(*)(int);
+
+  coro_st::just_task<int> just_twice(int x) noexcept
+  {
+    return coro_st::async_just(x * 2);
+  }
+
+  static_assert(
+    coro_st::is_co_task<
+      coro_st::transform_task<std::vector<int>, just_int_fn>>);
+
+  TEST(transform_chain_root_immediate)
+  {
+    coro_st_test::test_loop tl;
+
+    std::vector<int> in{ 1, 2, 3, 4 };
+
+    auto task = coro_st::async_transform(in, 2, &just_twice);
+
+    auto awaiter = task.get_work().get_awaiter(tl.ctx);
+
+    awaiter.start();
+
+    // children complete immediately, slots are reused in a loop
+    ASSERT_TRUE(tl.el.ready_queue_.empty());
+    ASSERT_TRUE(tl.result_ready);
+    ASSERT_FALSE(tl.stopped);
+
+    std::vector<int> expected{ 2, 4, 6, 8 };
+    ASSERT_TRUE(expected == awaiter.await_resume());
+  }
+
+  struct no_default
+  {
+    int x;
+
+    explicit no_default(int x_arg) noexcept : x{ x_arg }
+    {
+    }
+  };
+
+  coro_st::just_task<no_default> just_no_default(int x) noexcept
+  {
+    return coro_st::async_just(no_default{ x });
+  }
+
+  TEST(transform_chain_root_not_default_constructible)
+  {
+    coro_st_test::test_loop tl;
+
+    std::vector<int> in{ 1, 2, 3 };
+
+    auto task = coro_st::async_transform(in, 2, &just_no_default);
+
+    auto awaiter = task.get_work().get_awaiter(tl.ctx);
+
+    awaiter.start();
+
+    ASSERT_TRUE(tl.result_ready);
+
+    std::vector<no_default> result = awaiter.await_resume();
+    ASSERT_EQ(3, result.size());
+    ASSERT_EQ(1, result[0].x);
+    ASSERT_EQ(3, result[2].x);
+  }
+
+  TEST(transform_chain_root_empty)
+  {
+    coro_st_test::test_loop tl;
+
+    std::vector<int> in;
+
+    auto task = coro_st::async_transform(in, 2, &just_twice);
+
+    auto awaiter = task.get_work().get_awaiter(tl.ctx);
+
+    awaiter.start();
+
+    ASSERT_TRUE(tl.result_ready);
+    ASSERT_TRUE(awaiter.await_resume().empty());
+  }
+
+  coro_st::co<int> async_forever(int)
+  {
+    co_await coro_st::async_suspend_forever();
+    co_return 0;
+  }
+
+  TEST(transform_chain_root_cancellation)
+  {
+    coro_st_test::test_loop tl;
+
+    std::vector<int> in{ 1, 2, 3, 4 };
+
+    auto task = coro_st::async_transform(in, 2, &async_forever);
+
+    auto awaiter = task.get_work().get_awaiter(tl.ctx);
+
+    awaiter.start();
+
+    ASSERT_TRUE(tl.el.ready_queue_.empty());
+
+    tl.stop_source.request_stop();
+
+    // only the two in flight are cancelled, the rest are never started
+    tl.run_one_ready(2);
+    ASSERT_TRUE(tl.el.ready_queue_.empty());
+    ASSERT_FALSE(tl.result_ready);
+    ASSERT_TRUE(tl.stopped);
+  }
+
+  struct transform_usage_data
+  {
+    int in_flight{ 0 };
+    int max_in_flight{ 0 };
+    int started{ 0 };
+  };
+
+  coro_st::co<std::string> async_to_string(transform_usage_data& data, int x)
+  {
+    ++data.started;
+    ++data.in_flight;
+    data.max_in_flight = std::max(data.max_in_flight, data.in_flight);
+    // complete out of order
+    for (int i = 0; i < 5 - x; ++i)
+    {
+      co_await coro_st::async_yield();
+    }
+    --data.in_flight;
+    co_return std::to_string(x);
+  }
+
+  TEST(transform_usage)
+  {
+    transform_usage_data data;
+    std::vector<int> in{ 1, 2, 3, 4, 5 };
+    auto fn = [&data](int x) {
+      return async_to_string(data, x);
+    };
+    auto result = coro_st::run(
+      coro_st::async_transform(in, 3, std::ref(fn))).value();
+    std::vector<std::string> expected{ "1", "2", "3", "4", "5" };
+    ASSERT_TRUE(expected == result);
+    ASSERT_EQ(3, data.max_in_flight);
+    ASSERT_EQ(5, data.started);
+  }
+
+  coro_st::co<void> async_throw_on_two(transform_usage_data& data, int x)
+  {
+    ++data.started;
+    co_await coro_st::async_yield();
+    if (x == 2)
+    {
+      throw std::runtime_error("Ups!");
+    }
+    co_await coro_st::async_suspend_forever();
+  }
+
+  TEST(transform_usage_exception)
+  {
+    transform_usage_data data;
+    std::vector<int> in{ 1, 2, 3, 4, 5 };
+    auto fn = [&data](int x) {
+      return async_throw_on_two(data, x);
+    };
+    ASSERT_THROW_WHAT(
+      coro_st::run(
+        coro_st::async_transform(in, 2, std::ref(fn))),
+      std::runtime_error, "Ups!");
+    // the first error stops launching further items
+    ASSERT_EQ(2, data.started);
+  }
+} // anonymous namespace
@@ -0,0 +1,42 @@
+#include "../test_lib/test.h"
+
+#include "../coro_st_lib/tsc_clock.h"
+
+#include "../coro_st_lib/co.h"
+#include "../coro_st_lib/run.h"
+#include "../coro_st_lib/sleep.h"
+
+#include <chrono>
+
+// x86/x64 only
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+
+namespace
+{
+  TEST(tsc_clock_trivial)
+  {
+    coro_st::tsc_clock::calibrate(std::chrono::milliseconds(1));
+    ASSERT_TRUE(coro_st::tsc_clock::is_calibrated());
+
+    auto tsc_now = coro_st::tsc_clock::now();
+    auto steady_now = std::chrono::steady_clock::now();
+
+    // loose bound, calibrated over a short interval
+    auto diff = (tsc_now > steady_now) ? (tsc_now - steady_now) : (steady_now - tsc_now);
+    ASSERT_TRUE(diff < std::chrono::milliseconds(100));
+  }
+
+  TEST(tsc_clock_run)
+  {
+    coro_st::tsc_clock::calibrate(std::chrono::milliseconds(1));
+
+    auto start = std::chrono::steady_clock::now();
+    auto result = coro_st::run(
+      coro_st::async_sleep_for(std::chrono::milliseconds(1)),
+      coro_st::run_options{ .now_fn = &coro_st::tsc_clock_now });
+    ASSERT_TRUE(result.has_value());
+    ASSERT_TRUE(std::chrono::steady_clock::now() - start < std::chrono::seconds(1));
+  }
+} // anonymous namespace
+
+#endif
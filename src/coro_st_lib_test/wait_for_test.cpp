@@ -27,7 +27,8 @@ namespace
 
     auto task = wait_for_task<decltype(child_task)>(
       child_task,
-      std::chrono::steady_clock::now()
+      std::chrono::seconds(0),
+      std::chrono::steady_clock::duration::zero()
     );
 
     auto work = task.get_work();
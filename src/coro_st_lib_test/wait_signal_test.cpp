@@ -0,0 +1,120 @@
+#include "../test_lib/test.h"
+
+#include "../coro_st_lib/wait_signal.h"
+
+#include "../coro_st_lib/coro_st.h"
+
+#include "test_loop.h"
+
+#include <chrono>
+#include <thread>
+
+#include <signal.h>
+#include <unistd.h>
+
+namespace
+{
+  static_assert(coro_st::is_co_task<coro_st::wait_signal_task>);
+
+  coro_st::co<void> async_raise_after(std::chrono::steady_clock::duration d, int signal_number)
+  {
+    co_await coro_st::async_sleep_for(d);
+    ::raise(signal_number);
+  }
+
+  coro_st::co<int> async_timeout(std::chrono::steady_clock::duration d)
+  {
+    co_await coro_st::async_sleep_for(d);
+    co_return 0;
+  }
+
+  TEST(wait_signal_run)
+  {
+    auto result = coro_st::run(coro_st::async_wait_all(
+      coro_st::async_wait_signal(SIGUSR1),
+      async_raise_after(std::chrono::milliseconds(1), SIGUSR1)
+    )).value();
+    ASSERT_EQ(SIGUSR1, std::get<0>(result));
+  }
+
+  TEST(wait_signal_run_no_timers)
+  {
+    // block before the thread starts so that it inherits the mask
+    // and the signal is left for the signalfd
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGUSR2);
+    ASSERT_EQ(0, ::pthread_sigmask(SIG_BLOCK, &signals, nullptr));
+
+    std::jthread sender([]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      ::kill(::getpid(), SIGUSR2);
+    });
+
+    auto result = coro_st::run(coro_st::async_wait_signal(signals)).value();
+    ASSERT_EQ(SIGUSR2, result);
+  }
+
+  TEST(wait_signal_already_pending)
+  {
+    coro_st_test::test_loop tl;
+
+    auto task = coro_st::async_wait_signal(SIGUSR1);
+    auto awaiter = task.get_work().get_awaiter(tl.ctx);
+
+    ::raise(SIGUSR1);
+
+    awaiter.start();
+    ASSERT_TRUE(tl.result_ready);
+    ASSERT_TRUE(tl.el.poller_.empty());
+    ASSERT_EQ(SIGUSR1, awaiter.await_resume());
+  }
+
+  TEST(wait_signal_chain_root)
+  {
+    coro_st_test::test_loop tl;
+
+    auto task = coro_st::async_wait_signal(SIGUSR1);
+    auto awaiter = task.get_work().get_awaiter(tl.ctx);
+
+    awaiter.start();
+    ASSERT_FALSE(tl.result_ready);
+    ASSERT_EQ(1, tl.el.poller_.size());
+
+    tl.run_io();
+    ASSERT_FALSE(tl.result_ready);
+
+    ::raise(SIGUSR1);
+
+    tl.run_io();
+    ASSERT_TRUE(tl.result_ready);
+    ASSERT_TRUE(tl.el.poller_.empty());
+    ASSERT_EQ(SIGUSR1, awaiter.await_resume());
+  }
+
+  TEST(wait_signal_chain_root_cancel)
+  {
+    coro_st_test::test_loop tl;
+
+    auto task = coro_st::async_wait_signal(SIGUSR1);
+    auto awaiter = task.get_work().get_awaiter(tl.ctx);
+
+    awaiter.start();
+    ASSERT_EQ(1, tl.el.poller_.size());
+
+    tl.stop_source.request_stop();
+    ASSERT_TRUE(tl.el.poller_.empty());
+    ASSERT_FALSE(tl.stopped);
+    tl.run_one_ready();
+    ASSERT_TRUE(tl.stopped);
+  }
+
+  TEST(wait_signal_wait_any)
+  {
+    auto result = coro_st::run(coro_st::async_wait_any(
+      coro_st::async_wait_signal(SIGUSR1),
+      async_timeout(std::chrono::milliseconds(1))
+    )).value();
+    ASSERT_EQ(1, result.index);
+  }
+} // anonymous namespace
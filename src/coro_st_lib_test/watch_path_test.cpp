@@ -0,0 +1,161 @@
+#include "../test_lib/test.h"
+
+#include "../coro_st_lib/watch_path.h"
+
+#include "../coro_st_lib/coro_st.h"
+
+#include "test_loop.h"
+
+#include <cstdlib>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace
+{
+  static_assert(coro_st::is_co_task<coro_st::path_events_task>);
+
+  // Removed with the files in it on destruction
+  struct temp_dir
+  {
+    std::string path;
+
+    temp_dir()
+    {
+      char name[] = "/tmp/coro_st_watch_path_test_XXXXXX";
+      ASSERT_NE(nullptr, ::mkdtemp(name));
+      path = name;
+    }
+
+    ~temp_dir()
+    {
+      static_cast<void>(::unlink((path + "/a").c_str()));
+      static_cast<void>(::unlink((path + "/b").c_str()));
+      static_cast<void>(::rmdir(path.c_str()));
+    }
+  };
+
+  void write_file(const std::string& path, std::string_view content)
+  {
+    coro_st::fd_handle fd{ ::open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0600) };
+    ASSERT_TRUE(fd.is_valid());
+    ASSERT_EQ(static_cast<ssize_t>(content.size()),
+      ::write(fd.get(), content.data(), content.size()));
+  }
+
+  TEST(watch_path_watcher_chain_root)
+  {
+    coro_st_test::test_loop tl;
+    temp_dir dir;
+    coro_st::path_watcher watcher;
+    int wd = watcher.add(dir.path, IN_CREATE | IN_CLOSE_WRITE);
+
+    auto task = watcher.async_next();
+    auto awaiter = task.get_work().get_awaiter(tl.ctx);
+
+    awaiter.start();
+    ASSERT_FALSE(tl.result_ready);
+    ASSERT_EQ(1, tl.el.poller_.size());
+
+    write_file(dir.path + "/a", "x");
+    tl.run_io();
+    ASSERT_TRUE(tl.result_ready);
+    ASSERT_TRUE(tl.el.poller_.empty());
+
+    // batched
+    std::vector<coro_st::path_event> events = awaiter.await_resume();
+    ASSERT_EQ(2, events.size());
+    ASSERT_EQ(wd, events[0].wd);
+    ASSERT_TRUE(0 != (events[0].mask & IN_CREATE));
+    ASSERT_EQ("a", events[0].name);
+    ASSERT_TRUE(0 != (events[1].mask & IN_CLOSE_WRITE));
+    ASSERT_EQ("a", events[1].name);
+  }
+
+  TEST(watch_path_watcher_queued_between_calls)
+  {
+    coro_st_test::test_loop tl;
+    temp_dir dir;
+    coro_st::path_watcher watcher;
+    static_cast<void>(watcher.add(dir.path, IN_CREATE));
+
+    write_file(dir.path + "/a", "x");
+    write_file(dir.path + "/b", "x");
+
+    // completes immediately
+    auto task = watcher.async_next();
+    auto awaiter = task.get_work().get_awaiter(tl.ctx);
+    awaiter.start();
+    ASSERT_TRUE(tl.result_ready);
+    std::vector<coro_st::path_event> events = awaiter.await_resume();
+    ASSERT_EQ(2, events.size());
+    ASSERT_EQ("a", events[0].name);
+    ASSERT_EQ("b", events[1].name);
+  }
+
+  coro_st::co<std::vector<coro_st::path_event>> async_watch_and_modify(std::string path)
+  {
+    coro_st::path_watcher watcher;
+    static_cast<void>(watcher.add(path, IN_MODIFY));
+    auto result = co_await coro_st::async_wait_all(
+      watcher.async_next(),
+      std::invoke([](std::string path) -> coro_st::co<void> {
+        // after the watch started
+        co_await coro_st::async_yield();
+        write_file(path, "y");
+      }, path));
+    std::vector<coro_st::path_event> events = std::move(std::get<0>(result));
+
+    // a change while not waiting is not lost
+    write_file(path, "z");
+    auto next = co_await watcher.async_next();
+    events.insert(events.end(), next.begin(), next.end());
+    co_return events;
+  }
+
+  TEST(watch_path_run)
+  {
+    temp_dir dir;
+    std::string path = dir.path + "/a";
+    write_file(path, "x");
+
+    auto events = coro_st::run(async_watch_and_modify(path)).value();
+    ASSERT_EQ(2, events.size());
+    ASSERT_TRUE(0 != (events[0].mask & IN_MODIFY));
+    ASSERT_TRUE(events[0].name.empty());
+    ASSERT_TRUE(0 != (events[1].mask & IN_MODIFY));
+  }
+
+  TEST(watch_path_missing)
+  {
+    temp_dir dir;
+    coro_st::path_watcher watcher;
+    ASSERT_THROW(
+      static_cast<void>(watcher.add(dir.path + "/missing", IN_MODIFY)),
+      std::system_error);
+  }
+
+  TEST(watch_path_cancel)
+  {
+    coro_st_test::test_loop tl;
+    temp_dir dir;
+    coro_st::path_watcher watcher;
+    static_cast<void>(watcher.add(dir.path, IN_CREATE));
+
+    auto task = watcher.async_next();
+    auto awaiter = task.get_work().get_awaiter(tl.ctx);
+
+    awaiter.start();
+    ASSERT_EQ(1, tl.el.poller_.size());
+
+    tl.stop_source.request_stop();
+    ASSERT_TRUE(tl.el.poller_.empty());
+    tl.run_one_ready();
+    ASSERT_TRUE(tl.stopped);
+  }
+} // anonymous namespace
@@ -0,0 +1,172 @@
+#include "../test_lib/test.h"
+
+#include "../coro_st_lib/watch.h"
+
+#include "../coro_st_lib/co.h"
+#include "../coro_st_lib/coro_type_traits.h"
+#include "../coro_st_lib/run.h"
+#include "../coro_st_lib/wait_all.h"
+#include "../coro_st_lib/yield.h"
+
+#include "test_loop.h"
+
+#include <string>
+
+namespace
+{
+  static_assert(
+    coro_st::is_co_task<
+      coro_st::watch<int>::watch_changed_task>);
+
+  TEST(watch_chain_root)
+  {
+    coro_st_test::test_loop tl;
+
+    coro_st::watch<int> w{ 0 };
+    ASSERT_EQ(0, w.version());
+
+    auto task = w.async_changed(w.version());
+
+    auto awaiter = task.get_work().get_awaiter(tl.ctx);
+
+    awaiter.start();
+
+    ASSERT_TRUE(tl.el.ready_queue_.empty());
+    ASSERT_TRUE(tl.el.timers_heap_.empty());
+
+    ASSERT_EQ(1, w.publish(41));
+    ASSERT_EQ(0, w.publish(42));
+    ASSERT_EQ(2, w.version());
+
+    ASSERT_FALSE(tl.el.ready_queue_.empty());
+    ASSERT_TRUE(tl.el.timers_heap_.empty());
+
+    ASSERT_FALSE(tl.result_ready);
+    ASSERT_FALSE(tl.stopped);
+    tl.run_one_ready();
+    ASSERT_TRUE(tl.result_ready);
+    ASSERT_FALSE(tl.stopped);
+
+    ASSERT_EQ(42, awaiter.await_resume());
+  }
+
+  TEST(watch_chain_root_already_changed)
+  {
+    coro_st_test::test_loop tl;
+
+    coro_st::watch<int> w{ 0 };
+    w.publish(42);
+
+    auto task = w.async_changed(0);
+
+    auto awaiter = task.get_work().get_awaiter(tl.ctx);
+
+    awaiter.start();
+
+    ASSERT_TRUE(tl.el.ready_queue_.empty());
+    ASSERT_TRUE(tl.result_ready);
+    ASSERT_FALSE(tl.stopped);
+
+    ASSERT_EQ(42, awaiter.await_resume());
+  }
+
+  TEST(watch_chain_root_cancellation)
+  {
+    coro_st_test::test_loop tl;
+
+    coro_st::watch<int> w{ 0 };
+
+    auto task = w.async_changed(w.version());
+
+    auto awaiter = task.get_work().get_awaiter(tl.ctx);
+
+    awaiter.start();
+
+    tl.stop_source.request_stop();
+
+    ASSERT_FALSE(tl.el.ready_queue_.empty());
+    ASSERT_TRUE(tl.el.timers_heap_.empty());
+
+    ASSERT_EQ(0, w.publish(42));
+
+    ASSERT_FALSE(tl.result_ready);
+    ASSERT_FALSE(tl.stopped);
+    tl.run_one_ready();
+    ASSERT_FALSE(tl.result_ready);
+    ASSERT_TRUE(tl.stopped);
+  }
+
+  TEST(watch_inside_co)
+  {
+    coro_st_test::test_loop tl;
+
+    coro_st::watch<std::string> w{ "start" };
+
+    auto async_lambda = [](coro_st::watch<std::string>& w) -> coro_st::co<std::string> {
+      co_return co_await w.async_changed(w.version());
+    };
+
+    auto task = async_lambda(w);
+
+    auto awaiter = task.get_work().get_awaiter(tl.ctx);
+
+    awaiter.start();
+
+    ASSERT_TRUE(tl.el.ready_queue_.empty());
+
+    w.modify([](std::string& x) {
+      x += " stop";
+    });
+
+    tl.run_one_ready(2);
+    ASSERT_TRUE(tl.result_ready);
+    ASSERT_FALSE(tl.stopped);
+
+    ASSERT_EQ("start stop", awaiter.await_resume());
+  }
+
+  struct watch_usage_data
+  {
+    coro_st::watch<int> w{ 0 };
+    int sum{ 0 };
+  };
+
+  coro_st::co<void> async_watch_subscriber(watch_usage_data& data)
+  {
+    size_t seen = data.w.version();
+    while (true)
+    {
+      int value = co_await data.w.async_changed(seen);
+      seen = data.w.version();
+      data.sum += value;
+      if (value == 0)
+      {
+        co_return;
+      }
+    }
+  }
+
+  coro_st::co<void> async_watch_publisher(watch_usage_data& data)
+  {
+    co_await coro_st::async_yield();
+    // both subscribers skip the intermediate 1
+    data.w.publish(1);
+    data.w.publish(20);
+    co_await coro_st::async_yield();
+    co_await coro_st::async_yield();
+    data.w.publish(0);
+  }
+
+  TEST(watch_usage)
+  {
+    watch_usage_data data;
+    auto result = coro_st::run(
+      coro_st::async_wait_all(
+        async_watch_subscriber(data),
+        async_watch_subscriber(data),
+        async_watch_publisher(data)));
+    ASSERT_TRUE(result.has_value());
+    ASSERT_EQ(40, data.sum);
+    ASSERT_EQ(3, data.w.version());
+  }
+} // anonymous namespace
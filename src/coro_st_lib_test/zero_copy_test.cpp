@@ -0,0 +1,195 @@
+#include "../test_lib/test.h"
+
+#include "../coro_st_lib/zero_copy.h"
+
+#include "../coro_st_lib/coro_st.h"
+
+#include "test_loop.h"
+
+#include <array>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+  static_assert(coro_st::is_co_task<coro_st::sendfile_task>);
+  static_assert(coro_st::is_co_task<coro_st::splice_task>);
+
+  struct test_pipe
+  {
+    coro_st::fd_handle read_end;
+    coro_st::fd_handle write_end;
+
+    test_pipe()
+    {
+      int fds[2];
+      ASSERT_EQ(0, ::pipe2(fds, O_NONBLOCK | O_CLOEXEC));
+      read_end.reset(fds[0]);
+      write_end.reset(fds[1]);
+    }
+  };
+
+  // Deleted when closed
+  coro_st::fd_handle make_temp_file(std::string_view content)
+  {
+    char name[] = "/tmp/coro_st_zero_copy_test_XXXXXX";
+    coro_st::fd_handle fd{ ::mkstemp(name) };
+    ASSERT_TRUE(fd.is_valid());
+    ASSERT_EQ(0, ::unlink(name));
+    ASSERT_EQ(static_cast<ssize_t>(content.size()),
+      ::write(fd.get(), content.data(), content.size()));
+    return fd;
+  }
+
+  coro_st::co<std::string> async_file_to_pipes(
+    coro_st::fd_arg file, test_pipe& a, test_pipe& b, size_t offset, size_t count)
+  {
+    std::string result;
+    co_await coro_st::async_wait_all(
+      // file -> a
+      std::invoke([](coro_st::fd_arg file, test_pipe& a, size_t offset, size_t count)
+        -> coro_st::co<void> {
+        size_t transferred = co_await coro_st::async_sendfile(
+          a.write_end, file, static_cast<off_t>(offset), count);
+        ASSERT_EQ(count, transferred);
+        a.write_end.reset();
+      }, file, a, offset, count),
+      // a -> b
+      std::invoke([](test_pipe& a, test_pipe& b) -> coro_st::co<void> {
+        while (true)
+        {
+          size_t transferred = co_await coro_st::async_splice(
+            a.read_end, b.write_end, 1024 * 1024);
+          if (0 == transferred)
+          {
+            break;
+          }
+        }
+        b.write_end.reset();
+      }, a, b),
+      // b -> result
+      std::invoke([](test_pipe& b, std::string& result) -> coro_st::co<void> {
+        std::array<char, 4096> buffer;
+        while (true)
+        {
+          size_t count = co_await coro_st::async_read_some(b.read_end.get(), buffer);
+          if (0 == count)
+          {
+            co_return;
+          }
+          result.append(buffer.data(), count);
+        }
+      }, b, result)
+    );
+    co_return result;
+  }
+
+  TEST(zero_copy_file_to_pipes_run)
+  {
+    // more than the pipe buffers and more than one chunk
+    std::string data(3 * 1024 * 1024, 'x');
+    for (size_t i = 0; i < data.size(); i += 1000)
+    {
+      data[i] = static_cast<char>('a' + (i % 26));
+    }
+    auto file = make_temp_file(data);
+    test_pipe a;
+    test_pipe b;
+
+    auto result = coro_st::run(
+      async_file_to_pipes(file, a, b, 10, data.size() - 10)).value();
+    ASSERT_TRUE(data.substr(10) == result);
+    // the file offset is not changed
+    ASSERT_EQ(static_cast<off_t>(data.size()), ::lseek(file.get(), 0, SEEK_CUR));
+  }
+
+  TEST(zero_copy_sendfile_end_of_file)
+  {
+    auto file = make_temp_file("hello");
+    test_pipe a;
+
+    auto result = coro_st::run(coro_st::async_sendfile(a.write_end, file, 1, 100)).value();
+    ASSERT_EQ(4, result);
+    std::array<char, 16> buffer;
+    ASSERT_EQ(4, ::read(a.read_end.get(), buffer.data(), buffer.size()));
+    ASSERT_EQ("ello", std::string_view(buffer.data(), 4));
+  }
+
+  TEST(zero_copy_sendfile_error)
+  {
+    auto file = make_temp_file("hello");
+    test_pipe a;
+
+    // can't write to the read end
+    ASSERT_THROW(
+      static_cast<void>(coro_st::run(coro_st::async_sendfile(a.read_end, file, 0, 5))),
+      std::system_error);
+  }
+
+  TEST(zero_copy_sendfile_cancel)
+  {
+    coro_st_test::test_loop tl;
+    std::string data(1024 * 1024, 'x');
+    auto file = make_temp_file(data);
+    test_pipe a;
+
+    // nobody reads, it blocks when the pipe is full
+    auto task = coro_st::async_sendfile(a.write_end, file, 0, data.size());
+    auto awaiter = task.get_work().get_awaiter(tl.ctx);
+
+    awaiter.start();
+    ASSERT_FALSE(tl.result_ready);
+    ASSERT_EQ(1, tl.el.poller_.size());
+
+    tl.stop_source.request_stop();
+    ASSERT_TRUE(tl.el.poller_.empty());
+    tl.run_one_ready();
+    ASSERT_TRUE(tl.stopped);
+  }
+
+  TEST(zero_copy_splice_waits_for_either_side)
+  {
+    coro_st_test::test_loop tl;
+    test_pipe a;
+    test_pipe b;
+
+    // fill b, so it can't take more
+    std::string fill(4096, 'f');
+    while (::write(b.write_end.get(), fill.data(), fill.size()) > 0)
+    {
+    }
+
+    auto task = coro_st::async_splice(a.read_end, b.write_end, 3);
+    auto awaiter = task.get_work().get_awaiter(tl.ctx);
+
+    // a is empty, waits for input
+    awaiter.start();
+    ASSERT_FALSE(tl.result_ready);
+    ASSERT_EQ(1, tl.el.poller_.size());
+
+    // a has data, but b is full, waits for output
+    ASSERT_EQ(3, ::write(a.write_end.get(), "abc", 3));
+    tl.run_io();
+    ASSERT_FALSE(tl.result_ready);
+    ASSERT_EQ(1, tl.el.poller_.size());
+    tl.run_io();
+    ASSERT_FALSE(tl.result_ready);
+
+    // drain b
+    std::array<char, 4096> buffer;
+    while (::read(b.read_end.get(), buffer.data(), buffer.size()) > 0)
+    {
+    }
+    tl.run_io();
+    ASSERT_TRUE(tl.result_ready);
+    ASSERT_TRUE(tl.el.poller_.empty());
+    ASSERT_EQ(3, awaiter.await_resume());
+    ASSERT_EQ(3, ::read(b.read_end.get(), buffer.data(), buffer.size()));
+    ASSERT_EQ("abc", std::string_view(buffer.data(), 3));
+  }
+} // anonymous namespace
@@ -90,6 +90,11 @@ namespace cpp_util
       return head_;
     }
 
+    const Node* front() const noexcept
+    {
+      return head_;
+    }
+
     Node* back() noexcept
     {
       return tail_;